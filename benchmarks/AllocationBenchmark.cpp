@@ -0,0 +1,119 @@
+// Counts the allocations of each phase of a link as the number of records
+// (symbols and relocations) in its inputs grows, with the number of objects
+// and segments fixed. A phase whose allocations grow with the records
+// allocates per record; with --check, the benchmark fails when a phase
+// allocates more per added record than its budget below, so that it runs as
+// a regression test.
+
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Driver/Driver.h>
+#include <ObjectReader/ObjectWriter.h>
+
+static const int NumberOfObjects = 16;
+static const int SmallRecords = 500;
+static const int LargeRecords = 8 * SmallRecords;
+
+// Allocations a phase may make per added record. Every phase sizes its
+// tables up front, so an allocation per definition would add a quarter and
+// one per relocation another half.
+static const std::map<std::string, double> Budgets = {
+  {"read", 0.05},
+  {"symbols", 0.05},
+  {"segments", 0.05},
+  {"relocations", 0.05},
+  {"output", 0.05},
+  {"render", 0.05},
+  {"write", 0.05},
+};
+
+static std::string FileName(int Object) {
+  return "AllocationBenchmark.object" + std::to_string(Object) + ".pof";
+}
+
+// Object i defines Records functions in its .text and calls the functions
+// of the same number in object i - 1, with one relocation per definition
+// and one per call.
+static bool WriteObjects(int Records) {
+  for (int i = 0; i < NumberOfObjects; i++) {
+    ldl::ObjectFile OF;
+    OF.FileName = FileName(i);
+    ldl::Segment Text{OF.FileName, ".text", 0x0, 8 * Records, "RP"};
+    Text.Data = std::string(2 * Text.Length, '0');
+    OF.Segments.push_back(Text);
+    for (int k = 0; k < Records; k++)
+      OF.Symbols.push_back(ldl::Symbol{"f" + std::to_string(i) + "_" + std::to_string(k), 8 * k, 1, "D"});
+    for (int k = 0; k < Records && i > 0; k++)
+      OF.Symbols.push_back(ldl::Symbol{"f" + std::to_string(i - 1) + "_" + std::to_string(k), 0, 0, "U"});
+    for (int k = 0; k < Records; k++) {
+      OF.Relocations.push_back(ldl::Relocation{8 * k, 1, k + 1, "AS4"});
+      if (i > 0)
+        OF.Relocations.push_back(ldl::Relocation{8 * k + 4, 1, Records + k + 1, "RS4"});
+    }
+    OF.FH = ldl::FileHeader{"LINK", 1, static_cast<int>(OF.Symbols.size()), static_cast<int>(OF.Relocations.size())};
+    if (!ldl::ObjectWriter{OF}.Write(OF.FileName))
+      return false;
+  }
+  return true;
+}
+
+// Links the objects written for Records and returns the allocations of
+// each phase.
+static std::map<std::string, uint64_t> CountAllocations(int Records, std::ostream& Errors) {
+  std::map<std::string, uint64_t> Allocations;
+  if (!WriteObjects(Records)) {
+    Errors << "could not write the objects" << std::endl;
+    return Allocations;
+  }
+  ldl::LinkOptions Options;
+  Options.Output = "AllocationBenchmark.out";
+  for (int i = 0; i < NumberOfObjects; i++)
+    Options.FileNames.push_back(FileName(i));
+  // --stats turns the counting on.
+  Options.Stats = true;
+  ldl::Linker L;
+  std::ostringstream Stats;
+  if (ldl::RunLink(Options, L, Stats) == 0)
+    for (auto& P : L.Memory.Phases)
+      Allocations[P.Name] = P.Allocations;
+  else
+    Errors << Stats.str();
+  for (auto& Name : Options.FileNames)
+    std::remove(Name.c_str());
+  std::remove(Options.Output.c_str());
+  return Allocations;
+}
+
+int main(int argc, char** argv) {
+  bool Check = argc > 1 && std::string{argv[1]} == "--check";
+  // Records are the symbol and relocation lines of every input: two per
+  // function in the first object and four in the others.
+  double AddedRecords = (4.0 * NumberOfObjects - 2) * (LargeRecords - SmallRecords);
+  auto Small = CountAllocations(SmallRecords, std::cerr);
+  auto Large = CountAllocations(LargeRecords, std::cerr);
+  if (Small.empty() || Large.empty())
+    return 1;
+
+  bool Failed = false;
+  std::cout << "phase, allocations with " << SmallRecords << " functions per object, with "
+            << LargeRecords << ", per added record, budget" << std::endl;
+  for (auto& [Name, Budget] : Budgets) {
+    if (!Large.count(Name) || !Small.count(Name)) {
+      std::cout << Name << ": not recorded" << std::endl;
+      Failed = true;
+      continue;
+    }
+    double PerRecord = (static_cast<double>(Large[Name]) - static_cast<double>(Small[Name])) / AddedRecords;
+    std::cout << Name << ", " << Small[Name] << ", " << Large[Name] << ", " << PerRecord << ", " << Budget << std::endl;
+    if (PerRecord > Budget) {
+      std::cout << Name << " allocates per record" << std::endl;
+      Failed = true;
+    }
+  }
+  return Check && Failed ? 1 : 0;
+}
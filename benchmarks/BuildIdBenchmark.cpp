@@ -0,0 +1,64 @@
+// Measures what stamping a build-id adds to a link, against the size of the
+// image. Each link lays out 1MB objects, renders the output text and then
+// hashes it with the fast and the SHA-256 tree hash. The largest image in
+// megabytes is the first argument; the default keeps the benchmark within a
+// few GB of memory, and multi-GB images need a larger machine.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <Linker/Linker.h>
+#include <ObjectReader/ObjectWriter.h>
+
+static const int ObjectLength = 1 << 20;
+
+static std::vector<ldl::SharedObjectFilePtr> MakeObjects(int NumberOfObjects) {
+  std::vector<ldl::SharedObjectFilePtr> ObjectFiles;
+  for (int i = 0; i < NumberOfObjects; i++) {
+    auto OF = std::make_shared<ldl::ObjectFile>();
+    OF->FileName = "object" + std::to_string(i) + ".pof";
+    ldl::Segment Text{OF->FileName, ".text", 0x0, ObjectLength, "RP"};
+    Text.Data = std::string(2 * ObjectLength, "0123456789abcdef"[i % 16]);
+    OF->Segments = {Text};
+    OF->Symbols.push_back(ldl::Symbol{"f" + std::to_string(i), 0, 1, "D"});
+    OF->FH = ldl::FileHeader{"LINK", 1, 1, 0};
+    ObjectFiles.push_back(OF);
+  }
+  return ObjectFiles;
+}
+
+static double Milliseconds(std::chrono::steady_clock::duration D) {
+  return std::chrono::duration<double, std::milli>(D).count();
+}
+
+int main(int argc, char** argv) {
+  int MaximumMegabytes = argc > 1 ? std::atoi(argv[1]) : 256;
+  std::cout << "image MB, output bytes, link and render ms, fast ms, fast %, sha256 ms, sha256 %" << std::endl;
+  for (int Megabytes = 16; Megabytes <= MaximumMegabytes; Megabytes *= 4) {
+    auto ObjectFiles = MakeObjects(Megabytes);
+    double Times[3] = {};
+    size_t Size = 0;
+    for (auto Kind : {ldl::BuildIdKind::None, ldl::BuildIdKind::Fast, ldl::BuildIdKind::SHA256}) {
+      ldl::Linker L;
+      L.ObjectFiles = ObjectFiles;
+      L.BuildIdType = Kind;
+      auto Start = std::chrono::steady_clock::now();
+      std::string Text = ldl::ObjectWriter{*L.GenerateObjectFile()}.Text();
+      auto Rendered = std::chrono::steady_clock::now();
+      if (Kind == ldl::BuildIdKind::None) {
+        Times[0] = Milliseconds(Rendered - Start);
+        Size = Text.size();
+        continue;
+      }
+      L.StampBuildId(Text);
+      Times[Kind == ldl::BuildIdKind::Fast ? 1 : 2] = Milliseconds(std::chrono::steady_clock::now() - Rendered);
+    }
+    std::cout << Megabytes << ", " << Size << ", " << Times[0]
+              << ", " << Times[1] << ", " << 100 * Times[1] / Times[0]
+              << ", " << Times[2] << ", " << 100 * Times[2] / Times[0] << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,112 @@
+// Measures compressed segment data against plain hex: the size of the
+// object files and the linked image, how long the link takes reading each,
+// and how long the loader takes to map the image. Segment data is made of
+// instructions drawn from a small set, as code mostly is. The number of
+// objects is the first argument.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <Linker/Linker.h>
+#include <Loader/Loader.h>
+#include <ObjectReader/ObjectWriter.h>
+
+static const int SegmentLength = 0x4000;
+static const int Repetitions = 5;
+
+static std::string CodeBytes(int Seed) {
+  static const char* Instructions[] = {
+    "\x55", "\x48\x89\xe5", "\x48\x83\xec\x10", "\x89\x7d\xfc", "\x8b\x45\xfc", "\x83\xc0\x01",
+    "\xc9", "\xc3", "\x48\x8b\x05\x00\x00\x00\x00", "\xe8\x00\x00\x00\x00", "\x31\xc0", "\x90",
+  };
+  std::string Bytes;
+  unsigned State = static_cast<unsigned>(Seed) * 2654435761u + 1;
+  while (Bytes.size() < static_cast<size_t>(SegmentLength)) {
+    State = State * 1103515245u + 12345u;
+    Bytes += Instructions[(State >> 16) % 12];
+  }
+  Bytes.resize(SegmentLength);
+  return Bytes;
+}
+
+static bool WriteObject(const std::string& FileName, int i, bool Compress) {
+  ldl::ObjectFile OF;
+  ldl::Segment Text{FileName, ".text", 0x0, SegmentLength, "RP"};
+  std::string Bytes = CodeBytes(i);
+  Text.Data.resize(2 * Bytes.size());
+  ldl::WriteHexBytes(&Text.Data[0], Bytes);
+  if (Compress)
+    ldl::CompressSegment(Text);
+  OF.Segments.push_back(Text);
+  OF.Symbols.push_back(ldl::Symbol{"f" + std::to_string(i), 0, 1, "D"});
+  OF.FH = ldl::FileHeader{"LINK", 1, 1, 0};
+  return ldl::ObjectWriter{OF}.Write(FileName);
+}
+
+static size_t FileSize(const std::string& FileName) {
+  struct stat ST;
+  return stat(FileName.c_str(), &ST) == 0 ? static_cast<size_t>(ST.st_size) : 0;
+}
+
+static double Milliseconds(std::chrono::steady_clock::duration D) {
+  return std::chrono::duration<double, std::milli>(D).count();
+}
+
+int main(int argc, char** argv) {
+  int NumberOfObjects = argc > 1 ? std::atoi(argv[1]) : 1000;
+  std::string Prefix = "/tmp/ldl-compression-benchmark-" + std::to_string(getpid());
+  std::cout << "objects: " << NumberOfObjects << std::endl
+            << "format, input bytes, link ms, image bytes, load ms" << std::endl;
+  for (bool Compress : {false, true}) {
+    std::vector<std::string> FileNames;
+    size_t InputBytes = 0;
+    for (int i = 0; i < NumberOfObjects; i++) {
+      FileNames.push_back(Prefix + "-" + std::to_string(i) + ".pof");
+      if (!WriteObject(FileNames.back(), i, Compress)) {
+        std::cerr << "could not write " << FileNames.back() << std::endl;
+        return 1;
+      }
+      InputBytes += FileSize(FileNames.back());
+    }
+
+    std::string Image = Prefix + ".image.pof";
+    double Link = 0;
+    double Load = 0;
+    try {
+      for (int Round = 0; Round < Repetitions; Round++) {
+        ldl::Linker L;
+        L.TextAddress = 0x10000000;
+        auto Start = std::chrono::steady_clock::now();
+        auto OFPtr = L.Link(FileNames);
+        Link += Milliseconds(std::chrono::steady_clock::now() - Start) / Repetitions;
+        if (Round == 0) {
+          if (Compress)
+            for (auto& S : OFPtr->Segments)
+              ldl::CompressSegment(S);
+          ldl::ObjectWriter{*OFPtr}.Write(Image);
+        }
+
+        ldl::Loader Loader;
+        Start = std::chrono::steady_clock::now();
+        Loader.Load(Image);
+        Load += Milliseconds(std::chrono::steady_clock::now() - Start) / Repetitions;
+      }
+    } catch (const char* Message) {
+      std::cerr << Message << std::endl;
+    }
+    std::cout << (Compress ? "compressed" : "hex") << ", " << InputBytes << ", " << Link << ", "
+              << FileSize(Image) << ", " << Load << std::endl;
+
+    for (auto& FileName : FileNames)
+      std::remove(FileName.c_str());
+    std::remove(Image.c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+// Counts the pages touched by the hot part of a synthetic program's .text
+// with command-line order, a symbol ordering file and a C3 call graph order.
+
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <Linker/Linker.h>
+
+static const int NumberOfObjects = 4000;
+static const int NumberOfHotFunctions = 200;
+static const int NumberOfCalls = 1000;
+
+static unsigned long long State = 0x2545F4914F6CDD1DULL;
+static unsigned long Random() {
+  State ^= State << 13;
+  State ^= State >> 7;
+  State ^= State << 17;
+  return static_cast<unsigned long>(State);
+}
+
+static std::string FunctionName(int i) {
+  return "f" + std::to_string(i);
+}
+
+static std::vector<ldl::SharedObjectFilePtr> MakeObjects() {
+  std::vector<ldl::SharedObjectFilePtr> ObjectFiles;
+  for (int i = 0; i < NumberOfObjects; i++) {
+    auto OF = std::make_shared<ldl::ObjectFile>();
+    OF->FileName = "object" + std::to_string(i) + ".pof";
+    int Length = 64 + static_cast<int>(Random() % 2048);
+    ldl::Segment Text{OF->FileName, ".text", 0x0, Length, "RP"};
+    Text.Data = std::string(2 * Length, 'c');
+    OF->Segments.push_back(Text);
+    OF->Symbols.push_back(ldl::Symbol{FunctionName(i), 0, 1, "D"});
+    OF->FH = ldl::FileHeader{"LINK", 1, 1, 0};
+    ObjectFiles.push_back(OF);
+  }
+  return ObjectFiles;
+}
+
+static size_t HotPages(ldl::Linker& L, const std::set<int>& Hot) {
+  std::set<int> Pages;
+  for (auto& C : L.TextSegment->ContainedSegments) {
+    if (!Hot.count(C.ObjectIndex))
+      continue;
+    for (int Page = C.Address / 0x1000; Page <= (C.Address + C.Length - 1) / 0x1000; Page++)
+      Pages.insert(Page);
+  }
+  return Pages.size();
+}
+
+static void Report(const std::string& Name, ldl::Linker& L, const std::vector<ldl::SharedObjectFilePtr>& Objects, const std::set<int>& Hot) {
+  L.Reset();
+  L.ObjectFiles = Objects;
+  auto Start = std::chrono::steady_clock::now();
+  L.GenerateObjectFile();
+  auto End = std::chrono::steady_clock::now();
+  std::cout << Name << ": " << HotPages(L, Hot) << " hot pages, "
+            << std::chrono::duration<double, std::milli>(End - Start).count() << " ms" << std::endl;
+}
+
+int main() {
+  auto Objects = MakeObjects();
+
+  std::set<int> Hot;
+  while (static_cast<int>(Hot.size()) < NumberOfHotFunctions)
+    Hot.insert(static_cast<int>(Random() % NumberOfObjects));
+  std::vector<int> HotList(Hot.begin(), Hot.end());
+
+  std::vector<ldl::CallGraphEdge> CallGraph;
+  for (int i = 0; i < NumberOfCalls; i++) {
+    int Caller = HotList[Random() % HotList.size()];
+    int Callee = HotList[Random() % HotList.size()];
+    CallGraph.push_back(ldl::CallGraphEdge{FunctionName(Caller), FunctionName(Callee), static_cast<long>(1 + Random() % 1000)});
+  }
+
+  std::cout << NumberOfObjects << " .text inputs, " << Hot.size() << " hot" << std::endl;
+
+  ldl::Linker L;
+  Report("command line order", L, Objects, Hot);
+
+  for (int i : HotList)
+    L.Ordering.SymbolOrder.push_back(FunctionName(i));
+  Report("symbol ordering file", L, Objects, Hot);
+
+  L.Ordering.Clear();
+  L.Ordering.CallGraph = CallGraph;
+  Report("call graph (C3)", L, Objects, Hot);
+  return 0;
+}
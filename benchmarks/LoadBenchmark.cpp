@@ -0,0 +1,80 @@
+// Measures how long the loader takes to map a linked image at its linked
+// address and somewhere else, against the size of the image. Every input's
+// .data is a table of pointers into its .text, so rebasing has to adjust
+// one slot per 8 bytes of data.
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <Linker/Linker.h>
+#include <Loader/Loader.h>
+
+static const int SegmentLength = 0x1000;
+static const int Repetitions = 5;
+
+static std::vector<ldl::SharedObjectFilePtr> MakeObjects(int NumberOfObjects) {
+  std::vector<ldl::SharedObjectFilePtr> ObjectFiles;
+  for (int i = 0; i < NumberOfObjects; i++) {
+    auto OF = std::make_shared<ldl::ObjectFile>();
+    OF->FileName = "object" + std::to_string(i) + ".pof";
+    ldl::Segment Text{OF->FileName, ".text", 0x0, SegmentLength, "RP"};
+    Text.Data = std::string(2 * SegmentLength, 'c');
+    ldl::Segment Data{OF->FileName, ".data", 0x0, SegmentLength, "RWP"};
+    Data.Data = std::string(2 * SegmentLength, '0');
+    OF->Segments = {Text, Data};
+    OF->Symbols.push_back(ldl::Symbol{"f" + std::to_string(i), 0, 1, "D"});
+    for (int Location = 0; Location < SegmentLength; Location += 8)
+      OF->Relocations.push_back(ldl::Relocation{Location, 2, 1, "AS8"});
+    OF->FH = ldl::FileHeader{"LINK", 2, 1, static_cast<int>(OF->Relocations.size())};
+    ObjectFiles.push_back(OF);
+  }
+  return ObjectFiles;
+}
+
+static double Milliseconds(std::chrono::steady_clock::duration D) {
+  return std::chrono::duration<double, std::milli>(D).count();
+}
+
+int main() {
+  std::string Image = "/tmp/ldl-load-benchmark.pof";
+  std::cout << "image bytes, slots, load ms, rebased load ms, rebase ms" << std::endl;
+  for (int NumberOfObjects : {16, 128, 1024, 4096}) {
+    ldl::Linker L;
+    L.TextAddress = 0x10000000;
+    L.ObjectFiles = MakeObjects(NumberOfObjects);
+    {
+      std::ofstream OFS{Image};
+      OFS << L.GenerateObjectFile()->GenerateTextRepresentation();
+    }
+
+    double Fixed = 0;
+    double Rebased = 0;
+    double Rebase = 0;
+    size_t Size = 0;
+    size_t Slots = 0;
+    for (int Round = 0; Round < Repetitions; Round++) {
+      for (bool Move : {false, true}) {
+        ldl::Loader Loader;
+        Loader.Rebase = Move;
+        auto Start = std::chrono::steady_clock::now();
+        auto I = Loader.Load(Image);
+        double Elapsed = Milliseconds(std::chrono::steady_clock::now() - Start);
+        Size = I->Size;
+        if (Move) {
+          Rebased += Elapsed / Repetitions;
+          Rebase += Milliseconds(I->RelocationTime) / Repetitions;
+          Slots = I->RelativeRelocations;
+        } else {
+          Fixed += Elapsed / Repetitions;
+        }
+      }
+    }
+    std::cout << Size << ", " << Slots << ", " << Fixed << ", " << Rebased << ", " << Rebase << std::endl;
+  }
+  std::remove(Image.c_str());
+  return 0;
+}
@@ -0,0 +1,77 @@
+// Measures how many symbol lookups per second the loader resolves with many
+// shared libraries loaded: names the last library defines, which are
+// rejected by every other library's bloom filter first, and names no
+// library defines.
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <Linker/Linker.h>
+#include <Loader/Loader.h>
+
+static const int NumberOfLibraries = 100;
+static const int FunctionsPerLibrary = 1000;
+static const int NumberOfLookups = 200000;
+
+static std::string FunctionName(int Library, int Function) {
+  return "lib" + std::to_string(Library) + "_function" + std::to_string(Function);
+}
+
+// One object per library with a .text that defines all its functions.
+static ldl::SharedObjectFilePtr MakeObject(int Library) {
+  auto OF = std::make_shared<ldl::ObjectFile>();
+  OF->FileName = "library" + std::to_string(Library) + ".pof";
+  ldl::Segment Text{OF->FileName, ".text", 0x0, 16 * FunctionsPerLibrary, "RP"};
+  Text.Data = std::string(2 * Text.Length, 'c');
+  OF->Segments.push_back(Text);
+  for (int i = 0; i < FunctionsPerLibrary; i++)
+    OF->Symbols.push_back(ldl::Symbol{FunctionName(Library, i), 16 * i, 1, "D"});
+  OF->FH = ldl::FileHeader{"LINK", 1, FunctionsPerLibrary, 0};
+  return OF;
+}
+
+static double Rate(ldl::Loader& Loader, const std::vector<std::string>& Names, size_t& Found) {
+  Found = 0;
+  auto Start = std::chrono::steady_clock::now();
+  for (int i = 0; i < NumberOfLookups; i++) {
+    void* Address;
+    Found += Loader.Resolve(Names[i % Names.size()], Address);
+  }
+  double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+  return NumberOfLookups / Seconds;
+}
+
+int main() {
+  ldl::Loader Loader;
+  std::string FileName = "/tmp/ldl-lookup-benchmark.pof";
+  for (int Library = 0; Library < NumberOfLibraries; Library++) {
+    ldl::Linker L;
+    L.Shared = true;
+    L.ObjectFiles = {MakeObject(Library)};
+    {
+      std::ofstream OFS{FileName};
+      OFS << L.GenerateObjectFile()->GenerateTextRepresentation();
+    }
+    Loader.LoadLibrary(FileName);
+  }
+  std::remove(FileName.c_str());
+
+  std::vector<std::string> Last;
+  std::vector<std::string> Missing;
+  for (int i = 0; i < FunctionsPerLibrary; i++) {
+    Last.push_back(FunctionName(NumberOfLibraries - 1, i));
+    Missing.push_back("missing_function" + std::to_string(i));
+  }
+
+  size_t Found;
+  std::cout << NumberOfLibraries << " libraries, " << FunctionsPerLibrary << " exports each" << std::endl;
+  double LastRate = Rate(Loader, Last, Found);
+  std::cout << "defined by the last library: " << LastRate << " lookups/s (" << Found << " found)" << std::endl;
+  double MissingRate = Rate(Loader, Missing, Found);
+  std::cout << "defined by no library: " << MissingRate << " lookups/s (" << Found << " found)" << std::endl;
+  return 0;
+}
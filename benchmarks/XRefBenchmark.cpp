@@ -0,0 +1,101 @@
+// Measures the cross-reference index over many object files: building it,
+// updating it when nothing or one file changed, and looking names up in the
+// mapped index. The number of files is the first argument; each defines
+// and references a few hundred symbols.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <ObjectReader/ObjectWriter.h>
+#include <XRef/XRef.h>
+
+static const int SymbolsPerFile = 200;
+static const int NumberOfLookups = 100000;
+
+static std::string FunctionName(int File, int Function) {
+  return "file" + std::to_string(File) + "_function" + std::to_string(Function);
+}
+
+// File i defines its functions and calls those of file i - 1.
+static bool WriteObject(const std::string& FileName, int File, int Generation) {
+  ldl::ObjectFile OF;
+  ldl::Segment Text{FileName, ".text", 0x0, 8 * SymbolsPerFile + Generation, "RP"};
+  Text.Data = std::string(2 * Text.Length, '0');
+  OF.Segments.push_back(Text);
+  for (int k = 0; k < SymbolsPerFile; k++)
+    OF.Symbols.push_back(ldl::Symbol{FunctionName(File, k), 8 * k, 1, "D"});
+  for (int k = 0; k < SymbolsPerFile && File > 0; k++) {
+    OF.Symbols.push_back(ldl::Symbol{FunctionName(File - 1, k), 0, 0, "U"});
+    OF.Relocations.push_back(ldl::Relocation{8 * k, 1, SymbolsPerFile + k + 1, "RS4"});
+  }
+  OF.FH = ldl::FileHeader{"LINK", 1, static_cast<int>(OF.Symbols.size()), static_cast<int>(OF.Relocations.size())};
+  return ldl::ObjectWriter{OF}.Write(FileName);
+}
+
+static double Milliseconds(std::chrono::steady_clock::duration D) {
+  return std::chrono::duration<double, std::milli>(D).count();
+}
+
+static double Update(const std::vector<std::string>& FileNames, const std::string& IndexFile, ldl::XRefBuilder& Builder) {
+  auto Start = std::chrono::steady_clock::now();
+  Builder.Update(FileNames);
+  Builder.Write(IndexFile);
+  return Milliseconds(std::chrono::steady_clock::now() - Start);
+}
+
+int main(int argc, char** argv) {
+  int NumberOfFiles = argc > 1 ? std::atoi(argv[1]) : 2000;
+  std::string Prefix = "/tmp/ldl-xref-benchmark-" + std::to_string(getpid());
+  std::string IndexFile = Prefix + ".xref";
+  std::vector<std::string> FileNames;
+  for (int i = 0; i < NumberOfFiles; i++) {
+    FileNames.push_back(Prefix + "-" + std::to_string(i) + ".pof");
+    if (!WriteObject(FileNames.back(), i, 0)) {
+      std::cerr << "could not write " << FileNames.back() << std::endl;
+      return 1;
+    }
+  }
+
+  try {
+    ldl::XRefBuilder Full;
+    double FullTime = Update(FileNames, IndexFile, Full);
+
+    ldl::XRefBuilder Unchanged;
+    auto Start = std::chrono::steady_clock::now();
+    Unchanged.Load(IndexFile);
+    double UnchangedTime = Milliseconds(std::chrono::steady_clock::now() - Start) + Update(FileNames, IndexFile, Unchanged);
+
+    WriteObject(FileNames[NumberOfFiles / 2], NumberOfFiles / 2, 1);
+    ldl::XRefBuilder OneChanged;
+    Start = std::chrono::steady_clock::now();
+    OneChanged.Load(IndexFile);
+    double OneChangedTime = Milliseconds(std::chrono::steady_clock::now() - Start) + Update(FileNames, IndexFile, OneChanged);
+
+    ldl::XRefIndex Index{IndexFile};
+    size_t Postings = 0;
+    Start = std::chrono::steady_clock::now();
+    for (int i = 0; i < NumberOfLookups; i++)
+      Postings += Index.Lookup(FunctionName((i * 7919) % NumberOfFiles, i % SymbolsPerFile)).size();
+    double LookupTime = Milliseconds(std::chrono::steady_clock::now() - Start);
+
+    std::cout << "files: " << NumberOfFiles << ", names: " << Index.NumberOfNames()
+              << ", postings: " << Index.NumberOfPostings() << std::endl
+              << "full build: " << FullTime << " ms (" << Full.Read << " files read)" << std::endl
+              << "update, nothing changed: " << UnchangedTime << " ms (" << Unchanged.Read << " files read)" << std::endl
+              << "update, one file changed: " << OneChangedTime << " ms (" << OneChanged.Read << " files read)" << std::endl
+              << "lookup: " << 1000 * LookupTime / NumberOfLookups << " us (" << Postings << " postings)" << std::endl;
+  } catch (const char* Message) {
+    std::cerr << Message << std::endl;
+  }
+
+  for (auto& FileName : FileNames)
+    std::remove(FileName.c_str());
+  std::remove(IndexFile.c_str());
+  return 0;
+}
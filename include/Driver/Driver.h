@@ -0,0 +1,68 @@
+#ifndef Driver_h
+#define Driver_h
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <Linker/Linker.h>
+
+namespace ldl {
+
+// Everything the linker command line can ask for, shared by the linker
+// executable and the link server so both accept the same arguments.
+class LinkOptions {
+public:
+  std::string Output = "a.out";
+  std::string Format = "pof";
+  std::string Entry = "_start";
+  int ImageBase = -1;
+  std::string SymbolOrderingFile;
+  std::string CallGraphProfile;
+  bool TailMergeStrings = false;
+  // Write a shared library, and the libraries to import functions from.
+  bool Shared = false;
+  std::vector<std::string> Libraries;
+  // Stamp the output with a hash of itself.
+  BuildIdKind BuildId = BuildIdKind::None;
+  // Write a relocatable object (-r) rather than an image.
+  bool Relocatable = false;
+  // Partially link this many consecutive slices of the inputs in worker
+  // processes, then link their outputs.
+  int Shards = 1;
+  // Write POF segment data as compressed blocks.
+  bool Compress = false;
+  // Report what the link did on the diagnostics stream.
+  bool Stats = false;
+  // Print each phase of the link, with its allocations and the memory of
+  // the linker's structures, as it ends.
+  bool Trace = false;
+  std::vector<std::string> FileNames;
+
+  // Set for the server and client modes rather than a link.
+  std::string ServerSocket;
+  std::string ConnectSocket;
+};
+
+void PrintUsage(std::ostream& Errors);
+
+// Parses linker arguments (without the program name).
+bool ParseLinkOptions(const std::vector<std::string>& Args, LinkOptions& Options, std::ostream& Errors);
+
+void PrintLinkStats(const LinkStats& Stats, std::ostream& OS);
+// The phases of a link and the high-water marks of its structures.
+void PrintMemoryStats(const MemoryStats& Memory, std::ostream& OS);
+
+// Links Options.FileNames with L and writes the output. Returns the exit
+// status; failures are reported on Errors.
+int RunLink(const LinkOptions& Options, Linker& L, std::ostream& Errors);
+
+// Links with Options.Shards worker processes. Input k of n goes to shard
+// k * Shards / n, and shard i writes Options.Output followed by ".shard" and
+// i, which the final link in this process reads and then removes. The final
+// link sees the inputs in their original order, so it writes the same
+// output as RunLink.
+int RunShardedLink(const LinkOptions& Options, Linker& L, std::ostream& Errors);
+}
+
+#endif
@@ -0,0 +1,312 @@
+#ifndef ElfReader_h
+#define ElfReader_h
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+
+#include <elf.h>
+
+#include <ElfReader/MappedFile.h>
+#include <ObjectReader/ObjectReader.h>
+
+namespace ldl {
+
+// Reads an x86-64 ELF64 relocatable object (.o) into the same
+// Segment/Symbol/Relocation model that ObjectReader builds from POF.
+//
+// Allocated sections become segments: NOBITS sections are "RW", writable
+// sections "RWP" and everything else "RP". Segment bytes are not copied;
+// Segment::RawData points into the file mapping. Read-only SHF_MERGE
+// sections become mergeable segments.
+//
+// Symbol types follow POF: "D" for global definitions, "U" for undefined
+// references (with a non-zero Value for common symbols), "W" and "w" for
+// STB_WEAK definitions and references, and "L" for local definitions.
+// Section symbols are "L" too, but decode to
+// SymbolType::Section. Relocations always refer to symbols, so they use
+// the symbol forms: "AS4", "RS4" and "AS8".
+//
+// Members of COMDAT section groups get the group's signature as their
+// Segment::Group. Members of groups that KeepGroup rejects are marked
+// Discarded without touching their bytes or their relocations.
+class ElfReader {
+
+public:
+  std::string FileName;
+  std::shared_ptr<MappedFile> Mapping;
+
+  FileHeader FH;
+  std::vector<Segment> Segments;
+  SymbolTable Symbols;
+  RelocationTable Relocations;
+  GroupFilter KeepGroup;
+
+  ElfReader(std::string FileName)
+  : FileName{FileName},
+    Mapping{std::make_shared<MappedFile>(FileName)} { }
+
+  using ObjectFilePtr = std::unique_ptr<ObjectFile>;
+
+  ObjectFilePtr GetObjectFile() {
+    bool ReadFileSuccess = ReadFile();
+    if (ReadFileSuccess == false) throw "Read file failed";
+
+    ObjectFilePtr OFPtr = std::make_unique<ObjectFile>();
+    OFPtr->FileName = FileName;
+    OFPtr->FH = std::move(FH);
+    OFPtr->Segments = std::move(Segments);
+    OFPtr->Symbols = std::move(Symbols);
+    OFPtr->Relocations = std::move(Relocations);
+    return OFPtr;
+  }
+
+  static bool IsElfFile(const std::string& FileName) {
+    std::ifstream IFS{FileName, std::ios::binary};
+    char Ident[SELFMAG];
+    if (!IFS.read(Ident, SELFMAG))
+      return false;
+    return std::string(Ident, SELFMAG) == std::string(ELFMAG, SELFMAG);
+  }
+
+  bool ReadFile() {
+    bool ReadFileHeaderSuccess = ReadFileHeader();
+    if (ReadFileHeaderSuccess == false) return false;
+    bool ReadSegmentHeadersSuccess = ReadSegmentHeaders();
+    bool ReadSymbolTableSuccess = ReadSymbolTable();
+    bool ReadRelocationsSuccess = ReadRelocations();
+
+    if (ReadSegmentHeadersSuccess
+      && ReadSymbolTableSuccess
+      && ReadRelocationsSuccess) {
+      FH.NumberOfSegments = static_cast<int>(Segments.size());
+      FH.NumberOfSymbols = static_cast<int>(Symbols.size());
+      FH.NumberOfRelocations = static_cast<int>(Relocations.size());
+      return true;
+    }
+    return false;
+  }
+
+  bool ReadFileHeader() {
+    if (Mapping->Size < sizeof(Elf64_Ehdr))
+      return false;
+    EH = reinterpret_cast<const Elf64_Ehdr*>(Mapping->Bytes);
+    if (std::string_view(reinterpret_cast<const char*>(EH->e_ident), SELFMAG) != std::string_view(ELFMAG, SELFMAG)
+      || EH->e_ident[EI_CLASS] != ELFCLASS64
+      || EH->e_ident[EI_DATA] != ELFDATA2LSB
+      || EH->e_type != ET_REL
+      || EH->e_machine != EM_X86_64
+      || EH->e_shentsize != sizeof(Elf64_Shdr))
+      return false;
+    if (!InMapping(EH->e_shoff, EH->e_shnum * sizeof(Elf64_Shdr))
+      || EH->e_shstrndx >= EH->e_shnum)
+      return false;
+
+    Sections = reinterpret_cast<const Elf64_Shdr*>(Mapping->Bytes + EH->e_shoff);
+    NumberOfSections = EH->e_shnum;
+    SectionToSegment.assign(NumberOfSections, 0);
+    FH.Magic = "LINK";
+    return true;
+  }
+
+  bool ReadSegmentHeaders() {
+    if (ReadGroups() == false)
+      return false;
+    for (size_t i = 1; i < NumberOfSections; i++) {
+      const Elf64_Shdr& SH = Sections[i];
+      if (!(SH.sh_flags & SHF_ALLOC))
+        continue;
+      if (SH.sh_type != SHT_NOBITS && !InMapping(SH.sh_offset, SH.sh_size))
+        return false;
+      if ((SH.sh_addralign & (SH.sh_addralign - 1)) != 0 || SH.sh_addralign > 0x1000)
+        return false;
+
+      Segment S;
+      S.FileName = FileName;
+      S.Name = SectionName(i);
+      S.Address = static_cast<int>(SH.sh_addr);
+      S.Length = static_cast<int>(SH.sh_size);
+      // Layout never packs inputs closer than 4 bytes.
+      S.Alignment = std::max(4, static_cast<int>(SH.sh_addralign));
+      if (SH.sh_type == SHT_NOBITS)
+        S.SetCode("RW");
+      else if (SH.sh_flags & SHF_WRITE)
+        S.SetCode("RWP");
+      else
+        S.SetCode("RP");
+      if ((SH.sh_flags & SHF_MERGE) && S.Permissions == SegmentPermissions::RP) {
+        if ((SH.sh_flags & SHF_STRINGS) && SH.sh_entsize == 1)
+          S.MergeStrings = true;
+        else if (!(SH.sh_flags & SHF_STRINGS) && SH.sh_entsize > 0)
+          S.MergeEntrySize = static_cast<int>(SH.sh_entsize);
+      }
+      S.Group = SectionGroups[i];
+      if (!S.Group.empty() && KeepGroup && !KeepGroup(S.Group))
+        S.Discarded = true;
+      else if (SH.sh_type != SHT_NOBITS)
+        S.RawData = Mapping->View(SH.sh_offset, SH.sh_size);
+      S.Owner = Mapping;
+
+      Segments.push_back(S);
+      SectionToSegment[i] = static_cast<int>(Segments.size());
+    }
+    return true;
+  }
+
+  // Finds the signature of every section in a COMDAT group.
+  bool ReadGroups() {
+    SectionGroups.assign(NumberOfSections, std::string{});
+    for (size_t i = 1; i < NumberOfSections; i++) {
+      const Elf64_Shdr& SH = Sections[i];
+      if (SH.sh_type != SHT_GROUP)
+        continue;
+      if (!InMapping(SH.sh_offset, SH.sh_size) || SH.sh_link >= NumberOfSections)
+        return false;
+      auto Words = reinterpret_cast<const Elf32_Word*>(Mapping->Bytes + SH.sh_offset);
+      size_t NumberOfWords = SH.sh_size / sizeof(Elf32_Word);
+      if (NumberOfWords == 0 || !(Words[0] & GRP_COMDAT))
+        continue;
+
+      const Elf64_Shdr& SymTab = Sections[SH.sh_link];
+      if (SymTab.sh_link >= NumberOfSections
+        || SH.sh_info >= SymTab.sh_size / sizeof(Elf64_Sym)
+        || !InMapping(SymTab.sh_offset, SymTab.sh_size))
+        return false;
+      auto& Signature = reinterpret_cast<const Elf64_Sym*>(Mapping->Bytes + SymTab.sh_offset)[SH.sh_info];
+      std::string Name{StringAt(Sections[SymTab.sh_link], Signature.st_name)};
+      for (size_t j = 1; j < NumberOfWords; j++)
+        if (Words[j] < NumberOfSections)
+          SectionGroups[Words[j]] = Name;
+    }
+    return true;
+  }
+
+  bool ReadSymbolTable() {
+    const Elf64_Shdr* SymTab = nullptr;
+    for (size_t i = 1; i < NumberOfSections; i++)
+      if (Sections[i].sh_type == SHT_SYMTAB)
+        SymTab = &Sections[i];
+    if (SymTab == nullptr)
+      return true;
+    if (!InMapping(SymTab->sh_offset, SymTab->sh_size)
+      || SymTab->sh_link >= NumberOfSections)
+      return false;
+
+    const Elf64_Shdr& StrTab = Sections[SymTab->sh_link];
+    auto ElfSymbols = reinterpret_cast<const Elf64_Sym*>(Mapping->Bytes + SymTab->sh_offset);
+    size_t NumberOfElfSymbols = SymTab->sh_size / sizeof(Elf64_Sym);
+    ElfToSymbol.assign(NumberOfElfSymbols, 0);
+
+    for (size_t i = 1; i < NumberOfElfSymbols; i++) {
+      const Elf64_Sym& ES = ElfSymbols[i];
+      if (ELF64_ST_TYPE(ES.st_info) == STT_FILE)
+        continue;
+
+      std::string_view Name;
+      if (ELF64_ST_TYPE(ES.st_info) == STT_SECTION && ES.st_shndx < NumberOfSections)
+        Name = SectionName(ES.st_shndx);
+      else
+        Name = StringAt(StrTab, ES.st_name);
+
+      bool Weak = ELF64_ST_BIND(ES.st_info) == STB_WEAK;
+      if (ES.st_shndx == SHN_UNDEF)
+        Symbols.Add(Name, 0, 0, Weak ? SymbolType::WeakUndefined : SymbolType::Undefined);
+      else if (ES.st_shndx == SHN_COMMON)
+        Symbols.Add(Name, static_cast<int>(ES.st_size), 0, SymbolType::Undefined);
+      else
+        Symbols.Add(Name,
+          static_cast<int>(ES.st_value),
+          ES.st_shndx < NumberOfSections ? SectionToSegment[ES.st_shndx] : 0,
+          ELF64_ST_TYPE(ES.st_info) == STT_SECTION ? SymbolType::Section
+            : ELF64_ST_BIND(ES.st_info) == STB_LOCAL ? SymbolType::Local
+            : Weak ? SymbolType::Weak : SymbolType::Defined);
+      ElfToSymbol[i] = static_cast<int>(Symbols.size());
+    }
+    return true;
+  }
+
+  bool ReadRelocations() {
+    for (size_t i = 1; i < NumberOfSections; i++) {
+      const Elf64_Shdr& SH = Sections[i];
+      if (SH.sh_type == SHT_REL)
+        return false;
+      if (SH.sh_type != SHT_RELA || SH.sh_info >= NumberOfSections)
+        continue;
+      int SegmentNumber = SectionToSegment[SH.sh_info];
+      if (SegmentNumber == 0 || Segments[SegmentNumber - 1].Discarded)
+        continue;
+      if (!InMapping(SH.sh_offset, SH.sh_size))
+        return false;
+
+      auto Entries = reinterpret_cast<const Elf64_Rela*>(Mapping->Bytes + SH.sh_offset);
+      size_t NumberOfEntries = SH.sh_size / sizeof(Elf64_Rela);
+      for (size_t j = 0; j < NumberOfEntries; j++) {
+        bool ReadRelocationEntrySuccess = ReadRelocationEntry(Entries[j], SegmentNumber);
+        if (ReadRelocationEntrySuccess == false) return false;
+      }
+    }
+    return true;
+  }
+
+  bool ReadRelocationEntry(const Elf64_Rela& ER, int SegmentNumber) {
+    size_t ElfSymbol = ELF64_R_SYM(ER.r_info);
+    if (ElfSymbol >= ElfToSymbol.size())
+      return false;
+
+    RelocationType Type;
+    switch (ELF64_R_TYPE(ER.r_info)) {
+    case R_X86_64_64:
+      Type = RelocationType::AS8;
+      break;
+    case R_X86_64_32:
+      Type = RelocationType::AS4;
+      break;
+    case R_X86_64_32S:
+      Type = RelocationType::AS4S;
+      break;
+    case R_X86_64_PC32:
+    case R_X86_64_PLT32:
+      Type = RelocationType::RS4;
+      break;
+    default:
+      return false;
+    }
+
+    Relocations.Add(static_cast<int>(ER.r_offset), SegmentNumber, ElfToSymbol[ElfSymbol], Type, static_cast<int>(ER.r_addend));
+    return true;
+  }
+
+private:
+  const Elf64_Ehdr* EH = nullptr;
+  const Elf64_Shdr* Sections = nullptr;
+  size_t NumberOfSections = 0;
+  std::vector<int> SectionToSegment;
+  std::vector<int> ElfToSymbol;
+  std::vector<std::string> SectionGroups;
+
+  // Whether Size bytes at Offset lie in the file, without the sum wrapping
+  // for offsets and sizes read from a damaged header.
+  bool InMapping(uint64_t Offset, uint64_t Size) const {
+    return Offset <= Mapping->Size && Size <= Mapping->Size - Offset;
+  }
+
+  // Strings point into the mapping.
+  std::string_view StringAt(const Elf64_Shdr& StrTab, size_t Offset) {
+    if (StrTab.sh_offset >= Mapping->Size || Offset >= Mapping->Size - StrTab.sh_offset
+      || Offset >= StrTab.sh_size)
+      return "";
+    auto Start = reinterpret_cast<const char*>(Mapping->Bytes + StrTab.sh_offset + Offset);
+    size_t Limit = std::min<size_t>(StrTab.sh_size - Offset, Mapping->Size - StrTab.sh_offset - Offset);
+    return std::string_view(Start, strnlen(Start, Limit));
+  }
+
+  std::string_view SectionName(size_t Index) {
+    return StringAt(Sections[EH->e_shstrndx], Sections[Index].sh_name);
+  }
+};
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef MappedFile_h
+#define MappedFile_h
+
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ldl {
+
+// A read-only private mapping of a whole file. Segments read from binary
+// inputs point into the mapping instead of copying their bytes, so the
+// mapping is shared with every ObjectFile built from it.
+class MappedFile {
+public:
+  std::string FileName;
+  const unsigned char* Bytes = nullptr;
+  size_t Size = 0;
+
+  MappedFile(std::string FileName) :FileName{FileName} {
+    int FD = open(FileName.c_str(), O_RDONLY | O_CLOEXEC);
+    if (FD < 0)
+      throw "Could not open mapped file";
+
+    struct stat ST;
+    if (fstat(FD, &ST) != 0) {
+      close(FD);
+      throw "Could not stat mapped file";
+    }
+
+    Size = static_cast<size_t>(ST.st_size);
+    if (Size != 0) {
+      void* Addr = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, FD, 0);
+      if (Addr == MAP_FAILED) {
+        close(FD);
+        throw "Could not map file";
+      }
+      Bytes = static_cast<const unsigned char*>(Addr);
+    }
+    close(FD);
+  }
+
+  ~MappedFile() {
+    if (Bytes)
+      munmap(const_cast<unsigned char*>(Bytes), Size);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  std::string_view View(size_t Offset, size_t Length) const {
+    return std::string_view{reinterpret_cast<const char*>(Bytes) + Offset, Length};
+  }
+};
+}
+
+#endif
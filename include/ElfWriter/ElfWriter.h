@@ -0,0 +1,181 @@
+#ifndef ElfWriter_h
+#define ElfWriter_h
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <Linker/Linker.h>
+
+namespace ldl {
+
+// Writes the layout produced by Linker as a static x86-64 ELF64 executable.
+//
+// The RP segments become one R+X PT_LOAD. The RWP segments become an R+W
+// PT_LOAD whose memory size also covers the RW segments, so BSS-like
+// segments are zero-filled by the kernel instead of taking file space.
+// Each load's file offset is congruent to its address modulo the page size.
+//
+// The whole file size is known up front, so the output is preallocated,
+// mapped once and filled in place.
+class ElfWriter {
+public:
+  static constexpr int PageSize = 0x1000;
+
+  Linker& L;
+  std::string EntrySymbol = "_start";
+
+  class LoadSegment {
+  public:
+    std::vector<OutSegment>* Segments;
+    Elf64_Phdr Header;
+  };
+  std::vector<LoadSegment> Loads;
+  size_t FileSize = 0;
+
+  ElfWriter(Linker& L) :L{L} { }
+
+  void Write(const std::string& FileName) {
+    if (L.RPSegments.empty() || L.RWPSegments.empty())
+      throw "Linker has not laid out its segments";
+    Layout();
+    // Checked before the output is created, so a failed link leaves none.
+    CheckRelocations();
+    EntryAddress();
+
+    int FD = open(FileName.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0755);
+    if (FD < 0)
+      throw "Could not open ELF output";
+    if (ftruncate(FD, static_cast<off_t>(FileSize)) != 0) {
+      close(FD);
+      throw "Could not size ELF output";
+    }
+    void* Addr = mmap(nullptr, FileSize, PROT_READ | PROT_WRITE, MAP_SHARED, FD, 0);
+    close(FD);
+    if (Addr == MAP_FAILED)
+      throw "Could not map ELF output";
+
+    auto Buffer = static_cast<unsigned char*>(Addr);
+    WriteHeaders(Buffer);
+    for (auto& Load : Loads)
+      WriteLoadSegment(Buffer, Load);
+
+    munmap(Addr, FileSize);
+  }
+
+  void Layout() {
+    Loads.clear();
+    Loads.push_back(MakeLoad(L.RPSegments, L.RPSegments, PF_R | PF_X));
+    Loads.push_back(MakeLoad(L.RWPSegments, L.RWSegments, PF_R | PF_W));
+
+    size_t Offset = sizeof(Elf64_Ehdr) + NumberOfProgramHeaders() * sizeof(Elf64_Phdr);
+    for (auto& Load : Loads) {
+      Elf64_Phdr& PH = Load.Header;
+      size_t PageStart = (Offset + PageSize - 1) & ~static_cast<size_t>(PageSize - 1);
+      PH.p_offset = PageStart + PH.p_vaddr % PageSize;
+      Offset = PH.p_offset + PH.p_filesz;
+    }
+    FileSize = Offset;
+  }
+
+  size_t NumberOfProgramHeaders() {
+    // The loads plus a PT_GNU_STACK to keep the stack non-executable.
+    return Loads.size() + 1;
+  }
+
+  // An executable that starts anywhere but its entry symbol would run the
+  // wrong code, so a missing one fails the link.
+  Elf64_Addr EntryAddress() {
+    int Address;
+    if (!L.SymbolAddress(EntrySymbol, Address))
+      throw "Entry symbol is not defined";
+    return static_cast<Elf64_Addr>(Address);
+  }
+
+  // The words an assembler leaves for the linker are placeholders, so an
+  // executable with any of them unfilled would run the wrong code.
+  void CheckRelocations() {
+    bool HasRelocations = std::any_of(L.ObjectFiles.begin(), L.ObjectFiles.end(), [](auto& OF) {
+      return !OF->Relocations.empty();
+    });
+    if (HasRelocations && !L.RelocationsProcessed)
+      throw "Linker has not applied its relocations";
+    if (L.Stats.RelocationsUndefined + L.Stats.RelocationsInvalid + L.Stats.RelocationsOverflowed > 0)
+      throw "Linker left relocations unapplied";
+  }
+
+private:
+  LoadSegment MakeLoad(std::vector<OutSegment>& FileBacked, std::vector<OutSegment>& ZeroFilled, Elf64_Word Flags) {
+    LoadSegment Load;
+    Load.Segments = &FileBacked;
+    Elf64_Phdr& PH = Load.Header;
+    std::memset(&PH, 0, sizeof(PH));
+    PH.p_type = PT_LOAD;
+    PH.p_flags = Flags;
+    PH.p_vaddr = static_cast<Elf64_Addr>(FileBacked.front().Address);
+    PH.p_paddr = PH.p_vaddr;
+    PH.p_filesz = static_cast<Elf64_Addr>(FileBacked.back().Address + FileBacked.back().Length) - PH.p_vaddr;
+    PH.p_memsz = static_cast<Elf64_Addr>(ZeroFilled.back().Address + ZeroFilled.back().Length) - PH.p_vaddr;
+    if (PH.p_memsz < PH.p_filesz)
+      PH.p_memsz = PH.p_filesz;
+    PH.p_align = PageSize;
+    return Load;
+  }
+
+  void WriteHeaders(unsigned char* Buffer) {
+    Elf64_Ehdr EH;
+    std::memset(&EH, 0, sizeof(EH));
+    std::memcpy(EH.e_ident, ELFMAG, SELFMAG);
+    EH.e_ident[EI_CLASS] = ELFCLASS64;
+    EH.e_ident[EI_DATA] = ELFDATA2LSB;
+    EH.e_ident[EI_VERSION] = EV_CURRENT;
+    EH.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    EH.e_type = ET_EXEC;
+    EH.e_machine = EM_X86_64;
+    EH.e_version = EV_CURRENT;
+    EH.e_entry = EntryAddress();
+    EH.e_phoff = sizeof(Elf64_Ehdr);
+    EH.e_ehsize = sizeof(Elf64_Ehdr);
+    EH.e_phentsize = sizeof(Elf64_Phdr);
+    EH.e_phnum = static_cast<Elf64_Half>(NumberOfProgramHeaders());
+    EH.e_shentsize = sizeof(Elf64_Shdr);
+    std::memcpy(Buffer, &EH, sizeof(EH));
+
+    auto PH = reinterpret_cast<Elf64_Phdr*>(Buffer + sizeof(Elf64_Ehdr));
+    for (auto& Load : Loads)
+      std::memcpy(PH++, &Load.Header, sizeof(Elf64_Phdr));
+
+    Elf64_Phdr Stack;
+    std::memset(&Stack, 0, sizeof(Stack));
+    Stack.p_type = PT_GNU_STACK;
+    Stack.p_flags = PF_R | PF_W;
+    Stack.p_align = 16;
+    std::memcpy(PH, &Stack, sizeof(Stack));
+  }
+
+  void WriteLoadSegment(unsigned char* Buffer, LoadSegment& Load) {
+    unsigned char* Base = Buffer + Load.Header.p_offset;
+    for (auto& O : *Load.Segments) {
+      unsigned char* Out = Base + (O.Address - Load.Header.p_vaddr);
+      size_t Bytes = std::min(O.Data.size() / 2, static_cast<size_t>(O.Length));
+      for (size_t i = 0; i < Bytes; i++)
+        Out[i] = static_cast<unsigned char>(HexValue(O.Data[2 * i]) << 4 | HexValue(O.Data[2 * i + 1]));
+    }
+  }
+
+  static int HexValue(char C) {
+    if (C >= '0' && C <= '9') return C - '0';
+    if (C >= 'a' && C <= 'f') return C - 'a' + 10;
+    if (C >= 'A' && C <= 'F') return C - 'A' + 10;
+    return 0;
+  }
+};
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef LinkServer_h
+#define LinkServer_h
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <Linker/Linker.h>
+#include <Linker/ObjectCache.h>
+
+namespace ldl {
+
+// A persistent linker listening on a local Unix socket. It links with one
+// reusable Linker context and keeps parsed inputs in an ObjectCache, so a
+// repeated link of mostly unchanged inputs only pays for layout and output.
+//
+// Requests are newline-separated: "LINK", the client's working directory,
+// then the linker arguments, ending with an empty line; or "SHUTDOWN"
+// followed by an empty line. The reply is the exit status on the first line
+// followed by any diagnostics.
+class LinkServer {
+public:
+  std::string SocketPath;
+  ObjectCache Cache;
+  Linker L;
+  size_t Requests = 0;
+  // Seconds a client may leave the server waiting on a read or a write
+  // before it is dropped, so that a stalled client does not hold up others.
+  int ClientTimeout = 5;
+
+  LinkServer(std::string SocketPath);
+  ~LinkServer();
+
+  // Binds and listens on SocketPath, replacing a stale socket file.
+  void Listen();
+  // Answers requests until a shutdown request arrives.
+  void Serve();
+  // Handles one request; returns false for a shutdown request.
+  bool HandleRequest(const std::vector<std::string>& Lines, std::string& Reply);
+
+private:
+  int ListenFD = -1;
+};
+
+// Sends a link request for Args, relative to the current directory, to the
+// server on SocketPath. Returns the server's exit status and copies its
+// diagnostics to Errors.
+int ForwardToLinkServer(const std::string& SocketPath, const std::vector<std::string>& Args, std::ostream& Errors);
+int ShutdownLinkServer(const std::string& SocketPath);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef BuildId_h
+#define BuildId_h
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace ldl {
+
+enum class BuildIdKind {
+  None,
+  // An 8-byte XXH64 tree hash.
+  Fast,
+  // A 32-byte SHA-256 tree hash.
+  SHA256
+};
+
+// Content hashes identifying a link's output.
+//
+// The bytes are cut into ChunkSize chunks, which are hashed in parallel;
+// the build-id is then the hash of the chunk digests followed by the total
+// length as a little-endian 64-bit word. The result depends only on the
+// bytes, never on how many threads hashed them.
+class BuildId {
+public:
+  static constexpr size_t ChunkSize = 1 << 20;
+
+  static size_t Size(BuildIdKind Kind);
+  static std::string Compute(BuildIdKind Kind, std::string_view Bytes);
+
+  // The hash of a single run of bytes, as Compute uses it for the chunks
+  // and the root. XXH64 digests are little-endian.
+  static std::string Hash(BuildIdKind Kind, std::string_view Bytes);
+  static uint64_t XXHash64(std::string_view Bytes, uint64_t Seed = 0);
+  static std::string SHA256(std::string_view Bytes);
+};
+}
+
+#endif
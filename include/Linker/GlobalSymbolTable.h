@@ -0,0 +1,90 @@
+#ifndef GlobalSymbolTable_h
+#define GlobalSymbolTable_h
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ldl {
+
+// The output address of every defined global name, in an open-addressed
+// table over two vectors, so that a link sized up front with reserve makes
+// no allocation per symbol. The names are views of the object files'
+// name pools, which outlive the table.
+class GlobalSymbolTable {
+public:
+  using Entry = std::pair<std::string_view, long>;
+
+  // Makes room for N names without growing.
+  void reserve(size_t N) {
+    Entries.reserve(N);
+    if (2 * N > Slots.size())
+      Rehash(2 * N);
+  }
+
+  void clear() {
+    Entries.clear();
+    std::fill(Slots.begin(), Slots.end(), EmptySlot);
+  }
+
+  size_t size() const { return Entries.size(); }
+  std::vector<Entry>::const_iterator begin() const { return Entries.begin(); }
+  std::vector<Entry>::const_iterator end() const { return Entries.end(); }
+
+  // Adds Name at Address unless it is already in the table.
+  bool Add(std::string_view Name, long Address) {
+    if (2 * (Entries.size() + 1) > Slots.size())
+      Rehash(2 * Slots.size());
+    uint32_t& Slot = Slots[Probe(Name)];
+    if (Slot != EmptySlot)
+      return false;
+    Slot = static_cast<uint32_t>(Entries.size());
+    Entries.emplace_back(Name, Address);
+    return true;
+  }
+
+  bool Find(std::string_view Name, long& Address) const {
+    if (Slots.empty())
+      return false;
+    uint32_t Slot = Slots[Probe(Name)];
+    if (Slot == EmptySlot)
+      return false;
+    Address = Entries[Slot].second;
+    return true;
+  }
+
+  // The heap bytes of the table.
+  size_t Bytes() const {
+    return Entries.capacity() * sizeof(Entry) + Slots.capacity() * sizeof(uint32_t);
+  }
+
+private:
+  static constexpr uint32_t EmptySlot = UINT32_MAX;
+  std::vector<Entry> Entries;
+  // Indices into Entries, a power of two of them, at most half in use.
+  std::vector<uint32_t> Slots;
+
+  // The slot that holds Name, or the empty one where it would go.
+  size_t Probe(std::string_view Name) const {
+    size_t Mask = Slots.size() - 1;
+    size_t i = std::hash<std::string_view>{}(Name) & Mask;
+    while (Slots[i] != EmptySlot && Entries[Slots[i]].first != Name)
+      i = (i + 1) & Mask;
+    return i;
+  }
+
+  void Rehash(size_t N) {
+    size_t Size = 16;
+    while (Size < N)
+      Size *= 2;
+    Slots.assign(Size, EmptySlot);
+    for (size_t k = 0; k < Entries.size(); k++)
+      Slots[Probe(Entries[k].first)] = static_cast<uint32_t>(k);
+  }
+};
+}
+
+#endif
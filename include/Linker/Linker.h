@@ -4,13 +4,57 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <deque>
 #include <map>
+#include <string_view>
+#include <unordered_map>
 
 #include <ObjectReader/ObjectReader.h>
+#include <Linker/BuildId.h>
+#include <Linker/GlobalSymbolTable.h>
+#include <Linker/MemoryStats.h>
+#include <Linker/SegmentMerging.h>
+#include <Linker/SegmentOrdering.h>
 
 namespace ldl {
 
 using ObjectFilePtr = std::unique_ptr<ObjectFile>;
+using SharedObjectFilePtr = std::shared_ptr<const ObjectFile>;
+
+class ObjectCache;
+
+// Reads a POF or ELF relocatable object, picking the reader by its magic.
+// Members of the link-once groups KeepGroup rejects are read as headers
+// only.
+ObjectFilePtr ReadObjectFile(const std::string& FileName, const GroupFilter& KeepGroup = nullptr);
+
+// Counters a link keeps about the work it did, for --stats.
+class LinkStats {
+public:
+  // Link-once groups kept, copies of groups dropped because an earlier
+  // object defined them, and the segments and bytes those copies held.
+  size_t GroupsKept = 0;
+  size_t GroupsDiscarded = 0;
+  size_t SegmentsDiscarded = 0;
+  size_t BytesDiscarded = 0;
+
+  // Pieces of mergeable segments read, how many were unique, and the bytes
+  // merging saved.
+  size_t MergePieces = 0;
+  size_t UniqueMergePieces = 0;
+  size_t MergeBytesSaved = 0;
+
+  // Relocations applied, left unapplied because their symbol is undefined,
+  // skipped because they do not fit their segment or name no target, and
+  // skipped because their value does not fit their word.
+  size_t RelocationsApplied = 0;
+  size_t RelocationsUndefined = 0;
+  size_t RelocationsInvalid = 0;
+  size_t RelocationsOverflowed = 0;
+  // Of the invalid ones, words into a merged segment that point at no piece
+  // of it, so no address can be given for them.
+  size_t RelocationsIntoMerged = 0;
+};
 
   class SegmentMapping {
   public:
@@ -24,16 +68,24 @@ using ObjectFilePtr = std::unique_ptr<ObjectFile>;
       End{End} {}
     };
 
+  // A link context. One Linker can run any number of links one after the
+  // other: Link() (or Reset()) clears the previous link's results but keeps
+  // the capacity of its tables and scratch buffers, so a long-running process
+  // stops allocating once it has seen its largest link. Linkers share no
+  // state, so independent contexts can link concurrently on separate threads.
   class Linker {
   public:
     using ObjectFileMapping = std::map<std::string, SegmentMapping>;
     std::map<std::string, ObjectFileMapping> Mappings;
     std::vector<std::string> FileNames;
-    std::vector<ObjectFilePtr> ObjectFiles;
-
-    std::vector<Symbol> MergedSymbols;
-    std::vector<Relocation> MergedRelocation;
-    using Permissions = std::string;
+    std::vector<SharedObjectFilePtr> ObjectFiles;
+    // When set, ReadFiles takes parsed inputs from the cache. Cached object
+    // files are shared and never modified by a link.
+    ObjectCache* Cache = nullptr;
+
+    SymbolTable MergedSymbols;
+    RelocationTable MergedRelocation;
+    using Permissions = SegmentPermissions;
     using SegmentName = std::string;
     std::map<Permissions, std::map<SegmentName, std::vector<Segment>>> SegmentDataStructure;
 
@@ -41,191 +93,231 @@ using ObjectFilePtr = std::unique_ptr<ObjectFile>;
     Linker(std::vector<std::string> FileNames) :FileNames{FileNames} { }
     Linker() { }
 
-    void ReadFiles() {
-      for (auto& FileName : FileNames) {
-        ObjectReader OR{FileName};
-        auto OFPtr = OR.GetObjectFile();
-        ObjectFiles.push_back(std::move(OFPtr));
-      }
-
-      for (auto& OF : ObjectFiles) {
-        Mappings[OF->FileName] = ObjectFileMapping{};
-      }
-    }
-
-    ObjectFilePtr GenerateObjectFile() {
-      GenerateOutputFileSymbolTable();
-      GenerateOutputFileSegments();
-      ObjectFilePtr OFPtr = std::make_unique<ObjectFile>();
-      OFPtr->FH = FileHeader{
-        "LINK",
-        static_cast<int>(RPSegments.size() + RWPSegments.size() + RWSegments.size()),
-        static_cast<int>(MergedSymbols.size()),
-        static_cast<int>(MergedRelocation.size())
-      };
-      std::vector<Segment> Ss;
-      Ss.insert(Ss.end(), RPSegments.begin(), RPSegments.end());
-      Ss.insert(Ss.end(), RWPSegments.begin(), RWPSegments.end());
-      Ss.insert(Ss.end(), RWSegments.begin(), RWSegments.end());
-      OFPtr->Segments = std::move(Ss);
-
-      return OFPtr;
-    }
-
-    void MergeSegmentsIntoDataStructure() {
-      for (auto& OFPtr : ObjectFiles) {
-        for (auto& S : OFPtr->Segments) {
-          SegmentDataStructure[S.Code][S.Name].push_back(S);
-        }
-      }
-    }
-
-    OutSegment* TextSegment;
+    // Resets the context and links FileNames into a new object file.
+    ObjectFilePtr Link(const std::vector<std::string>& FileNames);
+    // Forgets everything about the previous link without freeing capacity.
+    void Reset();
+
+    void ReadFiles();
+    ObjectFilePtr GenerateObjectFile();
+    // With Relocatable set, GenerateObjectFile merges the inputs into one
+    // relocatable object instead (ld -r) that links exactly like them: a
+    // final link over partial links of consecutive slices of the inputs
+    // writes the same image as a link over all of them. Runs of same-named
+    // segments are concatenated with the final link's padding; link-once
+    // copies that an earlier input claimed are dropped; mergeable and
+    // grouped segments are kept as they are. Every symbol and relocation is
+    // kept, moved onto the merged segments, with the addends relocations
+    // need for that.
+    bool Relocatable = false;
+    ObjectFilePtr GenerateRelocatableObjectFile();
+    void MergeSegmentsIntoDataStructure();
+
+    // Link-once groups by signature. A group belongs to the first object,
+    // in link order, that has a member of it; other objects' members are
+    // dropped. Inputs read by ReadFiles skip the payload of dropped members.
+    class LinkGroup {
+    public:
+      int Owner;
+      int LastDiscardedBy = -1;
+    };
+    std::unordered_map<std::string, LinkGroup> Groups;
+    // Whether object Index keeps its members of the group, claiming the
+    // group for it if no earlier object has.
+    bool ClaimGroup(const std::string& Signature, int Index);
+
+    LinkStats Stats;
+    // Time, allocations and memory of each phase of the link, kept when
+    // Memory.Enabled is set. A phase ends by measuring the structures below
+    // with MeasureStructures.
+    MemoryStats Memory;
+    void MeasureStructures();
+
+    // Address of the first output segment; everything else follows it.
+    int TextAddress = 0x1000;
+    // Let strings in mergeable segments share the tails of longer strings.
+    bool TailMergeStrings = false;
+    // Order of the .text inputs; command-line order when empty.
+    SegmentOrdering Ordering;
+
+    // Shared libraries, written by links with Shared set, whose exported
+    // functions the inputs may call. Every function imported from them gets
+    // a .plt entry and a .got slot that the loader binds.
+    std::vector<std::string> Libraries;
+    // Write a shared library: the defined symbols are exported through a
+    // .gnu.hash table.
+    bool Shared = false;
+
+    // Finds the linked address of a symbol defined in one of the inputs.
+    // Before relocations are processed, it goes by the segment mappings,
+    // which only tell one segment of a name per input file apart.
+    bool SymbolAddress(const std::string& Name, int& Address);
+
+    OutSegment* TextSegment = nullptr;
     std::vector<OutSegment> RPSegments;
-    OutSegment* DataSegment;
+    OutSegment* DataSegment = nullptr;
     std::vector<OutSegment> RWPSegments;
-    OutSegment* BSSSegment;
+    OutSegment* BSSSegment = nullptr;
     Segment CommonSegment{"NA", ".common", 0x0, 0x0, "RW"};
     std::vector<OutSegment> RWSegments;
 
 
-    void GenerateOutputFileSymbolTable() {
-      MergeSymbolsIntoOneVector();
-      GatherCommonSymbols();
-      CombineCommonSymbolsIntoCommonSegment();
-    }
-
-    void CombineCommonSymbolsIntoCommonSegment() {
-      for (auto& CS : CommonSymbols) {
-        CommonSegment.Length += CS.Value;
-      }
-    }
-
-    std::vector<Symbol> CommonSymbols;
-
-    void GatherCommonSymbols() {
-      for (auto& S : MergedSymbols) {
-        if (S.Type == "U" && S.Value != 0)
-          CommonSymbols.push_back(S);
-      }
-    }
-
-    void MergeSymbolsIntoOneVector() {
-      for (auto& OFPtr : ObjectFiles) {
-        MergedSymbols.insert(MergedSymbols.end(), OFPtr->Symbols.begin(), OFPtr->Symbols.end());
-      }
-    }
-
-    void GenerateOutputFileSegments() {
-      MergeSegmentsIntoDataStructure();
-
-      MergeRPSegments();
-      MergeRWPSegments();
-      MergeRWSegments();
-    }
-
-    void MergeRPSegments() {
-      auto& RPSegmentsDataStructure = SegmentDataStructure["RP"];
-      auto TextSegments = RPSegmentsDataStructure[".text"];
-      RPSegmentsDataStructure.erase(".text");
-      RPSegments.push_back(OutSegment{"a.out", ".text", 0x1000, 0x0, "RP"});
-      TextSegment = &RPSegments.front();
-
-      for (auto& S : TextSegments)
-        AppendTextSegment(S);
-
-
-      for (auto& NameVectorPair : RPSegmentsDataStructure) {
-        OutSegment RPSegment{"a.out", NameVectorPair.first, 0x0, 0x0, "RP"};
-        InitializeSegmentForSamePage(RPSegment, RPSegments.back());
-        for (auto& S : NameVectorPair.second)
-          AppendSegmentToOutSegment(S, RPSegment);
-        RPSegments.push_back(RPSegment);
-      }
-    }
-
-    void MergeRWPSegments() {
-      auto& RWPSegmentsDataStructure = SegmentDataStructure["RWP"];
-      auto DataSegments = RWPSegmentsDataStructure[".data"];
-      RWPSegmentsDataStructure.erase(".data");
-      RWPSegments.push_back(OutSegment{"a.out", ".data", 0x0, 0x0, "RWP"});
-      DataSegment = &RWPSegments.front();
-
-      InitializeSegmentForNewPage(*DataSegment, RPSegments.back());
-      for (auto& S : DataSegments)
-        AppendDataSegment(S);
-
-      for (auto& NameVectorPair : RWPSegmentsDataStructure) {
-        OutSegment RWPSegment{"a.out", NameVectorPair.first, 0x0, 0x0, "RWP"};
-        InitializeSegmentForSamePage(RWPSegment, RWPSegments.back());
-        for (auto& S : NameVectorPair.second)
-          AppendSegmentToOutSegment(S, RWPSegment);
-        RWPSegments.push_back(RWPSegment);
-      }
-    }
-
-    void MergeRWSegments() {
-      auto& RWSegmentsDataStructure = SegmentDataStructure["RW"];
-      auto BSSSegments = RWSegmentsDataStructure[".bss"];
-      RWSegmentsDataStructure.erase(".bss");
-      RWSegments.push_back(OutSegment{"a.out", ".bss", 0x0, 0x0, "RW"});
-      BSSSegment = &RWSegments.front();
-
-      InitializeSegmentForSamePage(*BSSSegment, RWPSegments.back());
-      for (auto& S : BSSSegments)
-        AppendBSSSegment(S);
-
-      AppendBSSSegment(CommonSegment);
-
-      for (auto& NameVectorPair : RWSegmentsDataStructure) {
-        OutSegment RWSegment{"a.out", NameVectorPair.first, 0x0, 0x0, "RW"};
-        InitializeSegmentForSamePage(RWSegment, RWSegments.back());
-        for (auto& S : NameVectorPair.second)
-          AppendSegmentToOutSegment(S, RWSegment);
-        RWSegments.push_back(RWSegment);
-      }
-    }
-
-    void InitializeSegmentForSamePage(OutSegment& Next, OutSegment& Previous) {
-      int ModuloFour = Previous.Length % 4;
-      int BlankSpaceSize = (4 - ModuloFour) % 4;
-
-      Previous.Length += BlankSpaceSize;
-      for (int i = 0; i < BlankSpaceSize; i++)
-        Previous.Data += "00";
-      Next.Address = Previous.Address + Previous.Length;
-    }
-    void InitializeSegmentForNewPage(OutSegment& Next, OutSegment& Previous) {
-      Next.Address = ((Previous.Address + Previous.Length) & 0xF000) + 0x1000;
-    }
-
-    void AppendTextSegment(Segment S) {
-      AppendSegmentToOutSegment(S, *TextSegment);
-    }
-    void AppendDataSegment(Segment S) {
-      AppendSegmentToOutSegment(S, *DataSegment);
-    }
-    void AppendBSSSegment(Segment S) {
-      AppendSegmentToOutSegment(S, *BSSSegment);
-    }
-
-
-    void AppendSegmentToOutSegment(Segment S, OutSegment& O) {
-      O.InputSegments.push_back(S);
-      Segment ContainedSegment = S;
-
-      int ModuloFour = O.Length % 4;
-      int BlankSpaceSize = (4 - ModuloFour) % 4;
-      ContainedSegment.Address = O.Address + O.Length + BlankSpaceSize;
-      O.Length += BlankSpaceSize + ContainedSegment.Length;
-      for (int i = 0; i < BlankSpaceSize; i++)
-        O.Data += "00";
-      O.Data += ContainedSegment.Data;
-
-      O.ContainedSegments.push_back(ContainedSegment);
-
-      Mappings[S.FileName][S.Name] = SegmentMapping(S.Name, ContainedSegment.Address, ContainedSegment.Address + ContainedSegment.Length -1);
-    }
+    void GenerateOutputFileSymbolTable();
+    void CombineCommonSymbolsIntoCommonSegment();
+
+    // Rows of MergedSymbols that are common symbols, and the offset of each
+    // in CommonSegment.
+    std::vector<uint32_t> CommonSymbols;
+    std::vector<int> CommonOffsets;
+
+    void GatherCommonSymbols();
+    void MergeSymbolsIntoOneVector();
+
+    void GenerateOutputFileSegments();
+    void MergeRPSegments();
+    void MergeRWPSegments();
+    void MergeRWSegments();
+
+    // Lays out a run of output segments that share pages, starting at
+    // Outs.front().Address. Every input starts on a multiple of its
+    // Alignment, zero-padded, and every output segment but the last is padded
+    // to 4 bytes. This gives the same addresses, lengths and data as
+    // appending the inputs one at a time with AppendSegmentToOutSegment, but
+    // places the inputs with ParallelAlignedScan and copies them in parallel.
+    void LayoutOutSegments(std::vector<OutSegment>& Outs, const std::vector<std::vector<const Segment*>>& Inputs);
+    void RecordMappings(std::vector<OutSegment>& Outs);
+
+    void InitializeSegmentForSamePage(OutSegment& Next, OutSegment& Previous);
+    void InitializeSegmentForNewPage(OutSegment& Next, OutSegment& Previous);
+
+    void AppendTextSegment(Segment S);
+    void AppendDataSegment(Segment S);
+    void AppendBSSSegment(Segment S);
+    void AppendSegmentToOutSegment(Segment S, OutSegment& O);
+
+    // Mergeable RP inputs, folded into one input per output segment and
+    // merge kind by MergeSegmentRun.
+    std::deque<MergedSegment> MergedSegments;
+
+    // Applies the relocations of every input to the laid-out output data.
+    // Relocations against symbols no input defines are left as they are and
+    // their names collected in UndefinedSymbols. RelocationsProcessed is
+    // set once it has run.
+    void ProcessRelocations();
+    bool RelocationsProcessed = false;
+    std::vector<std::string> UndefinedSymbols;
+    // Names defined by more than one input outside link-once groups. The
+    // first definition is used; a link with any is in error.
+    std::vector<std::string> DuplicateSymbols;
+
+    // Output addresses of the 4- and 8-byte slots that relocations filled
+    // with absolute addresses into the image, sorted. A loader that maps
+    // the image elsewhere moves them by as much as it moved the image; they
+    // are written packed into RelativeRelocationSegment.
+    std::vector<uint32_t> AbsoluteWords;
+    std::vector<uint32_t> AbsoluteDoublewords;
+    OutSegment RelativeRelocationSegment{"a.out", ".relr", 0x0, 0x0, "RP"};
+
+    // Functions imported from Libraries, in .got slot order, and the input
+    // that holds their .plt entries and .got slots.
+    //
+    // The .got starts with three reserved slots; the loader puts the image
+    // in the second and its lazy binding routine in the third. The slot of
+    // import i is 3 + i and first points back into its .plt entry, which
+    // pushes i and jumps to the shared entry .plt[0]; that entry pushes the
+    // image and jumps to the binding routine, which fills the slot in. Every
+    // reference to an imported function resolves to its .plt entry.
+    std::vector<std::string> Imports;
+    int ImportObjectIndex = -1;
+    static constexpr int PLTEntrySize = 16;
+    static constexpr int ReservedGOTSlots = 3;
+    OutSegment SymbolHashSegment{"a.out", ".gnu.hash", 0x0, 0x0, "RP"};
+
+    // Stamp the output with a build-id: a hash of the whole output file,
+    // kept in a GNU build-id note. GenerateObjectFile reserves the note as
+    // the last segment with a zero id, so the note's data is the last line
+    // of the output text. StampBuildId hashes that text and patches the id
+    // into it.
+    BuildIdKind BuildIdType = BuildIdKind::None;
+    OutSegment BuildIdSegment{"a.out", ".note.build-id", 0x0, 0x0, "RP"};
+    static constexpr int BuildIdNoteHeaderSize = 16;
+    // Returns the id written, or throws if Text does not end with the note.
+    std::string StampBuildId(std::string& Text) const;
+
+  private:
+    // Where an input segment landed: its output segment, its address and
+    // the offset of its data in the output's hex, and how many of its bytes
+    // have data. Mergeable inputs refer to their MergedSegment instead.
+    // Inputs dropped with their link-once group have no output segment.
+    class InputPlacement {
+    public:
+      OutSegment* Out = nullptr;
+      long Address = 0;
+      size_t HexOffset = 0;
+      long Size = 0;
+      int Merged = -1;
+      size_t MergedInput = 0;
+    };
+    std::vector<size_t> PlacementBegin;
+    std::vector<InputPlacement> Placements;
+    GlobalSymbolTable GlobalSymbols;
+
+    void PlaceInputSegments();
+    void DefineGlobalSymbols();
+    // The output address of Offset in segment SegmentNumber (1-based) of an
+    // object file.
+    bool InputAddress(size_t ObjectIndex, int SegmentNumber, long Offset, long& Address) const;
+    bool SymbolTarget(size_t ObjectIndex, size_t Row, long& Addend, long& Target) const;
+    // What relocating one object found, gathered once all objects are done.
+    class RelocationResults {
+    public:
+      LinkStats Counts;
+      std::vector<std::string> Undefined;
+      std::vector<uint32_t> AbsoluteWords;
+      std::vector<uint32_t> AbsoluteDoublewords;
+    };
+    void ApplyRelocations(size_t ObjectIndex, RelocationResults& Results);
+    void GenerateRelativeRelocationSegment();
+
+    std::unordered_map<std::string_view, size_t> ImportIndex;
+    // Finds the undefined functions that Libraries export and adds the
+    // input holding their .plt and .got.
+    void CollectImports();
+    SharedObjectFilePtr MakeImportObject() const;
+    // Sorts the exported rows of Symbols into hash order and appends the
+    // .gnu.hash segment to Ss.
+    void GenerateSymbolHashSegment(std::vector<Segment>& Ss, SymbolTable& Symbols);
+    void GenerateBuildIdSegment(std::vector<Segment>& Ss);
+    // The defined global symbols, relative to the output segments in Ss.
+    void GenerateOutputSymbols(const std::vector<Segment>& Ss, SymbolTable& Symbols) const;
+
+    // Merges the segments with the given Code into output segments, starting
+    // with First. Inputs named like First (followed by Extra, if any) go into
+    // it; every other name gets its own output segment, in name order.
+    void MergeSegmentRun(Permissions Code, OutSegment First, std::vector<OutSegment>& Out, const Segment* Extra);
+
+    // Scratch space for the merge and layout passes, kept between links.
+    std::vector<OutSegment> RunSegments;
+    std::vector<std::vector<const Segment*>> RunInputs;
+    std::vector<const Segment*> Pieces;
+    std::vector<size_t> OutBegin;
+    std::vector<size_t> PieceOut;
+    std::vector<long> Offsets;
+    std::vector<long> DataExcess;
+  };
+
+  // Records a phase of L's link into L.Memory, from construction to
+  // destruction, when L.Memory.Enabled is set.
+  class LinkPhase {
+  public:
+    LinkPhase(Linker& L, const char* Name);
+    ~LinkPhase();
+
+  private:
+    Linker& L;
+    const char* Name;
+    AllocationCounter::Snapshot Start;
+    std::chrono::steady_clock::time_point Began;
   };
 }
 
@@ -0,0 +1,116 @@
+#ifndef MemoryStats_h
+#define MemoryStats_h
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ldl {
+
+// Counts the allocations made through the global operator new, in programs
+// that link the AllocationHooks object, which replaces it; elsewhere the
+// counts stay zero. Counting is on while any Enable(true) is unmatched by an
+// Enable(false), and then costs a few relaxed atomic operations per
+// allocation. A free takes off only what a counted allocation added. The
+// counts are for the whole process: links running concurrently add to the
+// same counters.
+class AllocationCounter {
+public:
+  class Snapshot {
+  public:
+    // Allocations and bytes requested since counting was first enabled.
+    uint64_t Allocations = 0;
+    uint64_t Bytes = 0;
+    // Bytes allocated less bytes freed while counting, and the most that
+    // has been since the last ResetPeak.
+    int64_t Live = 0;
+    int64_t Peak = 0;
+  };
+
+  static void Enable(bool On);
+  static bool Enabled();
+  static Snapshot Now();
+  // Starts a new high-water mark from the bytes live now.
+  static void ResetPeak();
+  // Called by the hooks for a counted block.
+  static void Allocated(size_t Size);
+  static void Freed(size_t Size);
+};
+
+// Counts allocations from construction to destruction, when On.
+class AllocationCounting {
+public:
+  explicit AllocationCounting(bool On) :On{On} {
+    if (On)
+      AllocationCounter::Enable(true);
+  }
+  ~AllocationCounting() {
+    if (On)
+      AllocationCounter::Enable(false);
+  }
+  AllocationCounting(const AllocationCounting&) = delete;
+  AllocationCounting& operator=(const AllocationCounting&) = delete;
+
+private:
+  bool On;
+};
+
+// What one phase of a link did: its time, the allocations made in it, the
+// bytes live at its end and the most that were live during it.
+class PhaseStats {
+public:
+  std::string Name;
+  std::chrono::steady_clock::duration Time{};
+  uint64_t Allocations = 0;
+  uint64_t Bytes = 0;
+  int64_t LiveBytes = 0;
+  int64_t PeakBytes = 0;
+};
+
+// The bytes one of the Linker's structures holds, from the capacities of
+// its containers and the heap buffers of its strings, and the most it held
+// at the end of any phase.
+class StructureMemory {
+public:
+  std::string Name;
+  size_t Bytes = 0;
+  size_t HighWater = 0;
+};
+
+// Per-phase and per-structure memory of a link, for --stats and --trace.
+// Phases are recorded only when Enabled; with Trace set, each phase is
+// printed as it ends.
+class MemoryStats {
+public:
+  bool Enabled = false;
+  std::ostream* Trace = nullptr;
+  std::vector<PhaseStats> Phases;
+  std::vector<StructureMemory> Structures;
+
+  // Forgets the phases and structures of the previous link.
+  void Clear();
+  // Sets the size of a structure, raising its high-water mark.
+  void Record(const std::string& Name, size_t Bytes);
+  const StructureMemory* Structure(const std::string& Name) const;
+  const PhaseStats* Phase(const std::string& Name) const;
+};
+
+// Prints a phase as "name: time, allocations, bytes, live, peak".
+void PrintPhaseStats(const PhaseStats& P, std::ostream& OS);
+
+// Heap bytes held by a string beyond the string object itself.
+inline size_t StringHeapBytes(const std::string& S) {
+  static const size_t InlineCapacity = std::string{}.capacity();
+  return S.capacity() > InlineCapacity ? S.capacity() + 1 : 0;
+}
+
+template <typename T>
+size_t VectorBytes(const std::vector<T>& V) {
+  return V.capacity() * sizeof(T);
+}
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef ObjectCache_h
+#define ObjectCache_h
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <Linker/Linker.h>
+
+namespace ldl {
+
+// Keeps parsed object files in memory between links.
+//
+// An entry is reused while the file's modification time and size are
+// unchanged. When either changes the file is hashed, and an unchanged hash
+// still reuses the entry (a rebuild that produced the same bytes). Otherwise
+// the file is parsed again. Entries are keyed by canonical path, and the
+// files are read by it too, so their segments' FileName is the same for
+// every client rather than the relative path of the first.
+//
+// Cached files may take up to MaxBytes of file size; beyond that the least
+// recently used entries are dropped, as are entries whose file is gone.
+class ObjectCache {
+public:
+  class Entry {
+  public:
+    int64_t ModificationTime = 0;
+    int64_t Size = 0;
+    uint64_t Hash = 0;
+    SharedObjectFilePtr ObjectFile;
+    std::list<std::string>::iterator Use;
+  };
+
+  int64_t MaxBytes = int64_t{1} << 32;
+
+  // Lookups that reused an entry without hashing, that reused it after
+  // hashing, and that had to parse the file, and entries dropped.
+  size_t Hits = 0;
+  size_t HashHits = 0;
+  size_t Misses = 0;
+  size_t Evictions = 0;
+
+  SharedObjectFilePtr Get(const std::string& FileName);
+  // Drops the entries whose file no longer stats.
+  void Prune();
+  void Clear();
+  size_t Size();
+  int64_t Bytes();
+
+  static uint64_t HashFile(const std::string& FileName);
+
+private:
+  std::mutex Lock;
+  std::map<std::string, Entry> Entries;
+  // Keys, most recently used first.
+  std::list<std::string> Recent;
+  int64_t TotalBytes = 0;
+
+  // Called with Lock held.
+  void Store(const std::string& Key, Entry E);
+  void Erase(std::map<std::string, Entry>::iterator It);
+};
+}
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef Parallel_h
+#define Parallel_h
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace ldl {
+
+// Below this many items the work runs on the calling thread; thread start-up
+// costs more than the loop bodies the linker runs.
+constexpr size_t ParallelGrainSize = 4096;
+
+inline size_t ParallelThreadCount() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+inline size_t ParallelChunkCount(size_t N) {
+  return std::max<size_t>(1, std::min(ParallelThreadCount(), N / ParallelGrainSize));
+}
+
+// Calls Fn(Chunk, Begin, End) for NumberOfChunks contiguous slices of [0, N).
+template <typename Function>
+void ParallelForChunks(size_t N, size_t NumberOfChunks, Function Fn) {
+  if (NumberOfChunks <= 1) {
+    Fn(0, 0, N);
+    return;
+  }
+  std::vector<std::thread> Workers;
+  for (size_t Chunk = 1; Chunk < NumberOfChunks; Chunk++)
+    Workers.emplace_back([&, Chunk] {
+      Fn(Chunk, N * Chunk / NumberOfChunks, N * (Chunk + 1) / NumberOfChunks);
+    });
+  Fn(0, 0, N / NumberOfChunks);
+  for (auto& Worker : Workers)
+    Worker.join();
+}
+
+template <typename Function>
+void ParallelFor(size_t N, Function Fn) {
+  ParallelForChunks(N, ParallelChunkCount(N), [&](size_t, size_t Begin, size_t End) {
+    for (size_t i = Begin; i < End; i++)
+      Fn(i);
+  });
+}
+
+// Replaces Values with its exclusive prefix sum and appends the total, so
+// Values[i] is the sum of the first i inputs and Values.back() the sum of
+// all of them. Each chunk sums its slice, the chunk totals are scanned
+// serially, then each chunk rewrites its slice from its starting offset.
+template <typename T>
+void ParallelExclusiveScan(std::vector<T>& Values) {
+  size_t N = Values.size();
+  size_t NumberOfChunks = ParallelChunkCount(N);
+  std::vector<T> ChunkTotals(NumberOfChunks, T{});
+
+  ParallelForChunks(N, NumberOfChunks, [&](size_t Chunk, size_t Begin, size_t End) {
+    T Total{};
+    for (size_t i = Begin; i < End; i++)
+      Total += Values[i];
+    ChunkTotals[Chunk] = Total;
+  });
+
+  T Running{};
+  for (auto& Total : ChunkTotals) {
+    T ChunkTotal = Total;
+    Total = Running;
+    Running += ChunkTotal;
+  }
+
+  ParallelForChunks(N, NumberOfChunks, [&](size_t Chunk, size_t Begin, size_t End) {
+    T Sum = ChunkTotals[Chunk];
+    for (size_t i = Begin; i < End; i++) {
+      T Value = Values[i];
+      Values[i] = Sum;
+      Sum += Value;
+    }
+  });
+  Values.push_back(Running);
+}
+
+// Places N items one after another from Start, each on a multiple of
+// Alignment(i), a power of two, stores where each begins in Offsets and
+// returns where the last one ends. Each of NumberOfChunks slices is laid
+// out from 0, which is on every alignment, noting its end and its widest
+// alignment. The real slice starts are then found serially: a slice that
+// starts on its widest alignment moves as a whole, and one that does not is
+// walked again only up to its first item of that alignment, from where it
+// moves as a whole too. Last, each slice moves its items by its shift.
+template <typename AlignmentFunction, typename LengthFunction>
+long ParallelAlignedScan(size_t N, size_t NumberOfChunks, long Start, std::vector<long>& Offsets,
+                         AlignmentFunction Alignment, LengthFunction Length) {
+  auto Align = [](long Address, long A) { return (Address + A - 1) & ~(A - 1); };
+  Offsets.resize(N);
+  std::vector<size_t> ChunkBegins(NumberOfChunks);
+  std::vector<size_t> ChunkWidest(NumberOfChunks);
+  std::vector<long> ChunkAlignments(NumberOfChunks);
+  std::vector<long> ChunkEnds(NumberOfChunks);
+  std::vector<long> ChunkShifts(NumberOfChunks);
+
+  ParallelForChunks(N, NumberOfChunks, [&](size_t Chunk, size_t Begin, size_t End) {
+    long Address = 0;
+    long Widest = 1;
+    size_t First = End;
+    for (size_t i = Begin; i < End; i++) {
+      long A = Alignment(i);
+      if (First == End || A > Widest) {
+        Widest = std::max(Widest, A);
+        First = i;
+      }
+      Address = Align(Address, A);
+      Offsets[i] = Address;
+      Address += Length(i);
+    }
+    ChunkBegins[Chunk] = Begin;
+    ChunkWidest[Chunk] = First;
+    ChunkAlignments[Chunk] = Widest;
+    ChunkEnds[Chunk] = Address;
+  });
+
+  long Address = Start;
+  for (size_t Chunk = 0; Chunk < NumberOfChunks; Chunk++) {
+    size_t First = ChunkWidest[Chunk];
+    long Widest = ChunkAlignments[Chunk];
+    if (Align(Address, Widest) == Address) {
+      ChunkShifts[Chunk] = Address;
+    } else {
+      for (size_t i = ChunkBegins[Chunk]; i < First; i++) {
+        Address = Align(Address, Alignment(i));
+        Offsets[i] = Address;
+        Address += Length(i);
+      }
+      // The items before First are in place already.
+      ChunkBegins[Chunk] = First;
+      ChunkShifts[Chunk] = Align(Address, Widest) - Offsets[First];
+    }
+    Address = ChunkEnds[Chunk] + ChunkShifts[Chunk];
+  }
+
+  ParallelForChunks(N, NumberOfChunks, [&](size_t Chunk, size_t, size_t End) {
+    for (size_t i = ChunkBegins[Chunk]; i < End; i++)
+      Offsets[i] += ChunkShifts[Chunk];
+  });
+  return Address;
+}
+}
+
+#endif
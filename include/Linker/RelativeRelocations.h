@@ -0,0 +1,87 @@
+#ifndef RelativeRelocations_h
+#define RelativeRelocations_h
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace ldl {
+
+// The packed relative relocations of a linked image: the addresses of the
+// slots that hold absolute addresses into the image, which a loader adds
+// the image's displacement to when it maps the image away from its linked
+// address.
+//
+// The encoding is RELR with 32-bit entries. An even entry is a slot address
+// shifted left by one, so that unaligned slots can be named too. An odd
+// entry is a bitmap: bit k (1 <= k <= 31) marks the slot k - 1 slots past
+// the last one the previous entries covered. Slots that sit in runs, like
+// tables of pointers, take one bit each.
+//
+// The .relr segment holds the number of entries for 4-byte slots, those
+// entries, and then the entries for 8-byte slots, all little-endian words.
+class RelativeRelocations {
+public:
+  static constexpr int BitmapSlots = 31;
+
+  // Appends the entries for Addresses, which must be sorted, to Entries.
+  // An address that repeats gets an entry of its own each time.
+  static void Encode(const std::vector<uint32_t>& Addresses, uint32_t SlotSize, std::vector<uint32_t>& Entries) {
+    size_t i = 0;
+    size_t N = Addresses.size();
+    while (i < N) {
+      uint32_t Address = Addresses[i++];
+      Entries.push_back(Address << 1);
+      uint64_t Next = static_cast<uint64_t>(Address) + SlotSize;
+      while (i < N) {
+        uint32_t Bitmap = 0;
+        while (i < N && Addresses[i] >= Next && (Addresses[i] - Next) % SlotSize == 0) {
+          uint64_t Slot = (Addresses[i] - Next) / SlotSize;
+          if (Slot >= BitmapSlots)
+            break;
+          Bitmap |= 1u << (Slot + 1);
+          i++;
+        }
+        if (Bitmap == 0)
+          break;
+        Entries.push_back(Bitmap | 1);
+        Next += static_cast<uint64_t>(BitmapSlots) * SlotSize;
+      }
+    }
+  }
+
+  // Calls Apply with the address of every slot Entries name.
+  template <typename Function>
+  static void Decode(const uint32_t* Entries, size_t NumberOfEntries, uint32_t SlotSize, Function Apply) {
+    uint64_t Next = 0;
+    for (size_t i = 0; i < NumberOfEntries; i++) {
+      uint32_t Entry = Entries[i];
+      if ((Entry & 1) == 0) {
+        uint64_t Address = Entry >> 1;
+        Apply(Address);
+        Next = Address + SlotSize;
+        continue;
+      }
+      for (uint32_t Bits = Entry >> 1; Bits != 0; Bits &= Bits - 1)
+        Apply(Next + static_cast<uint64_t>(__builtin_ctz(Bits)) * SlotSize);
+      Next += static_cast<uint64_t>(BitmapSlots) * SlotSize;
+    }
+  }
+
+  // The raw bytes of a .relr segment for the given sorted slot addresses.
+  static std::string Pack(const std::vector<uint32_t>& Words, const std::vector<uint32_t>& Doublewords) {
+    std::vector<uint32_t> Entries{0};
+    Encode(Words, 4, Entries);
+    Entries[0] = static_cast<uint32_t>(Entries.size() - 1);
+    Encode(Doublewords, 8, Entries);
+    std::string Bytes(4 * Entries.size(), '\0');
+    for (size_t i = 0; i < Entries.size(); i++)
+      for (int b = 0; b < 4; b++)
+        Bytes[4 * i + b] = static_cast<char>(Entries[i] >> (8 * b));
+    return Bytes;
+  }
+};
+}
+
+#endif
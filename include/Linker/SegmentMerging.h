@@ -0,0 +1,55 @@
+#ifndef SegmentMerging_h
+#define SegmentMerging_h
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <ObjectReader/ObjectReader.h>
+
+namespace ldl {
+
+class MergePiece {
+public:
+  int InputOffset;
+  int Length;
+  int OutputOffset;
+};
+
+// The mergeable inputs of one output segment that share a merge kind (the
+// same MergeStrings and MergeEntrySize), folded into a single input.
+//
+// Every input is split into pieces: NUL-terminated strings, or constants of
+// MergeEntrySize bytes. Pieces are hashed in parallel and deduplicated in a
+// hash table sharded by hash, one shard per task, keeping the first copy in
+// input order, so the result does not depend on the number of threads. The
+// unique pieces are then laid out in order of first appearance. With
+// TailMerge, a string that is a suffix of another is not laid out at all
+// but points into the end of the longer one.
+class MergedSegment {
+public:
+  // The merged data as one input segment for the layout.
+  Segment Merged;
+  std::vector<const Segment*> Inputs;
+  // Pieces of Inputs[i] are Pieces[PieceBegin[i], PieceBegin[i + 1]), in
+  // input offset order.
+  std::vector<size_t> PieceBegin;
+  std::vector<MergePiece> Pieces;
+  size_t UniquePieces = 0;
+  size_t InputBytes = 0;
+
+  // Where the merged input ended up: its output segment (an index into the
+  // Linker's RPSegments), its place among that segment's contained
+  // segments, and its address once laid out.
+  size_t OutIndex = 0;
+  size_t Position = 0;
+  int Address = 0;
+
+  void Merge(const std::string& Name, const std::vector<const Segment*>& Inputs, bool TailMerge);
+
+  // Offset in Merged of the byte at Offset in Inputs[Input], or -1.
+  int OutputOffset(size_t Input, int Offset) const;
+};
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef SegmentOrdering_h
+#define SegmentOrdering_h
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ObjectReader/ObjectReader.h>
+
+namespace ldl {
+
+class CallGraphEdge {
+public:
+  std::string Caller;
+  std::string Callee;
+  long Weight;
+};
+
+// Reorders the .text inputs so that hot code shares pages.
+//
+// With a symbol ordering file, the segments defining the listed symbols come
+// first, in the order the symbols are listed. With a call graph profile the
+// segments are clustered with C3 (Ottoni and Maher, "Optimizing Function
+// Placement for Large-Scale Data-Center Applications"): walking from the
+// hottest segment down, each segment's cluster is appended to the cluster of
+// its heaviest caller while the result stays within a page, and clusters are
+// then placed by decreasing density. Given both, the ordering file is
+// explicit and wins: its segments come first, and the clusters of the rest
+// follow. Either way the segments that are never mentioned keep their
+// command-line order after the hot ones.
+class SegmentOrdering {
+public:
+  std::vector<std::string> SymbolOrder;
+  std::vector<CallGraphEdge> CallGraph;
+  long ClusterSizeLimit = 0x1000;
+
+  bool Empty() const { return SymbolOrder.empty() && CallGraph.empty(); }
+  void Clear();
+
+  // One symbol name per line; blank lines and lines starting with '#' are
+  // ignored.
+  bool ReadSymbolOrderingFile(const std::string& FileName);
+  // "caller callee weight" per line, as sampled from profiles.
+  bool ReadCallGraphProfile(const std::string& FileName);
+
+  // Reorders Segments, copies of .text inputs whose ObjectIndex and
+  // SegmentIndex refer to ObjectFiles. The reordering is stable.
+  void Order(std::vector<const Segment*>& Segments, const std::vector<std::shared_ptr<const ObjectFile>>& ObjectFiles) const;
+
+private:
+  void OrderBySymbols(std::vector<const Segment*>& Segments, std::vector<long>& Rank, const std::vector<std::vector<std::string>>& Defined) const;
+  void OrderByCallGraph(std::vector<const Segment*>& Segments, std::vector<long>& Rank, const std::vector<std::vector<std::string>>& Defined) const;
+};
+}
+
+#endif
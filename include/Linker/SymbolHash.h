@@ -0,0 +1,141 @@
+#ifndef SymbolHash_h
+#define SymbolHash_h
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ldl {
+
+// The dynamic symbol table of a shared library, kept in its .gnu.hash
+// segment in the layout of GNU's DT_GNU_HASH.
+//
+// The segment is a run of little-endian words: the number of buckets, the
+// symbol table row of the first hashed symbol, the number of 64-bit bloom
+// filter words and the bloom shift; then the bloom words, low half first;
+// then the buckets and one chain word per hashed symbol. The hashed symbols
+// are the last rows of the symbol table, sorted by bucket. A bucket holds
+// the chain index of its first symbol, or EmptyBucket. A chain word is the
+// symbol's hash with the low bit set on the last symbol of its bucket.
+//
+// Every symbol sets two bits of one bloom word, so a lookup of a name the
+// library does not define usually reads a single word and stops, which is
+// what makes searching many libraries in turn cheap.
+class SymbolHashTable {
+public:
+  static constexpr uint32_t EmptyBucket = UINT32_MAX;
+  static constexpr uint32_t BloomShift = 26;
+
+  uint32_t NumberOfBuckets = 0;
+  uint32_t SymbolOffset = 0;
+  uint32_t BloomSize = 0;
+  uint32_t Shift = 0;
+  const unsigned char* Bloom = nullptr;
+  const uint32_t* Buckets = nullptr;
+  const uint32_t* Chains = nullptr;
+  uint32_t NumberOfSymbols = 0;
+
+  // The GNU hash: h = h * 33 + c, starting from 5381.
+  static uint32_t Hash(std::string_view Name) {
+    uint32_t H = 5381;
+    for (unsigned char C : Name)
+      H = H * 33 + C;
+    return H;
+  }
+
+  static uint32_t BucketCount(size_t NumberOfSymbols) {
+    return static_cast<uint32_t>(std::max<size_t>(1, NumberOfSymbols / 2));
+  }
+
+  // The order in which symbols with the given hashes go into the table.
+  static std::vector<size_t> Order(const std::vector<uint32_t>& Hashes, uint32_t NumberOfBuckets) {
+    std::vector<size_t> Permutation(Hashes.size());
+    std::iota(Permutation.begin(), Permutation.end(), 0);
+    std::stable_sort(Permutation.begin(), Permutation.end(), [&](size_t A, size_t B) {
+      return Hashes[A] % NumberOfBuckets < Hashes[B] % NumberOfBuckets;
+    });
+    return Permutation;
+  }
+
+  // The segment bytes for symbols whose hashes are already in Order and
+  // whose first row is SymbolOffset.
+  static std::string Build(const std::vector<uint32_t>& Hashes, uint32_t SymbolOffset, uint32_t NumberOfBuckets) {
+    uint32_t BloomWords = 1;
+    while (BloomWords < Hashes.size() / 4)
+      BloomWords *= 2;
+
+    std::vector<uint64_t> BloomFilter(BloomWords, 0);
+    std::vector<uint32_t> Buckets(NumberOfBuckets, EmptyBucket);
+    std::vector<uint32_t> Chains(Hashes.size());
+    for (size_t i = 0; i < Hashes.size(); i++) {
+      uint32_t H = Hashes[i];
+      BloomFilter[(H / 64) % BloomWords] |= uint64_t{1} << (H % 64) | uint64_t{1} << ((H >> BloomShift) % 64);
+      uint32_t Bucket = H % NumberOfBuckets;
+      if (Buckets[Bucket] == EmptyBucket)
+        Buckets[Bucket] = static_cast<uint32_t>(i);
+      bool Last = i + 1 == Hashes.size() || Hashes[i + 1] % NumberOfBuckets != Bucket;
+      Chains[i] = Last ? H | 1 : H & ~1u;
+    }
+
+    std::vector<uint32_t> Words{NumberOfBuckets, SymbolOffset, BloomWords, BloomShift};
+    for (auto Word : BloomFilter) {
+      Words.push_back(static_cast<uint32_t>(Word));
+      Words.push_back(static_cast<uint32_t>(Word >> 32));
+    }
+    Words.insert(Words.end(), Buckets.begin(), Buckets.end());
+    Words.insert(Words.end(), Chains.begin(), Chains.end());
+
+    std::string Bytes(4 * Words.size(), '\0');
+    for (size_t i = 0; i < Words.size(); i++)
+      for (int b = 0; b < 4; b++)
+        Bytes[4 * i + b] = static_cast<char>(Words[i] >> (8 * b));
+    return Bytes;
+  }
+
+  // Reads the table in place from a segment's bytes, which must stay
+  // mapped and be 4-byte aligned.
+  bool Read(const unsigned char* Bytes, size_t Size) {
+    if (Size < 16)
+      return false;
+    auto Words = reinterpret_cast<const uint32_t*>(Bytes);
+    NumberOfBuckets = Words[0];
+    SymbolOffset = Words[1];
+    BloomSize = Words[2];
+    Shift = Words[3];
+    size_t Header = 4 + 2 * static_cast<size_t>(BloomSize) + NumberOfBuckets;
+    if (NumberOfBuckets == 0 || BloomSize == 0 || (BloomSize & (BloomSize - 1)) != 0 || 4 * Header > Size)
+      return false;
+    Bloom = Bytes + 16;
+    Buckets = Words + 4 + 2 * static_cast<size_t>(BloomSize);
+    Chains = Buckets + NumberOfBuckets;
+    NumberOfSymbols = static_cast<uint32_t>(Size / 4 - Header);
+    return true;
+  }
+
+  // Calls Matches with the row of every symbol whose hash is Hash, until it
+  // returns true.
+  template <typename Function>
+  bool Find(uint32_t Hash, Function Matches) const {
+    if (Buckets == nullptr)
+      return false;
+    uint64_t Word;
+    std::memcpy(&Word, Bloom + 8 * ((Hash / 64) & (BloomSize - 1)), 8);
+    if (((Word >> (Hash % 64)) & (Word >> ((Hash >> Shift) % 64)) & 1) == 0)
+      return false;
+    for (uint32_t i = Buckets[Hash % NumberOfBuckets]; i < NumberOfSymbols; i++) {
+      uint32_t Chain = Chains[i];
+      if ((Chain | 1) == (Hash | 1) && Matches(SymbolOffset + i))
+        return true;
+      if (Chain & 1)
+        break;
+    }
+    return false;
+  }
+};
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef Loader_h
+#define Loader_h
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <ObjectReader/ObjectReader.h>
+#include <Linker/SymbolHash.h>
+
+namespace ldl {
+
+class Loader;
+
+// A linked POF image mapped into this process.
+class LoadedImage {
+public:
+  std::string FileName;
+  // The first page the image was linked at and the address that page was
+  // mapped at. The mapping covers Size bytes of whole pages.
+  long LinkedBase = 0;
+  unsigned char* Base = nullptr;
+  size_t Size = 0;
+  // Segment headers at their linked addresses, and the image's symbols.
+  std::vector<Segment> Segments;
+  SymbolTable Symbols;
+
+  // Slots the .relr segment named, and how long applying them took.
+  size_t RelativeRelocations = 0;
+  std::chrono::nanoseconds RelocationTime{0};
+
+  // The exported symbols of a shared library, read in place.
+  SymbolHashTable Exports;
+  // The functions the image imports and their .got slots. The loader that
+  // loaded the image binds them, so it must outlive the image.
+  class Import {
+  public:
+    std::string_view Name;
+    uint64_t* Slot;
+  };
+  std::vector<Import> Imports;
+  const Loader* Owner = nullptr;
+
+  LoadedImage() { }
+  ~LoadedImage();
+  LoadedImage(const LoadedImage&) = delete;
+  LoadedImage& operator=(const LoadedImage&) = delete;
+
+  // How far the image moved from its linked address.
+  long Delta() const { return reinterpret_cast<long>(Base) - LinkedBase; }
+  bool Rebased() const { return Delta() != 0; }
+
+  // Where a linked address ended up in this process.
+  void* Address(long LinkedAddress) const { return Base + (LinkedAddress - LinkedBase); }
+  bool SymbolAddress(const std::string& Name, void*& Address) const;
+  // The symbol Name, or the start of the first RP segment if the image
+  // does not define it.
+  void* Entry(const std::string& Name = "_start") const;
+
+  // Finds an exported symbol through the .gnu.hash table.
+  bool Lookup(std::string_view Name, uint32_t Hash, void*& Address) const;
+  // Resolves import Index and fills in its .got slot.
+  bool Bind(size_t Index);
+};
+
+// Maps images written by Linker::GenerateObjectFile.
+//
+// The whole image range is reserved with one anonymous mapping, at its
+// linked address when that is free, or anywhere in the low 2GB when Rebase
+// is set or the linked address is taken. Segment data is decoded from the
+// mapped file straight into place, compressed segments decompressed
+// there; RW segments stay zero-filled. When the image moved, the packed
+// slots of its .relr segment are adjusted by the distance it moved. Then
+// the imports are bound, or set up to be bound on their first call with
+// LazyBinding. Last, RP segments are made read-execute (the .relr and
+// .gnu.hash tables and the build-id note read-only) and RWP and RW
+// segments read-write.
+//
+// Imports are looked up in the libraries loaded with LoadLibrary, in load
+// order. Every library is asked for each name it does not define, so the
+// lookup checks each library's bloom filter before its hash chains.
+class Loader {
+public:
+  static constexpr long PageSize = 0x1000;
+
+  bool Rebase = false;
+  bool LazyBinding = true;
+  std::vector<std::unique_ptr<LoadedImage>> Libraries;
+
+  // Throws a message if the file is not a linked image or cannot be mapped.
+  std::unique_ptr<LoadedImage> Load(const std::string& FileName);
+  // Loads a shared library anywhere and makes its exports visible to the
+  // images loaded after it.
+  LoadedImage& LoadLibrary(const std::string& FileName);
+
+  // The address of the first definition of Name in Libraries.
+  bool Resolve(std::string_view Name, void*& Address) const;
+
+  // Adds Delta to every slot the .relr segment of Image names, returning
+  // the number of slots. The segments holding them must be writable.
+  static size_t ApplyRelativeRelocations(LoadedImage& Image, long Delta);
+
+private:
+  // Line-by-line reading of the POF text.
+  class TextCursor {
+  public:
+    std::string_view Text;
+    size_t Offset = 0;
+    bool NextLine(std::string_view& Line);
+  };
+
+  std::unique_ptr<LoadedImage> LoadImage(const std::string& FileName, bool Move);
+  void ReadHeaders(TextCursor& Cursor, LoadedImage& Image, FileHeader& FH);
+  void MapImage(LoadedImage& Image, bool Move);
+  void ReadSegmentData(TextCursor& Cursor, LoadedImage& Image);
+  void ReadDynamicTables(LoadedImage& Image);
+  void BindImports(LoadedImage& Image);
+  void ProtectSegments(LoadedImage& Image);
+};
+}
+
+#endif
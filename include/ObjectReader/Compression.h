@@ -0,0 +1,33 @@
+#ifndef Compression_h
+#define Compression_h
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace ldl {
+
+// An LZ77 block codec in the style of LZ4, for segment payloads.
+//
+// A block is a run of sequences. Each starts with a token byte whose high
+// nibble is the number of literals and whose low nibble is the match length
+// less LZMinimumMatch; a nibble of 15 continues in the bytes that follow,
+// each adding its value until one is below 255. The literals come next, then
+// the match as a two-byte little-endian distance back into the output. The
+// last sequence has literals only and ends the block. Matches may overlap
+// the bytes they produce, so runs compress to a single sequence.
+constexpr size_t LZMinimumMatch = 4;
+
+std::string LZCompress(std::string_view Bytes);
+
+// Whether Block is well formed and decompresses to exactly Size bytes, found
+// by walking its sequences without producing them. Decompressing a block
+// that passes cannot fail.
+bool LZValidate(std::string_view Block, size_t Size);
+
+// Decompresses Block into Out, which holds Size bytes. Returns false, with
+// Out partly written, if the block is not well formed or not Size bytes.
+bool LZDecompress(std::string_view Block, char* Out, size_t Size);
+}
+
+#endif
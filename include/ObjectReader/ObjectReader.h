@@ -1,12 +1,24 @@
 #ifndef ObjectReader_h
 #define ObjectReader_h
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstdint>
 #include <fstream>
+#include <functional>
+#include <limits>
+#include <iterator>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
+#include <memory>
 #include <exception>
 
+#include <ObjectReader/Compression.h>
+
 namespace ldl {
 
 class ObjectReader;
@@ -34,6 +46,285 @@ public:
   int SegmentNumber;
   int Ref;
   std::string Type;
+  // Explicit addend from RELA inputs and partial links. POF inputs usually
+  // keep addends in the segment data; a POF relocation line ends with its
+  // addend when it is not zero.
+  int Addend = 0;
+};
+
+// Symbol, relocation and segment codes, decoded once when an object is read.
+// Spellings the linker does not know map to Unknown; the tables keep the
+// original text so that they still print back as read.
+// Section symbols are local symbols that name their own segment, as ELF
+// uses them; they are written as "L". Import symbols ("I") only appear in
+// linked images: they name a symbol of a shared library and the GOT slot,
+// at Value in their segment, that the loader binds to it. Weak definitions
+// ("W") give way to a strong definition of the same name, and weak
+// references ("w") that nothing defines resolve to 0. AS4S is AS4 for a
+// word the processor sign-extends, as ELF's R_X86_64_32S.
+enum class SymbolType : unsigned char { Defined, Undefined, Local, Section, Import, Weak, WeakUndefined, Unknown };
+enum class RelocationType : unsigned char { A4, R4, AS4, AS4S, RS4, AS8, Unknown };
+enum class SegmentPermissions : unsigned char { RP, RWP, RW, Unknown };
+
+inline SymbolType ParseSymbolType(std::string_view Type) {
+  if (Type == "D") return SymbolType::Defined;
+  if (Type == "U") return SymbolType::Undefined;
+  if (Type == "L") return SymbolType::Local;
+  if (Type == "I") return SymbolType::Import;
+  if (Type == "W") return SymbolType::Weak;
+  if (Type == "w") return SymbolType::WeakUndefined;
+  return SymbolType::Unknown;
+}
+
+inline const char* SymbolTypeName(SymbolType Type) {
+  switch (Type) {
+  case SymbolType::Defined: return "D";
+  case SymbolType::Undefined: return "U";
+  case SymbolType::Local: return "L";
+  case SymbolType::Section: return "L";
+  case SymbolType::Import: return "I";
+  case SymbolType::Weak: return "W";
+  case SymbolType::WeakUndefined: return "w";
+  default: return "";
+  }
+}
+
+// Strong and weak definitions of a name for the whole link.
+inline bool IsGlobalDefinition(SymbolType Type) {
+  return Type == SymbolType::Defined || Type == SymbolType::Weak;
+}
+
+inline RelocationType ParseRelocationType(std::string_view Type) {
+  if (Type == "A4") return RelocationType::A4;
+  if (Type == "R4") return RelocationType::R4;
+  if (Type == "AS4") return RelocationType::AS4;
+  if (Type == "AS4S") return RelocationType::AS4S;
+  if (Type == "RS4") return RelocationType::RS4;
+  if (Type == "AS8") return RelocationType::AS8;
+  return RelocationType::Unknown;
+}
+
+inline const char* RelocationTypeName(RelocationType Type) {
+  switch (Type) {
+  case RelocationType::A4: return "A4";
+  case RelocationType::R4: return "R4";
+  case RelocationType::AS4: return "AS4";
+  case RelocationType::AS4S: return "AS4S";
+  case RelocationType::RS4: return "RS4";
+  case RelocationType::AS8: return "AS8";
+  default: return "";
+  }
+}
+
+inline SegmentPermissions ParseSegmentPermissions(std::string_view Code) {
+  if (Code == "RP") return SegmentPermissions::RP;
+  if (Code == "RWP") return SegmentPermissions::RWP;
+  if (Code == "RW") return SegmentPermissions::RW;
+  return SegmentPermissions::Unknown;
+}
+
+inline const char* SegmentPermissionsName(SegmentPermissions Permissions) {
+  switch (Permissions) {
+  case SegmentPermissions::RP: return "RP";
+  case SegmentPermissions::RWP: return "RWP";
+  case SegmentPermissions::RW: return "RW";
+  default: return "";
+  }
+}
+
+// Iterates a column table by index, yielding each row as a record.
+template <typename Table, typename Record>
+class TableIterator {
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = Record;
+  using difference_type = std::ptrdiff_t;
+  using pointer = void;
+  using reference = Record;
+
+  const Table* T;
+  size_t Index;
+
+  Record operator*() const { return (*T)[Index]; }
+  TableIterator& operator++() { Index++; return *this; }
+  TableIterator operator++(int) { TableIterator Old = *this; Index++; return Old; }
+  bool operator==(const TableIterator& Other) const { return Index == Other.Index; }
+  bool operator!=(const TableIterator& Other) const { return Index != Other.Index; }
+};
+
+// Spellings of the Unknown types in a table, by row, in row order.
+using UnknownTypeSpellings = std::vector<std::pair<uint32_t, std::string>>;
+
+inline std::string_view UnknownTypeSpelling(const UnknownTypeSpellings& Spellings, size_t Row) {
+  auto It = std::lower_bound(Spellings.begin(), Spellings.end(), Row,
+    [](const std::pair<uint32_t, std::string>& P, size_t R) { return P.first < R; });
+  if (It == Spellings.end() || It->first != Row)
+    return {};
+  return It->second;
+}
+
+inline void AppendUnknownTypeSpellings(UnknownTypeSpellings& To, const UnknownTypeSpellings& From, size_t FirstRow) {
+  for (auto& P : From)
+    To.emplace_back(static_cast<uint32_t>(FirstRow + P.first), P.second);
+}
+
+// The symbols of an object file as parallel columns. Names are packed into
+// one pool, so a table is a handful of allocations however many symbols it
+// holds, and passes that filter on type or value read only those columns.
+// Indexing and iterating yield Symbol records for code that wants them.
+class SymbolTable {
+public:
+  std::string NamePool;
+  std::vector<uint32_t> NameOffsets;
+  std::vector<uint32_t> NameLengths;
+  std::vector<int> Values;
+  std::vector<int> SegmentNumbers;
+  std::vector<SymbolType> Types;
+  UnknownTypeSpellings UnknownTypes;
+
+  using iterator = TableIterator<SymbolTable, Symbol>;
+  using const_iterator = iterator;
+
+  size_t size() const { return Types.size(); }
+  bool empty() const { return Types.empty(); }
+  size_t capacity() const { return Types.capacity(); }
+
+  void reserve(size_t N) {
+    NameOffsets.reserve(N);
+    NameLengths.reserve(N);
+    Values.reserve(N);
+    SegmentNumbers.reserve(N);
+    Types.reserve(N);
+  }
+
+  void clear() {
+    NamePool.clear();
+    NameOffsets.clear();
+    NameLengths.clear();
+    Values.clear();
+    SegmentNumbers.clear();
+    Types.clear();
+    UnknownTypes.clear();
+  }
+
+  void Add(std::string_view Name, int Value, int SegmentNumber, SymbolType Type) {
+    NameOffsets.push_back(static_cast<uint32_t>(NamePool.size()));
+    NameLengths.push_back(static_cast<uint32_t>(Name.size()));
+    NamePool.append(Name);
+    Values.push_back(Value);
+    SegmentNumbers.push_back(SegmentNumber);
+    Types.push_back(Type);
+  }
+
+  void push_back(const Symbol& S) {
+    SymbolType Type = ParseSymbolType(S.Type);
+    if (Type == SymbolType::Unknown)
+      UnknownTypes.emplace_back(static_cast<uint32_t>(size()), S.Type);
+    Add(S.Name, S.Value, S.SegmentNumber, Type);
+  }
+
+  void Append(const SymbolTable& Other) {
+    size_t FirstRow = size();
+    uint32_t PoolBase = static_cast<uint32_t>(NamePool.size());
+    NamePool.append(Other.NamePool);
+    for (auto Offset : Other.NameOffsets)
+      NameOffsets.push_back(PoolBase + Offset);
+    NameLengths.insert(NameLengths.end(), Other.NameLengths.begin(), Other.NameLengths.end());
+    Values.insert(Values.end(), Other.Values.begin(), Other.Values.end());
+    SegmentNumbers.insert(SegmentNumbers.end(), Other.SegmentNumbers.begin(), Other.SegmentNumbers.end());
+    Types.insert(Types.end(), Other.Types.begin(), Other.Types.end());
+    AppendUnknownTypeSpellings(UnknownTypes, Other.UnknownTypes, FirstRow);
+  }
+
+  std::string_view Name(size_t i) const {
+    return std::string_view{NamePool}.substr(NameOffsets[i], NameLengths[i]);
+  }
+
+  std::string_view TypeName(size_t i) const {
+    if (Types[i] == SymbolType::Unknown)
+      return UnknownTypeSpelling(UnknownTypes, i);
+    return SymbolTypeName(Types[i]);
+  }
+
+  Symbol operator[](size_t i) const {
+    return Symbol{std::string{Name(i)}, Values[i], SegmentNumbers[i], std::string{TypeName(i)}};
+  }
+
+  iterator begin() const { return iterator{this, 0}; }
+  iterator end() const { return iterator{this, size()}; }
+};
+
+// The relocations of an object file as parallel columns, like SymbolTable.
+class RelocationTable {
+public:
+  std::vector<int> Locations;
+  std::vector<int> SegmentNumbers;
+  std::vector<int> Refs;
+  std::vector<int> Addends;
+  std::vector<RelocationType> Types;
+  UnknownTypeSpellings UnknownTypes;
+
+  using iterator = TableIterator<RelocationTable, Relocation>;
+  using const_iterator = iterator;
+
+  size_t size() const { return Types.size(); }
+  bool empty() const { return Types.empty(); }
+  size_t capacity() const { return Types.capacity(); }
+
+  void reserve(size_t N) {
+    Locations.reserve(N);
+    SegmentNumbers.reserve(N);
+    Refs.reserve(N);
+    Addends.reserve(N);
+    Types.reserve(N);
+  }
+
+  void clear() {
+    Locations.clear();
+    SegmentNumbers.clear();
+    Refs.clear();
+    Addends.clear();
+    Types.clear();
+    UnknownTypes.clear();
+  }
+
+  void Add(int Location, int SegmentNumber, int Ref, RelocationType Type, int Addend) {
+    Locations.push_back(Location);
+    SegmentNumbers.push_back(SegmentNumber);
+    Refs.push_back(Ref);
+    Addends.push_back(Addend);
+    Types.push_back(Type);
+  }
+
+  void push_back(const Relocation& R) {
+    RelocationType Type = ParseRelocationType(R.Type);
+    if (Type == RelocationType::Unknown)
+      UnknownTypes.emplace_back(static_cast<uint32_t>(size()), R.Type);
+    Add(R.Location, R.SegmentNumber, R.Ref, Type, R.Addend);
+  }
+
+  void Append(const RelocationTable& Other) {
+    size_t FirstRow = size();
+    Locations.insert(Locations.end(), Other.Locations.begin(), Other.Locations.end());
+    SegmentNumbers.insert(SegmentNumbers.end(), Other.SegmentNumbers.begin(), Other.SegmentNumbers.end());
+    Refs.insert(Refs.end(), Other.Refs.begin(), Other.Refs.end());
+    Addends.insert(Addends.end(), Other.Addends.begin(), Other.Addends.end());
+    Types.insert(Types.end(), Other.Types.begin(), Other.Types.end());
+    AppendUnknownTypeSpellings(UnknownTypes, Other.UnknownTypes, FirstRow);
+  }
+
+  std::string_view TypeName(size_t i) const {
+    if (Types[i] == RelocationType::Unknown)
+      return UnknownTypeSpelling(UnknownTypes, i);
+    return RelocationTypeName(Types[i]);
+  }
+
+  Relocation operator[](size_t i) const {
+    return Relocation{Locations[i], SegmentNumbers[i], Refs[i], std::string{TypeName(i)}, Addends[i]};
+  }
+
+  iterator begin() const { return iterator{this, 0}; }
+  iterator end() const { return iterator{this, size()}; }
 };
 
 class Segment {
@@ -43,18 +334,63 @@ public:
   int Address;
   int Length;
   std::string Code;
+  // Code, decoded.
+  SegmentPermissions Permissions = SegmentPermissions::Unknown;
+  // Signature of the link-once group the segment belongs to, or empty. A
+  // link keeps the members of each group from the first object defining it.
+  std::string Group;
+  // Set when a reader skipped the segment's payload because its group was
+  // already defined by an earlier object.
+  bool Discarded = false;
+  // Mergeable read-only data: NUL-terminated strings, or constants of
+  // MergeEntrySize bytes each. Identical pieces are kept once in the output.
+  bool MergeStrings = false;
+  int MergeEntrySize = 0;
+
+  bool Mergeable() const { return MergeStrings || MergeEntrySize > 0; }
+
+  // A power of two the segment's address is a multiple of once linked.
+  int Alignment = 4;
 
   std::string Data;
 
+  // Bytes of a segment read from a binary input. Points into the input's
+  // mapping, which Owner keeps alive; empty for POF inputs.
+  std::string_view RawData;
+  std::shared_ptr<const void> Owner;
+
+  // Set on segments whose data is an LZ block (see Compression.h) of
+  // CompressedSize bytes in CompressedData, with Data and RawData empty. The
+  // block holds all Length bytes of the segment, so layout goes by the
+  // header alone and the bytes are only produced where they are copied to.
+  int CompressedSize = 0;
+  std::string CompressedData;
+  bool Compressed() const { return CompressedSize > 0; }
+
+  // Where a Linker's copy of the segment came from: the index of its object
+  // file in the link and its index within that file. -1 elsewhere.
+  int ObjectIndex = -1;
+  int SegmentIndex = -1;
+
   Segment(std::string FileName, std::string Name, int Address, int Length, std::string Code)
     :FileName{FileName},
     Name{Name},
     Address{Address},
     Length{Length},
-    Code{Code} { }
+    Code{Code},
+    Permissions{ParseSegmentPermissions(Code)} { }
   Segment() {}
+
+  void SetCode(std::string NewCode) {
+    Code = std::move(NewCode);
+    Permissions = ParseSegmentPermissions(Code);
+  }
 };
 
+inline long AlignAddress(long Address, int Alignment) {
+  return (Address + Alignment - 1) & ~static_cast<long>(Alignment - 1);
+}
+
 class OutSegment : public Segment {
 public:
   std::vector<Segment> InputSegments;
@@ -63,29 +399,83 @@ public:
     :Segment{FileName, Name, Address, Length, Code} { }
 };
 
+inline void WriteHexBytes(char* Out, std::string_view Bytes) {
+  static const char Digits[] = "0123456789abcdef";
+  for (size_t i = 0; i < Bytes.size(); i++) {
+    unsigned char B = static_cast<unsigned char>(Bytes[i]);
+    Out[2 * i] = Digits[B >> 4];
+    Out[2 * i + 1] = Digits[B & 0xf];
+  }
+}
+
+// Digits are looked up rather than compared; decoding hex is most of the
+// work of reading segment data.
+class HexDigitTable {
+public:
+  unsigned char Values[256] = {};
+  constexpr HexDigitTable() {
+    for (int C = '0'; C <= '9'; C++) Values[C] = static_cast<unsigned char>(C - '0');
+    for (int C = 'a'; C <= 'f'; C++) Values[C] = static_cast<unsigned char>(C - 'a' + 10);
+    for (int C = 'A'; C <= 'F'; C++) Values[C] = static_cast<unsigned char>(C - 'A' + 10);
+  }
+};
+inline constexpr HexDigitTable HexDigits{};
+
+inline int HexDigitValue(char C) {
+  return HexDigits.Values[static_cast<unsigned char>(C)];
+}
+
+// Decodes Hex, two digits per byte, into Out.
+inline void ReadHexBytes(char* Out, std::string_view Hex) {
+  for (size_t i = 0; i + 1 < Hex.size(); i += 2)
+    Out[i / 2] = static_cast<char>(HexDigitValue(Hex[i]) << 4 | HexDigitValue(Hex[i + 1]));
+}
+
+inline void AppendHexBytes(std::string& Out, std::string_view Bytes) {
+  size_t Start = Out.size();
+  Out.resize(Start + Bytes.size() * 2);
+  WriteHexBytes(&Out[Start], Bytes);
+}
+
+// Size of the segment's data in POF hex text, whichever way it is held.
+inline size_t HexDataSize(const Segment& S) {
+  if (S.Compressed())
+    return 2 * static_cast<size_t>(S.Length);
+  return S.Data.empty() ? S.RawData.size() * 2 : S.Data.size();
+}
+
+// Decompresses a compressed segment straight into HexDataSize(S) bytes of
+// hex at Out. The block must be valid, as ObjectReader checks it is and
+// CompressSegment makes it.
+void WriteHexDecompressed(char* Out, const Segment& S);
+
+inline void WriteHexData(char* Out, const Segment& S) {
+  if (S.Compressed())
+    WriteHexDecompressed(Out, S);
+  else if (S.Data.empty())
+    WriteHexBytes(Out, S.RawData);
+  else
+    S.Data.copy(Out, S.Data.size());
+}
+
+// Replaces the data of S with an LZ block of it, when the data covers the
+// whole segment and the block is smaller. Returns whether it did.
+bool CompressSegment(Segment& S);
+
+// Asked by a reader, once it has seen a segment's header, whether to load
+// the members of the link-once group with the given signature.
+using GroupFilter = std::function<bool(const std::string& Signature)>;
+
 class ObjectFile {
 public:
   std::string FileName;
   FileHeader FH;
-  std::vector<Symbol> Symbols;
-  std::vector<Relocation> Relocations;
+  SymbolTable Symbols;
+  RelocationTable Relocations;
   std::vector<Segment> Segments;
 
-  std::string GenerateTextRepresentation() {
-    std::ostringstream OSS;
-    OSS << FH.Magic << std::endl;
-    OSS << FH.NumberOfSegments << " " << FH.NumberOfSymbols << " " << FH.NumberOfRelocations << std::endl;
-    for (auto S : Segments)
-      OSS << S.Name << " " << std::hex << S.Address << std::hex << " " << S.Length << " " << S.Code << std::endl;
-    for (auto S : Symbols)
-      OSS << S.Name << " " << S.Value << " " << S.SegmentNumber << " " << S.Type << std::endl;
-    for (auto R : Relocations)
-      OSS << R.Location << " " << R.SegmentNumber << " " << R.Ref << " " << R.Type << std::endl;
-    for (auto S : Segments)
-      OSS << S.Data << std::endl;
-
-    return OSS.str();
-  }
+  // The POF text of the file; see ObjectWriter.
+  std::string GenerateTextRepresentation() const;
 };
 
 class ObjectReader {
@@ -96,8 +486,10 @@ public:
 
   FileHeader FH;
   std::vector<Segment> Segments;
-  std::vector<Symbol> Symbols;
-  std::vector<Relocation> Relocations;
+  SymbolTable Symbols;
+  RelocationTable Relocations;
+  // When set, the data of group members it rejects is skipped, not read.
+  GroupFilter KeepGroup;
 
   ObjectReader(std::string FileName)
   : FileName{FileName},
@@ -140,11 +532,12 @@ public:
       return false;
   }
 
+  // The counts are decimal; every number after them is hex.
   bool ReadFileHeader() {
     IFS >> FH.Magic;
-    IFS >> FH.NumberOfSegments;
-    IFS >> FH.NumberOfSymbols;
-    IFS >> FH.NumberOfRelocations;
+    IFS >> std::dec >> FH.NumberOfSegments;
+    IFS >> std::dec >> FH.NumberOfSymbols;
+    IFS >> std::dec >> FH.NumberOfRelocations;
 
     if (IFS.fail())
       return false;
@@ -167,22 +560,62 @@ public:
     IFS >> std::hex >> S.Address;
     IFS >> std::hex >> S.Length;
     IFS >> S.Code;
+    S.Permissions = ParseSegmentPermissions(S.Code);
+    std::string Attributes;
+    std::getline(IFS, Attributes);
 
     Segments.push_back(S);
 
     if (IFS.fail()) {
       return false;
     } else {
-      return true;
+      return ReadSegmentAttributes(Segments.back(), Attributes);
     }
   }
 
+  // Optional "key=value" words after a segment's code. "G=signature" puts
+  // the segment in a link-once group. "M=S" marks it as mergeable strings
+  // and "M=size" as mergeable constants of that many bytes. "A=alignment"
+  // overrides the default alignment of 4. "Z=size" says
+  // the data line is the hex of an LZ block of that many bytes, which
+  // decompresses to the segment's Length bytes.
+  bool ReadSegmentAttributes(Segment& S, const std::string& Attributes) {
+    std::istringstream ISS{Attributes};
+    std::string Attribute;
+    while (ISS >> Attribute) {
+      if (Attribute.size() < 3 || Attribute[1] != '=')
+        return false;
+      std::string Value = Attribute.substr(2);
+      if (Attribute[0] == 'G') {
+        S.Group = Value;
+      } else if (Attribute[0] == 'M' && Value == "S") {
+        S.MergeStrings = true;
+      } else if (Attribute[0] == 'M') {
+        std::istringstream ValueStream{Value};
+        if (!(ValueStream >> std::hex >> S.MergeEntrySize) || S.MergeEntrySize <= 0)
+          return false;
+      } else if (Attribute[0] == 'A') {
+        std::istringstream ValueStream{Value};
+        if (!(ValueStream >> std::hex >> S.Alignment) || S.Alignment <= 0 || (S.Alignment & (S.Alignment - 1)))
+          return false;
+      } else if (Attribute[0] == 'Z') {
+        std::istringstream ValueStream{Value};
+        if (!(ValueStream >> std::hex >> S.CompressedSize) || S.CompressedSize <= 0 || S.Length <= 0)
+          return false;
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+
   bool ReadSymbolTableEntry() {
     Symbol S;
     IFS >> S.Name;
     IFS >> std::hex >> S.Value;
-    IFS >> S.SegmentNumber;
+    IFS >> std::hex >> S.SegmentNumber;
     IFS >> S.Type;
+    IFS.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 
     Symbols.push_back(S);
 
@@ -204,9 +637,13 @@ public:
   bool ReadRelocationEntry() {
     Relocation R;
     IFS >> std::hex >> R.Location;
-    IFS >> R.SegmentNumber;
-    IFS >> R.Ref;
+    IFS >> std::hex >> R.SegmentNumber;
+    IFS >> std::hex >> R.Ref;
     IFS >> R.Type;
+    std::string Addend;
+    std::getline(IFS, Addend);
+    if (Addend.find_first_not_of(" \t\r") != std::string::npos)
+      R.Addend = static_cast<int>(std::strtol(Addend.c_str(), nullptr, 16));
 
     Relocations.push_back(R);
 
@@ -225,10 +662,37 @@ public:
     return true;
   }
 
+  // Every segment has one data line, which is empty when the segment has
+  // no data, so data is read a line at a time.
   bool ReadDataForSegment(Segment& S) {
-    IFS >> S.Data;
+    std::getline(IFS, S.Data);
+    while (!S.Data.empty() && std::isspace(static_cast<unsigned char>(S.Data.back())))
+      S.Data.pop_back();
 
-    if (IFS.fail())
+    if (IFS.bad() || (IFS.fail() && S.Length > 0))
+      return false;
+    if (S.Compressed())
+      return DecodeCompressedData(S);
+    return true;
+  }
+
+  // Compressed blocks are checked here, so that copying them out later
+  // cannot fail.
+  bool DecodeCompressedData(Segment& S) {
+    std::string Hex;
+    Hex.swap(S.Data);
+    if (Hex.size() != 2 * static_cast<size_t>(S.CompressedSize))
+      return false;
+    S.CompressedData.resize(static_cast<size_t>(S.CompressedSize));
+    ReadHexBytes(&S.CompressedData[0], Hex);
+    return LZValidate(S.CompressedData, static_cast<size_t>(S.Length));
+  }
+
+  bool SkipDataForSegment(Segment& S) {
+    S.Discarded = true;
+    IFS.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+    if (IFS.bad())
       return false;
     else
       return true;
@@ -236,7 +700,8 @@ public:
 
   bool ReadSegmentData() {
     for (auto& S : Segments) {
-      bool ReadDataForSegmentSuccess = ReadDataForSegment(S);
+      bool Keep = S.Group.empty() || !KeepGroup || KeepGroup(S.Group);
+      bool ReadDataForSegmentSuccess = Keep ? ReadDataForSegment(S) : SkipDataForSegment(S);
       if (ReadDataForSegmentSuccess == false) return false;
     }
     return true;
@@ -0,0 +1,44 @@
+#ifndef ObjectWriter_h
+#define ObjectWriter_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <ObjectReader/ObjectReader.h>
+
+namespace ldl {
+
+// Writes an ObjectFile in the POF text format that ObjectReader reads.
+//
+// The three counts of the header are decimal; every other number is hex.
+// Relocations end with their addend when it is not zero.
+// Numbers go through std::to_chars, with no streams or locales involved.
+//
+// The output is a sequence of lines: the header, one per segment header,
+// symbol and relocation, and one data line per segment. Every line is
+// measured first, in parallel; a prefix sum of the lengths then gives each
+// line its place in a buffer allocated once, and the lines are rendered
+// into place in parallel. Write hands the buffer to a single write call.
+class ObjectWriter {
+public:
+  const ObjectFile& OF;
+
+  ObjectWriter(const ObjectFile& OF) :OF{OF} { }
+
+  std::string Text() const;
+  // Returns false if the file could not be written.
+  bool Write(const std::string& FileName) const;
+  // Writes text already rendered, and perhaps patched, by Text().
+  static bool WriteText(const std::string& FileName, std::string_view Text);
+
+private:
+  // Lines are numbered across the sections: the header's two lines count as
+  // one, then the segment headers, symbols, relocations and data lines.
+  size_t NumberOfLines() const;
+  size_t LineLength(size_t Line) const;
+  void RenderLine(size_t Line, char* Out) const;
+};
+}
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef XRef_h
+#define XRef_h
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <ElfReader/MappedFile.h>
+
+namespace ldl {
+
+// How a file mentions a symbol: it defines it, holds a common block of it,
+// or references it. References come from the relocations against the
+// symbol, so they carry the segment that needs it; an undefined symbol no
+// relocation uses is a reference without a segment. Local symbols are
+// private to their file and are not indexed.
+enum class XRefKind : uint32_t { Definition, Common, Reference };
+
+const char* XRefKindName(XRefKind Kind);
+
+// What one input file contributes to a cross-reference index, and the
+// modification time, size and hash it had when it was read.
+class XRefFile {
+public:
+  class Entry {
+  public:
+    std::string Name;
+    // 1-based index into Segments, 0 for none.
+    uint32_t Segment = 0;
+    XRefKind Kind = XRefKind::Reference;
+  };
+
+  std::string FileName;
+  int64_t ModificationTime = 0;
+  int64_t Size = 0;
+  uint64_t Hash = 0;
+  std::vector<std::string> Segments;
+  std::vector<Entry> Entries;
+
+  // Reads FileName, a POF or ELF object, into Segments and Entries. Each
+  // entry is kept once however often the file repeats it.
+  void Read();
+};
+
+// A cross-reference index as written to disk, read in place from a
+// mapping of the file. Everything is native-endian 32-bit words except the
+// 64-bit fields of the header and the file records:
+//
+//   Header
+//   FileRecord[NumberOfFiles]
+//   SegmentRecord[NumberOfSegments]    the segment names of every file
+//   NameRecord[NumberOfNames]          sorted by name
+//   PostingRecord[NumberOfPostings]    grouped by name, then by kind, file
+//                                      and segment
+//   string pool                        names, paths and segment names
+//
+// A name's postings are found by a binary search over the name records,
+// so a lookup touches a handful of pages whatever the size of the index.
+// Opening an index checks every offset and count it holds once.
+class XRefIndex {
+public:
+  static constexpr char Magic[8] = {'L', 'D', 'L', 'X', 'R', 'E', 'F', '\0'};
+  static constexpr uint32_t Version = 1;
+
+  class Header {
+  public:
+    char Magic[8];
+    uint32_t Version;
+    uint32_t NumberOfFiles;
+    uint32_t NumberOfSegments;
+    uint32_t NumberOfNames;
+    uint32_t NumberOfPostings;
+    uint32_t Reserved;
+    uint64_t StringPoolSize;
+  };
+  class FileRecord {
+  public:
+    int64_t ModificationTime;
+    int64_t Size;
+    uint64_t Hash;
+    uint32_t Path;
+    uint32_t PathLength;
+    uint32_t FirstSegment;
+    uint32_t NumberOfSegments;
+  };
+  class SegmentRecord {
+  public:
+    uint32_t Name;
+    uint32_t NameLength;
+  };
+  class NameRecord {
+  public:
+    uint32_t Name;
+    uint32_t NameLength;
+    uint32_t FirstPosting;
+    uint32_t NumberOfPostings;
+  };
+  class PostingRecord {
+  public:
+    uint32_t File;
+    uint32_t Segment;
+    XRefKind Kind;
+  };
+
+  // One posting with its strings resolved. Segment is empty for none.
+  class Posting {
+  public:
+    XRefKind Kind;
+    std::string_view FileName;
+    std::string_view Segment;
+  };
+
+  // Maps an index file; throws if it is not one or a record points outside
+  // it.
+  XRefIndex(const std::string& FileName);
+
+  // The postings of Name, empty if no file mentions it.
+  std::vector<Posting> Lookup(std::string_view Name) const;
+
+  uint32_t NumberOfFiles() const { return H->NumberOfFiles; }
+  uint32_t NumberOfNames() const { return H->NumberOfNames; }
+  uint32_t NumberOfPostings() const { return H->NumberOfPostings; }
+
+private:
+  friend class XRefBuilder;
+
+  std::shared_ptr<MappedFile> Mapping;
+  const Header* H = nullptr;
+  const FileRecord* Files = nullptr;
+  const SegmentRecord* Segments = nullptr;
+  const NameRecord* Names = nullptr;
+  const PostingRecord* Postings = nullptr;
+  const char* Strings = nullptr;
+
+  std::string_view String(uint32_t Offset, uint32_t Length) const { return {Strings + Offset, Length}; }
+};
+
+// Keeps the files of an index up to date. Update reuses a file's entries
+// while its modification time and size are unchanged, or while its size and
+// hash are, as ObjectCache does, and reads the rest in parallel.
+//
+// Files reused from a loaded index keep their postings in its mapping and
+// have no Entries of their own. Those postings are already in name order,
+// so Build merges the entries of the files that were read into them rather
+// than sorting every posting again, and an update costs one pass over the
+// old index plus the files that changed.
+class XRefBuilder {
+public:
+  std::vector<XRefFile> Files;
+  // Files read and reused by the last Update.
+  size_t Read = 0;
+  size_t Reused = 0;
+
+  // Starts from the files of an existing index, which stays mapped.
+  void Load(const std::string& IndexFileName);
+  // Makes Files the files named, in that order. Throws if one cannot be
+  // read.
+  void Update(const std::vector<std::string>& FileNames);
+  // The index of Files.
+  std::string Build() const;
+  // Writes the index to a uniquely named temporary file and renames it over
+  // FileName, so that readers mapping the old index keep a consistent copy.
+  bool Write(const std::string& FileName) const;
+
+private:
+  std::shared_ptr<const XRefIndex> Base;
+  static constexpr uint32_t NotInBase = UINT32_MAX;
+  // For each of Files, its file in Base, or NotInBase if it was read.
+  std::vector<uint32_t> BaseFiles;
+};
+}
+
+#endif
@@ -0,0 +1,51 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <Loader/Loader.h>
+
+// Maps a linked POF image and the shared libraries it imports from into
+// this process and jumps to its entry point. Images are expected to end
+// with an exit system call.
+int main(int argc, const char **argv) {
+  std::vector<std::string> Args(argv + 1, argv + argc);
+  ldl::Loader Loader;
+  std::string FileName;
+  std::string Entry = "_start";
+  std::vector<std::string> Libraries;
+  bool BadUsage = false;
+  for (size_t i = 0; i < Args.size(); i++) {
+    if (Args[i] == "--rebase")
+      Loader.Rebase = true;
+    else if (Args[i] == "--now")
+      Loader.LazyBinding = false;
+    else if (Args[i] == "--library" && i + 1 < Args.size())
+      Libraries.push_back(Args[++i]);
+    else if (Args[i] == "--entry" && i + 1 < Args.size())
+      Entry = Args[++i];
+    else if (FileName.empty() && !Args[i].empty() && Args[i][0] != '-')
+      FileName = Args[i];
+    else
+      BadUsage = true;
+  }
+  if (BadUsage || FileName.empty()) {
+    std::cerr << "usage: ldl-run [--rebase] [--now] [--library file]... [--entry symbol] image" << std::endl;
+    return 1;
+  }
+
+  try {
+    for (auto& Library : Libraries)
+      Loader.LoadLibrary(Library);
+    auto Image = Loader.Load(FileName);
+    void* Address = Image->Entry(Entry);
+    if (Address == nullptr) {
+      std::cerr << "ldl-run: no entry point in " << FileName << std::endl;
+      return 1;
+    }
+    reinterpret_cast<void (*)()>(Address)();
+  } catch (const char* Message) {
+    std::cerr << "ldl-run: " << Message << std::endl;
+    return 1;
+  }
+  return 0;
+}
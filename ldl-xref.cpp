@@ -0,0 +1,61 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <XRef/XRef.h>
+
+// Builds and queries a cross-reference index of object files: which files
+// define or hold a common block of a symbol and which files and segments
+// reference it. update reads only the files that changed since the index
+// was last written.
+int main(int argc, const char **argv) {
+  std::vector<std::string> Args(argv + 1, argv + argc);
+  std::string Command = Args.empty() ? "" : Args[0];
+  bool Query = Command == "defines" || Command == "refs" || Command == "all";
+  if (Args.size() < 3 || (Command != "update" && !Query)) {
+    std::cerr << "usage: ldl-xref update index files..." << std::endl
+              << "       ldl-xref defines|refs|all index names..." << std::endl;
+    return 1;
+  }
+  const std::string& IndexFileName = Args[1];
+
+  try {
+    if (Command == "update") {
+      ldl::XRefBuilder Builder;
+      struct stat ST;
+      if (stat(IndexFileName.c_str(), &ST) == 0)
+        Builder.Load(IndexFileName);
+      Builder.Update(std::vector<std::string>(Args.begin() + 2, Args.end()));
+      if (!Builder.Write(IndexFileName)) {
+        std::cerr << "ldl-xref: could not write " << IndexFileName << std::endl;
+        return 1;
+      }
+      std::cerr << "ldl-xref: " << Builder.Read << " files read, " << Builder.Reused << " reused" << std::endl;
+      return 0;
+    }
+
+    ldl::XRefIndex Index{IndexFileName};
+    int Status = 0;
+    for (size_t i = 2; i < Args.size(); i++) {
+      bool Found = false;
+      for (auto& P : Index.Lookup(Args[i])) {
+        bool Definition = P.Kind != ldl::XRefKind::Reference;
+        if ((Command == "defines" && !Definition) || (Command == "refs" && Definition))
+          continue;
+        Found = true;
+        std::cout << Args[i] << " " << ldl::XRefKindName(P.Kind) << " " << P.FileName;
+        if (!P.Segment.empty())
+          std::cout << " " << P.Segment;
+        std::cout << std::endl;
+      }
+      if (!Found)
+        Status = 1;
+    }
+    return Status;
+  } catch (const char* Message) {
+    std::cerr << "ldl-xref: " << Message << std::endl;
+    return 1;
+  }
+}
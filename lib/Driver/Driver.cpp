@@ -0,0 +1,333 @@
+#include <Driver/Driver.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <ElfWriter/ElfWriter.h>
+#include <Linker/Parallel.h>
+#include <ObjectReader/ObjectWriter.h>
+
+namespace ldl {
+
+void PrintUsage(std::ostream& Errors) {
+  Errors << "usage: linker [-o output] [--format pof|elf] [--entry symbol]" << std::endl
+         << "              [--image-base address] [--symbol-ordering-file file]" << std::endl
+         << "              [--call-graph-profile file] [--tail-merge-strings]" << std::endl
+         << "              [--shared] [--library file] [--build-id[=fast|sha256|none]]" << std::endl
+         << "              [-r] [--shards count] [--compress] [--stats] [--trace]" << std::endl
+         << "              files..." << std::endl
+         << "       linker --server socket" << std::endl
+         << "       linker --connect socket [link arguments...]" << std::endl;
+}
+
+bool ParseLinkOptions(const std::vector<std::string>& Args, LinkOptions& Options, std::ostream& Errors) {
+  for (size_t i = 0; i < Args.size(); i++) {
+    const std::string& Arg = Args[i];
+    bool HasValue = i + 1 < Args.size();
+    if (Arg == "-o" && HasValue)
+      Options.Output = Args[++i];
+    else if (Arg == "--format" && HasValue)
+      Options.Format = Args[++i];
+    else if (Arg == "--entry" && HasValue)
+      Options.Entry = Args[++i];
+    else if (Arg == "--image-base" && HasValue) {
+      try {
+        Options.ImageBase = std::stoi(Args[++i], nullptr, 0);
+      } catch (const std::exception&) {
+        Errors << "linker: bad image base " << Args[i] << std::endl;
+        return false;
+      }
+    }
+    else if (Arg == "--symbol-ordering-file" && HasValue)
+      Options.SymbolOrderingFile = Args[++i];
+    else if (Arg == "--call-graph-profile" && HasValue)
+      Options.CallGraphProfile = Args[++i];
+    else if (Arg == "--tail-merge-strings")
+      Options.TailMergeStrings = true;
+    else if (Arg == "--shared")
+      Options.Shared = true;
+    else if (Arg == "--library" && HasValue)
+      Options.Libraries.push_back(Args[++i]);
+    else if (Arg == "--build-id" || Arg == "--build-id=fast")
+      Options.BuildId = BuildIdKind::Fast;
+    else if (Arg == "--build-id=sha256")
+      Options.BuildId = BuildIdKind::SHA256;
+    else if (Arg == "--build-id=none")
+      Options.BuildId = BuildIdKind::None;
+    else if (Arg == "-r")
+      Options.Relocatable = true;
+    else if (Arg == "--shards" && HasValue) {
+      try {
+        Options.Shards = std::stoi(Args[++i]);
+      } catch (const std::exception&) {
+        Options.Shards = 0;
+      }
+      if (Options.Shards < 1) {
+        Errors << "linker: bad shard count " << Args[i] << std::endl;
+        return false;
+      }
+    }
+    else if (Arg == "--compress")
+      Options.Compress = true;
+    else if (Arg == "--stats")
+      Options.Stats = true;
+    else if (Arg == "--trace")
+      Options.Trace = true;
+    else if (Arg == "--server" && HasValue)
+      Options.ServerSocket = Args[++i];
+    else if (Arg == "--connect" && HasValue)
+      Options.ConnectSocket = Args[++i];
+    else if (!Arg.empty() && Arg[0] == '-') {
+      Errors << "linker: unknown option " << Arg << std::endl;
+      return false;
+    } else
+      Options.FileNames.push_back(Arg);
+  }
+
+  if (!Options.ServerSocket.empty() || !Options.ConnectSocket.empty())
+    return true;
+  if (Options.FileNames.empty()) {
+    Errors << "linker: no input files" << std::endl;
+    return false;
+  }
+  if (Options.Format != "pof" && Options.Format != "elf") {
+    Errors << "linker: unknown format " << Options.Format << std::endl;
+    return false;
+  }
+  if (Options.Format == "elf" && (Options.Shared || !Options.Libraries.empty())) {
+    Errors << "linker: shared libraries are only supported with --format pof" << std::endl;
+    return false;
+  }
+  if (Options.Format == "elf" && Options.BuildId != BuildIdKind::None) {
+    Errors << "linker: --build-id is only supported with --format pof" << std::endl;
+    return false;
+  }
+  if (Options.Format == "elf" && Options.Compress) {
+    Errors << "linker: --compress is only supported with --format pof" << std::endl;
+    return false;
+  }
+  if (Options.Relocatable && (Options.Format != "pof" || Options.Shared || !Options.Libraries.empty()
+    || Options.BuildId != BuildIdKind::None)) {
+    Errors << "linker: -r only writes plain pof objects" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void PrintLinkStats(const LinkStats& Stats, std::ostream& OS) {
+  OS << "link-once groups kept: " << Stats.GroupsKept << std::endl
+     << "link-once groups discarded: " << Stats.GroupsDiscarded << std::endl
+     << "discarded segments: " << Stats.SegmentsDiscarded << std::endl
+     << "discarded bytes: " << Stats.BytesDiscarded << std::endl
+     << "mergeable pieces: " << Stats.MergePieces << std::endl
+     << "unique mergeable pieces: " << Stats.UniqueMergePieces << std::endl
+     << "bytes saved by merging: " << Stats.MergeBytesSaved << std::endl
+     << "relocations applied: " << Stats.RelocationsApplied << std::endl
+     << "relocations against undefined symbols: " << Stats.RelocationsUndefined << std::endl
+     << "invalid relocations: " << Stats.RelocationsInvalid << std::endl
+     << "overflowed relocations: " << Stats.RelocationsOverflowed << std::endl;
+}
+
+void PrintMemoryStats(const MemoryStats& Memory, std::ostream& OS) {
+  for (auto& P : Memory.Phases) {
+    OS << "phase ";
+    PrintPhaseStats(P, OS);
+    OS << std::endl;
+  }
+  for (auto& S : Memory.Structures)
+    OS << "memory " << S.Name << ": " << S.Bytes << " bytes, high-water " << S.HighWater << " bytes" << std::endl;
+}
+
+namespace {
+// Segments are compressed one to a thread; the chunks are weighed by bytes
+// so that a few large segments still spread out.
+void CompressSegments(std::vector<Segment>& Ss, const std::string& Except) {
+  size_t N = Ss.size();
+  size_t Bytes = 0;
+  for (auto& S : Ss)
+    Bytes += static_cast<size_t>(std::max(S.Length, 0));
+  ParallelForChunks(N, std::min(N, ParallelChunkCount(N + Bytes / 64)), [&](size_t, size_t First, size_t Last) {
+    for (size_t i = First; i < Last; i++)
+      if (Ss[i].Name != Except)
+        CompressSegment(Ss[i]);
+  });
+}
+}
+
+int RunLink(const LinkOptions& Options, Linker& L, std::ostream& Errors) {
+  if (Options.Shards > 1)
+    return RunShardedLink(Options, L, Errors);
+  try {
+    L.Reset();
+    L.FileNames = Options.FileNames;
+    if (Options.ImageBase >= 0)
+      L.TextAddress = Options.ImageBase;
+    else if (Options.Format == "elf")
+      L.TextAddress = 0x401000;
+    else
+      L.TextAddress = 0x1000;
+    L.TailMergeStrings = Options.TailMergeStrings;
+    L.Shared = Options.Shared;
+    L.Libraries = Options.Libraries;
+    L.BuildIdType = Options.BuildId;
+    L.Relocatable = Options.Relocatable;
+    L.Memory.Enabled = Options.Stats || Options.Trace;
+    L.Memory.Trace = Options.Trace ? &Errors : nullptr;
+    AllocationCounting Counting{L.Memory.Enabled};
+
+    L.Ordering.Clear();
+    if (!Options.SymbolOrderingFile.empty() && !L.Ordering.ReadSymbolOrderingFile(Options.SymbolOrderingFile)) {
+      Errors << "linker: could not read " << Options.SymbolOrderingFile << std::endl;
+      return 1;
+    }
+    if (!Options.CallGraphProfile.empty() && !L.Ordering.ReadCallGraphProfile(Options.CallGraphProfile)) {
+      Errors << "linker: could not read " << Options.CallGraphProfile << std::endl;
+      return 1;
+    }
+    L.ReadFiles();
+    auto OFPtr = L.GenerateObjectFile();
+
+    // Whichever copy a reference bound to, the image would be wrong.
+    if (!L.DuplicateSymbols.empty()) {
+      for (auto& Name : L.DuplicateSymbols)
+        Errors << "linker: duplicate symbol " << Name << std::endl;
+      return 1;
+    }
+    if (L.Stats.RelocationsIntoMerged > 0) {
+      Errors << "linker: " << L.Stats.RelocationsIntoMerged << " relocations point outside the pieces of merged segments"
+             << std::endl;
+      return 1;
+    }
+    if (L.Stats.RelocationsOverflowed > 0) {
+      Errors << "linker: " << L.Stats.RelocationsOverflowed << " relocations do not fit their words" << std::endl;
+      return 1;
+    }
+
+    if (Options.Format == "elf") {
+      // An executable cannot run with references left unresolved.
+      if (!L.UndefinedSymbols.empty()) {
+        for (auto& Name : L.UndefinedSymbols)
+          Errors << "linker: undefined symbol " << Name << std::endl;
+        return 1;
+      }
+      LinkPhase Phase{L, "write"};
+      ElfWriter EW{L};
+      EW.EntrySymbol = Options.Entry;
+      EW.Write(Options.Output);
+    } else {
+      // The build-id is hashed from the rendered text, just before the one
+      // write of it. Its note is left uncompressed to be patched in place.
+      std::string Text;
+      {
+        LinkPhase Phase{L, "render"};
+        if (Options.Compress)
+          CompressSegments(OFPtr->Segments, L.BuildIdSegment.Name);
+        Text = ObjectWriter{*OFPtr}.Text();
+        if (L.BuildIdType != BuildIdKind::None)
+          L.StampBuildId(Text);
+      }
+      LinkPhase Phase{L, "write"};
+      if (!ObjectWriter::WriteText(Options.Output, Text)) {
+        Errors << "linker: could not write " << Options.Output << std::endl;
+        return 1;
+      }
+    }
+    if (Options.Stats) {
+      PrintLinkStats(L.Stats, Errors);
+      PrintMemoryStats(L.Memory, Errors);
+    }
+  } catch (const char* Message) {
+    Errors << "linker: " << Message << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+// Workers are forked, so they run with the Linker code already loaded. Each
+// sends its diagnostics back through a pipe, since Errors may be a stream
+// in this process's memory, as it is for the link server; they are copied
+// to Errors in shard order.
+int RunShardedLink(const LinkOptions& Options, Linker& L, std::ostream& Errors) {
+  size_t NumberOfInputs = Options.FileNames.size();
+  size_t NumberOfShards = std::min<size_t>(static_cast<size_t>(Options.Shards), NumberOfInputs);
+
+  LinkOptions Final = Options;
+  Final.Shards = 1;
+  Final.FileNames.clear();
+  std::vector<pid_t> Workers;
+  std::vector<int> Pipes;
+  bool Failed = false;
+  for (size_t Shard = 0; Shard < NumberOfShards; Shard++) {
+    LinkOptions Part = Options;
+    Part.Shards = 1;
+    Part.Relocatable = true;
+    Part.Format = "pof";
+    Part.Shared = false;
+    Part.Libraries.clear();
+    Part.BuildId = BuildIdKind::None;
+    Part.Stats = false;
+    Part.Trace = false;
+    Part.Compress = false;
+    Part.FileNames.assign(Options.FileNames.begin() + NumberOfInputs * Shard / NumberOfShards,
+      Options.FileNames.begin() + NumberOfInputs * (Shard + 1) / NumberOfShards);
+    Part.Output = Options.Output + ".shard" + std::to_string(Shard);
+    Final.FileNames.push_back(Part.Output);
+
+    int Pipe[2];
+    if (pipe(Pipe) != 0) {
+      Errors << "linker: could not start a worker" << std::endl;
+      Failed = true;
+      break;
+    }
+    Errors.flush();
+    pid_t Worker = fork();
+    if (Worker == 0) {
+      close(Pipe[0]);
+      Linker PartLinker;
+      std::ostringstream PartErrors;
+      int Status = RunLink(Part, PartLinker, PartErrors);
+      std::string Diagnostics = PartErrors.str();
+      for (size_t Written = 0; Written < Diagnostics.size();) {
+        ssize_t N = write(Pipe[1], Diagnostics.data() + Written, Diagnostics.size() - Written);
+        if (N <= 0)
+          break;
+        Written += static_cast<size_t>(N);
+      }
+      _exit(Status);
+    }
+    close(Pipe[1]);
+    if (Worker < 0) {
+      close(Pipe[0]);
+      Errors << "linker: could not start a worker" << std::endl;
+      Failed = true;
+      break;
+    }
+    Workers.push_back(Worker);
+    Pipes.push_back(Pipe[0]);
+  }
+
+  // Each pipe is drained before its worker is waited for, so a worker with
+  // more to say than a pipe holds does not block.
+  for (size_t i = 0; i < Workers.size(); i++) {
+    char Buffer[4096];
+    ssize_t N;
+    while ((N = read(Pipes[i], Buffer, sizeof(Buffer))) > 0)
+      Errors.write(Buffer, N);
+    close(Pipes[i]);
+    int Status;
+    if (waitpid(Workers[i], &Status, 0) != Workers[i] || !WIFEXITED(Status) || WEXITSTATUS(Status) != 0)
+      Failed = true;
+  }
+
+  int Status = 1;
+  if (!Failed)
+    Status = RunLink(Final, L, Errors);
+  for (auto& FileName : Final.FileNames)
+    std::remove(FileName.c_str());
+  return Status;
+}
+}
@@ -0,0 +1 @@
+#include <ElfWriter/ElfWriter.h>
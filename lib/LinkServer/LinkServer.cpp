@@ -0,0 +1,176 @@
+#include <LinkServer/LinkServer.h>
+
+#include <climits>
+#include <cstring>
+#include <sstream>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <Driver/Driver.h>
+
+namespace ldl {
+
+static sockaddr_un SocketAddress(const std::string& SocketPath) {
+  sockaddr_un Address;
+  std::memset(&Address, 0, sizeof(Address));
+  Address.sun_family = AF_UNIX;
+  if (SocketPath.size() >= sizeof(Address.sun_path))
+    throw "Socket path too long";
+  std::memcpy(Address.sun_path, SocketPath.c_str(), SocketPath.size() + 1);
+  return Address;
+}
+
+static bool WriteAll(int FD, const std::string& Data) {
+  size_t Written = 0;
+  while (Written < Data.size()) {
+    ssize_t N = write(FD, Data.data() + Written, Data.size() - Written);
+    if (N <= 0)
+      return false;
+    Written += static_cast<size_t>(N);
+  }
+  return true;
+}
+
+// Reads newline-separated lines up to the first empty line.
+static bool ReadRequest(int FD, std::vector<std::string>& Lines) {
+  std::string Line;
+  char Buffer[4096];
+  while (true) {
+    ssize_t N = read(FD, Buffer, sizeof(Buffer));
+    if (N <= 0)
+      return false;
+    for (ssize_t i = 0; i < N; i++) {
+      if (Buffer[i] != '\n') {
+        Line += Buffer[i];
+        continue;
+      }
+      if (Line.empty())
+        return true;
+      Lines.push_back(Line);
+      Line.clear();
+    }
+  }
+}
+
+static std::string ReadAll(int FD) {
+  std::string Data;
+  char Buffer[4096];
+  ssize_t N;
+  while ((N = read(FD, Buffer, sizeof(Buffer))) > 0)
+    Data.append(Buffer, static_cast<size_t>(N));
+  return Data;
+}
+
+static int Connect(const std::string& SocketPath) {
+  sockaddr_un Address = SocketAddress(SocketPath);
+  int FD = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (FD < 0)
+    throw "Could not create socket";
+  if (connect(FD, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) != 0) {
+    close(FD);
+    throw "Could not connect to link server";
+  }
+  return FD;
+}
+
+LinkServer::LinkServer(std::string SocketPath) :SocketPath{SocketPath} {
+  L.Cache = &Cache;
+}
+
+LinkServer::~LinkServer() {
+  if (ListenFD >= 0) {
+    close(ListenFD);
+    unlink(SocketPath.c_str());
+  }
+}
+
+void LinkServer::Listen() {
+  sockaddr_un Address = SocketAddress(SocketPath);
+  ListenFD = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (ListenFD < 0)
+    throw "Could not create socket";
+  unlink(SocketPath.c_str());
+  if (bind(ListenFD, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) != 0
+    || listen(ListenFD, 16) != 0)
+    throw "Could not listen on link server socket";
+}
+
+void LinkServer::Serve() {
+  bool Running = true;
+  while (Running) {
+    int FD = accept(ListenFD, nullptr, nullptr);
+    if (FD < 0)
+      continue;
+    timeval Timeout{ClientTimeout, 0};
+    setsockopt(FD, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout));
+    setsockopt(FD, SOL_SOCKET, SO_SNDTIMEO, &Timeout, sizeof(Timeout));
+    std::vector<std::string> Lines;
+    std::string Reply = "1\nlinker: malformed request\n";
+    if (ReadRequest(FD, Lines))
+      Running = HandleRequest(Lines, Reply);
+    WriteAll(FD, Reply);
+    close(FD);
+  }
+}
+
+bool LinkServer::HandleRequest(const std::vector<std::string>& Lines, std::string& Reply) {
+  Requests++;
+  if (!Lines.empty() && Lines[0] == "SHUTDOWN") {
+    Reply = "0\n";
+    return false;
+  }
+  if (Lines.size() < 2 || Lines[0] != "LINK") {
+    Reply = "1\nlinker: malformed request\n";
+    return true;
+  }
+
+  std::ostringstream Errors;
+  LinkOptions Options;
+  std::vector<std::string> Args(Lines.begin() + 2, Lines.end());
+  int Status = 1;
+  // The server handles one request at a time, so it can simply work from
+  // the client's directory.
+  if (chdir(Lines[1].c_str()) != 0)
+    Errors << "linker: could not change to " << Lines[1] << std::endl;
+  else if (ParseLinkOptions(Args, Options, Errors))
+    Status = RunLink(Options, L, Errors);
+  // Inputs deleted since they were cached would otherwise stay for good.
+  Cache.Prune();
+
+  Reply = std::to_string(Status) + "\n" + Errors.str();
+  return true;
+}
+
+int ForwardToLinkServer(const std::string& SocketPath, const std::vector<std::string>& Args, std::ostream& Errors) {
+  char Directory[PATH_MAX];
+  if (getcwd(Directory, sizeof(Directory)) == nullptr)
+    throw "Could not get working directory";
+
+  std::string Request = "LINK\n" + std::string(Directory) + "\n";
+  for (auto& Arg : Args)
+    Request += Arg + "\n";
+  Request += "\n";
+
+  int FD = Connect(SocketPath);
+  WriteAll(FD, Request);
+  std::string Reply = ReadAll(FD);
+  close(FD);
+
+  size_t Newline = Reply.find('\n');
+  if (Newline == std::string::npos)
+    throw "Malformed reply from link server";
+  Errors << Reply.substr(Newline + 1);
+  return std::stoi(Reply.substr(0, Newline));
+}
+
+int ShutdownLinkServer(const std::string& SocketPath) {
+  int FD = Connect(SocketPath);
+  WriteAll(FD, "SHUTDOWN\n\n");
+  std::string Reply = ReadAll(FD);
+  close(FD);
+  return Reply == "0\n" ? 0 : 1;
+}
+}
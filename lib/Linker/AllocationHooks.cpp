@@ -0,0 +1,91 @@
+// The replaced global allocation functions that feed AllocationCounter.
+// This is its own object, linked only into the programs that report memory,
+// so that the Linker library leaves every other program's allocator alone.
+//
+// Each block starts with a header recording its size and whether it was
+// counted, so that a free takes off only what its allocation added, however
+// counting was switched in between. The array and nothrow forms of the
+// standard library call these.
+
+#include <Linker/MemoryStats.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+class BlockHeader {
+public:
+  size_t Size;
+  bool Counted;
+};
+
+// Keeps the block after the header as aligned as malloc's.
+constexpr size_t HeaderSize = alignof(std::max_align_t);
+static_assert(sizeof(BlockHeader) <= HeaderSize, "the header must fit before the block");
+
+BlockHeader* Header(void* P) {
+  return reinterpret_cast<BlockHeader*>(static_cast<char*>(P) - sizeof(BlockHeader));
+}
+
+// Room for the header ahead of a block aligned to Alignment.
+size_t Offset(std::size_t Alignment) {
+  return Alignment > HeaderSize ? Alignment : HeaderSize;
+}
+
+void* Allocate(std::size_t Size, std::size_t Alignment) {
+  size_t Before = Offset(Alignment);
+  size_t Total = Before + (Size ? Size : 1);
+  for (;;) {
+    void* Base;
+    if (Alignment > HeaderSize)
+      Base = std::aligned_alloc(Alignment, (Total + Alignment - 1) / Alignment * Alignment);
+    else
+      Base = std::malloc(Total);
+    if (Base) {
+      void* P = static_cast<char*>(Base) + Before;
+      bool Counted = ldl::AllocationCounter::Enabled();
+      *Header(P) = BlockHeader{Size, Counted};
+      if (Counted)
+        ldl::AllocationCounter::Allocated(Size);
+      return P;
+    }
+    std::new_handler Handler = std::get_new_handler();
+    if (!Handler)
+      throw std::bad_alloc{};
+    Handler();
+  }
+}
+
+void Free(void* P, std::size_t Alignment) {
+  if (!P)
+    return;
+  if (Header(P)->Counted)
+    ldl::AllocationCounter::Freed(Header(P)->Size);
+  std::free(static_cast<char*>(P) - Offset(Alignment));
+}
+}
+
+void* operator new(std::size_t Size) {
+  return Allocate(Size, 0);
+}
+
+void* operator new(std::size_t Size, std::align_val_t Alignment) {
+  return Allocate(Size, static_cast<std::size_t>(Alignment));
+}
+
+void operator delete(void* P) noexcept {
+  Free(P, 0);
+}
+
+void operator delete(void* P, std::size_t) noexcept {
+  Free(P, 0);
+}
+
+void operator delete(void* P, std::align_val_t Alignment) noexcept {
+  Free(P, static_cast<std::size_t>(Alignment));
+}
+
+void operator delete(void* P, std::size_t, std::align_val_t Alignment) noexcept {
+  Free(P, static_cast<std::size_t>(Alignment));
+}
@@ -0,0 +1,200 @@
+#include <Linker/BuildId.h>
+
+#include <cstring>
+#include <vector>
+
+#include <Linker/Parallel.h>
+
+namespace ldl {
+
+namespace {
+constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t Prime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t Prime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t Prime5 = 0x27D4EB2F165667C5ULL;
+
+uint64_t RotateLeft(uint64_t Value, int Bits) {
+  return Value << Bits | Value >> (64 - Bits);
+}
+
+uint64_t Read64(const unsigned char* P) {
+  uint64_t Value = 0;
+  for (int i = 7; i >= 0; i--)
+    Value = Value << 8 | P[i];
+  return Value;
+}
+
+uint32_t Read32(const unsigned char* P) {
+  return static_cast<uint32_t>(P[0]) | static_cast<uint32_t>(P[1]) << 8
+    | static_cast<uint32_t>(P[2]) << 16 | static_cast<uint32_t>(P[3]) << 24;
+}
+
+uint64_t Round(uint64_t Accumulator, uint64_t Input) {
+  return RotateLeft(Accumulator + Input * Prime2, 31) * Prime1;
+}
+
+uint64_t MergeRound(uint64_t Accumulator, uint64_t Value) {
+  return (Accumulator ^ Round(0, Value)) * Prime1 + Prime4;
+}
+
+void PutLittleEndian(std::string& Out, uint64_t Value) {
+  for (int i = 0; i < 8; i++)
+    Out += static_cast<char>(Value >> (8 * i));
+}
+
+const uint32_t SHA256Constants[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+uint32_t RotateRight(uint32_t Value, int Bits) {
+  return Value >> Bits | Value << (32 - Bits);
+}
+
+void SHA256Block(uint32_t State[8], const unsigned char* Block) {
+  uint32_t W[64];
+  for (int i = 0; i < 16; i++)
+    W[i] = static_cast<uint32_t>(Block[4 * i]) << 24 | static_cast<uint32_t>(Block[4 * i + 1]) << 16
+      | static_cast<uint32_t>(Block[4 * i + 2]) << 8 | static_cast<uint32_t>(Block[4 * i + 3]);
+  for (int i = 16; i < 64; i++) {
+    uint32_t S0 = RotateRight(W[i - 15], 7) ^ RotateRight(W[i - 15], 18) ^ (W[i - 15] >> 3);
+    uint32_t S1 = RotateRight(W[i - 2], 17) ^ RotateRight(W[i - 2], 19) ^ (W[i - 2] >> 10);
+    W[i] = W[i - 16] + S0 + W[i - 7] + S1;
+  }
+
+  uint32_t A = State[0], B = State[1], C = State[2], D = State[3];
+  uint32_t E = State[4], F = State[5], G = State[6], H = State[7];
+  for (int i = 0; i < 64; i++) {
+    uint32_t S1 = RotateRight(E, 6) ^ RotateRight(E, 11) ^ RotateRight(E, 25);
+    uint32_t T1 = H + S1 + ((E & F) ^ (~E & G)) + SHA256Constants[i] + W[i];
+    uint32_t S0 = RotateRight(A, 2) ^ RotateRight(A, 13) ^ RotateRight(A, 22);
+    uint32_t T2 = S0 + ((A & B) ^ (A & C) ^ (B & C));
+    H = G;
+    G = F;
+    F = E;
+    E = D + T1;
+    D = C;
+    C = B;
+    B = A;
+    A = T1 + T2;
+  }
+  State[0] += A; State[1] += B; State[2] += C; State[3] += D;
+  State[4] += E; State[5] += F; State[6] += G; State[7] += H;
+}
+}
+
+uint64_t BuildId::XXHash64(std::string_view Bytes, uint64_t Seed) {
+  auto P = reinterpret_cast<const unsigned char*>(Bytes.data());
+  const unsigned char* End = P + Bytes.size();
+  uint64_t Hash;
+
+  if (Bytes.size() >= 32) {
+    uint64_t V1 = Seed + Prime1 + Prime2;
+    uint64_t V2 = Seed + Prime2;
+    uint64_t V3 = Seed;
+    uint64_t V4 = Seed - Prime1;
+    for (; P + 32 <= End; P += 32) {
+      V1 = Round(V1, Read64(P));
+      V2 = Round(V2, Read64(P + 8));
+      V3 = Round(V3, Read64(P + 16));
+      V4 = Round(V4, Read64(P + 24));
+    }
+    Hash = RotateLeft(V1, 1) + RotateLeft(V2, 7) + RotateLeft(V3, 12) + RotateLeft(V4, 18);
+    Hash = MergeRound(Hash, V1);
+    Hash = MergeRound(Hash, V2);
+    Hash = MergeRound(Hash, V3);
+    Hash = MergeRound(Hash, V4);
+  } else {
+    Hash = Seed + Prime5;
+  }
+  Hash += Bytes.size();
+
+  for (; P + 8 <= End; P += 8)
+    Hash = RotateLeft(Hash ^ Round(0, Read64(P)), 27) * Prime1 + Prime4;
+  if (P + 4 <= End) {
+    Hash = RotateLeft(Hash ^ Read32(P) * Prime1, 23) * Prime2 + Prime3;
+    P += 4;
+  }
+  for (; P < End; P++)
+    Hash = RotateLeft(Hash ^ *P * Prime5, 11) * Prime1;
+
+  Hash ^= Hash >> 33;
+  Hash *= Prime2;
+  Hash ^= Hash >> 29;
+  Hash *= Prime3;
+  Hash ^= Hash >> 32;
+  return Hash;
+}
+
+std::string BuildId::SHA256(std::string_view Bytes) {
+  uint32_t State[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  auto P = reinterpret_cast<const unsigned char*>(Bytes.data());
+  size_t Whole = Bytes.size() / 64 * 64;
+  for (size_t Offset = 0; Offset < Whole; Offset += 64)
+    SHA256Block(State, P + Offset);
+
+  // The rest, a one bit, zeros and the length in bits fill one or two
+  // final blocks.
+  unsigned char Tail[128] = {};
+  size_t Rest = Bytes.size() - Whole;
+  std::memcpy(Tail, P + Whole, Rest);
+  Tail[Rest] = 0x80;
+  size_t TailSize = Rest < 56 ? 64 : 128;
+  uint64_t Bits = static_cast<uint64_t>(Bytes.size()) * 8;
+  for (int i = 0; i < 8; i++)
+    Tail[TailSize - 1 - i] = static_cast<unsigned char>(Bits >> (8 * i));
+  for (size_t Offset = 0; Offset < TailSize; Offset += 64)
+    SHA256Block(State, Tail + Offset);
+
+  std::string Digest(32, '\0');
+  for (int i = 0; i < 32; i++)
+    Digest[i] = static_cast<char>(State[i / 4] >> (24 - 8 * (i % 4)));
+  return Digest;
+}
+
+size_t BuildId::Size(BuildIdKind Kind) {
+  switch (Kind) {
+  case BuildIdKind::Fast:
+    return 8;
+  case BuildIdKind::SHA256:
+    return 32;
+  default:
+    return 0;
+  }
+}
+
+std::string BuildId::Hash(BuildIdKind Kind, std::string_view Bytes) {
+  if (Kind == BuildIdKind::SHA256)
+    return SHA256(Bytes);
+  std::string Digest;
+  if (Kind == BuildIdKind::Fast)
+    PutLittleEndian(Digest, XXHash64(Bytes));
+  return Digest;
+}
+
+std::string BuildId::Compute(BuildIdKind Kind, std::string_view Bytes) {
+  size_t DigestSize = Size(Kind);
+  size_t NumberOfChunks = (Bytes.size() + ChunkSize - 1) / ChunkSize;
+  std::string Digests(NumberOfChunks * DigestSize, '\0');
+
+  // Chunks are large enough to be worth a thread each.
+  ParallelForChunks(NumberOfChunks, std::min(ParallelThreadCount(), NumberOfChunks), [&](size_t, size_t Begin, size_t End) {
+    for (size_t i = Begin; i < End; i++) {
+      std::string Digest = Hash(Kind, Bytes.substr(i * ChunkSize, ChunkSize));
+      std::memcpy(&Digests[i * DigestSize], Digest.data(), DigestSize);
+    }
+  });
+
+  PutLittleEndian(Digests, Bytes.size());
+  return Hash(Kind, Digests);
+}
+}
@@ -0,0 +1,498 @@
+#include <Linker/Linker.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <ElfReader/ElfReader.h>
+#include <Linker/ObjectCache.h>
+#include <Linker/Parallel.h>
+
+namespace ldl {
+
+ObjectFilePtr Linker::Link(const std::vector<std::string>& FileNames) {
+  Reset();
+  this->FileNames = FileNames;
+  ReadFiles();
+  return GenerateObjectFile();
+}
+
+void Linker::Reset() {
+  FileNames.clear();
+  ObjectFiles.clear();
+  Mappings.clear();
+  MergedSymbols.clear();
+  MergedRelocation.clear();
+  CommonSymbols.clear();
+  CommonOffsets.clear();
+  Groups.clear();
+  MergedSegments.clear();
+  UndefinedSymbols.clear();
+  DuplicateSymbols.clear();
+  AbsoluteWords.clear();
+  AbsoluteDoublewords.clear();
+  RelativeRelocationSegment.Length = 0x0;
+  RelativeRelocationSegment.Data.clear();
+  Imports.clear();
+  ImportIndex.clear();
+  ImportObjectIndex = -1;
+  BuildIdSegment.Length = 0x0;
+  BuildIdSegment.Data.clear();
+  PlacementBegin.clear();
+  RelocationsProcessed = false;
+  Placements.clear();
+  GlobalSymbols.clear();
+  Stats = LinkStats{};
+  Memory.Clear();
+
+  // Keep the per-name vectors; an empty one is skipped by the merge.
+  for (auto& CodeNamesPair : SegmentDataStructure)
+    for (auto& NameVectorPair : CodeNamesPair.second)
+      NameVectorPair.second.clear();
+
+  TextSegment = nullptr;
+  DataSegment = nullptr;
+  BSSSegment = nullptr;
+  RPSegments.clear();
+  RWPSegments.clear();
+  RWSegments.clear();
+  CommonSegment.Length = 0x0;
+  CommonSegment.Data.clear();
+}
+
+ObjectFilePtr ReadObjectFile(const std::string& FileName, const GroupFilter& KeepGroup) {
+  if (ElfReader::IsElfFile(FileName)) {
+    ElfReader ER{FileName};
+    ER.KeepGroup = KeepGroup;
+    return ER.GetObjectFile();
+  }
+  ObjectReader OR{FileName};
+  OR.KeepGroup = KeepGroup;
+  return OR.GetObjectFile();
+}
+
+bool Linker::ClaimGroup(const std::string& Signature, int Index) {
+  auto It = Groups.find(Signature);
+  if (It == Groups.end())
+    It = Groups.emplace(Signature, LinkGroup{Index}).first;
+  return It->second.Owner == Index;
+}
+
+void Linker::ReadFiles() {
+  LinkPhase Phase{*this, "read"};
+  for (auto& FileName : FileNames) {
+    int Index = static_cast<int>(ObjectFiles.size());
+    // Cached objects are shared between links, so they are always loaded
+    // whole; their dropped members are only left out of the merge.
+    if (Cache)
+      ObjectFiles.push_back(Cache->Get(FileName));
+    else
+      ObjectFiles.push_back(ReadObjectFile(FileName, [this, Index](const std::string& Signature) {
+        return ClaimGroup(Signature, Index);
+      }));
+    for (auto& S : ObjectFiles.back()->Segments)
+      if (!S.Group.empty())
+        ClaimGroup(S.Group, Index);
+  }
+
+  for (auto& OF : ObjectFiles) {
+    Mappings[OF->FileName] = ObjectFileMapping{};
+  }
+}
+
+// The output keeps the defined global symbols, so that a loader can find
+// its entry point, and its imports. Its relocations have all been applied;
+// the ones a loader needs to rebase the image are packed into a trailing
+// .relr segment. A shared library also gets a .gnu.hash segment, and a
+// build-id note goes last.
+ObjectFilePtr Linker::GenerateObjectFile() {
+  if (Relocatable) {
+    LinkPhase Phase{*this, "partial link"};
+    return GenerateRelocatableObjectFile();
+  }
+  {
+    LinkPhase Phase{*this, "symbols"};
+    GenerateOutputFileSymbolTable();
+    CollectImports();
+  }
+  {
+    LinkPhase Phase{*this, "segments"};
+    GenerateOutputFileSegments();
+  }
+  {
+    LinkPhase Phase{*this, "relocations"};
+    ProcessRelocations();
+  }
+  LinkPhase Phase{*this, "output"};
+  ObjectFilePtr OFPtr = std::make_unique<ObjectFile>();
+  std::vector<Segment> Ss;
+  Ss.insert(Ss.end(), RPSegments.begin(), RPSegments.end());
+  Ss.insert(Ss.end(), RWPSegments.begin(), RWPSegments.end());
+  Ss.insert(Ss.end(), RWSegments.begin(), RWSegments.end());
+  if (RelativeRelocationSegment.Length > 0)
+    Ss.push_back(RelativeRelocationSegment);
+  GenerateOutputSymbols(Ss, OFPtr->Symbols);
+  if (Shared)
+    GenerateSymbolHashSegment(Ss, OFPtr->Symbols);
+  if (BuildIdType != BuildIdKind::None)
+    GenerateBuildIdSegment(Ss);
+  OFPtr->FH = FileHeader{
+    "LINK",
+    static_cast<int>(Ss.size()),
+    static_cast<int>(OFPtr->Symbols.size()),
+    0
+  };
+  OFPtr->Segments = std::move(Ss);
+
+  return OFPtr;
+}
+
+// The note is laid out as an ELF note: the name and id sizes, the type
+// NT_GNU_BUILD_ID (3), the name "GNU" and the id.
+void Linker::GenerateBuildIdSegment(std::vector<Segment>& Ss) {
+  size_t IdSize = BuildId::Size(BuildIdType);
+  std::string Note(BuildIdNoteHeaderSize + IdSize, '\0');
+  Note[0] = 4;
+  Note[4] = static_cast<char>(IdSize);
+  Note[8] = 3;
+  std::memcpy(&Note[12], "GNU", 4);
+
+  auto Last = std::max_element(Ss.begin(), Ss.end(), [](const Segment& A, const Segment& B) {
+    return A.Address + A.Length < B.Address + B.Length;
+  });
+  BuildIdSegment.Address = 0;
+  if (Last != Ss.end())
+    BuildIdSegment.Address = ((Last->Address + Last->Length) & ~0xFFF) + 0x1000;
+  BuildIdSegment.Length = static_cast<int>(Note.size());
+  BuildIdSegment.Data.resize(2 * Note.size());
+  WriteHexBytes(&BuildIdSegment.Data[0], Note);
+  Ss.push_back(BuildIdSegment);
+}
+
+std::string Linker::StampBuildId(std::string& Text) const {
+  size_t HexSize = BuildIdSegment.Data.size();
+  if (BuildIdType == BuildIdKind::None || HexSize == 0 || Text.size() < HexSize + 1
+    || Text.compare(Text.size() - HexSize - 1, HexSize, BuildIdSegment.Data) != 0)
+    throw "Output does not end with its build-id note";
+
+  std::string Id = BuildId::Compute(BuildIdType, Text);
+  WriteHexBytes(&Text[Text.size() - 1 - HexSize + 2 * BuildIdNoteHeaderSize], Id);
+  return Id;
+}
+
+void Linker::MergeSegmentsIntoDataStructure() {
+  for (size_t i = 0; i < ObjectFiles.size(); i++) {
+    auto& Segments = ObjectFiles[i]->Segments;
+    for (size_t j = 0; j < Segments.size(); j++) {
+      auto& S = Segments[j];
+      if (!S.Group.empty() && !ClaimGroup(S.Group, static_cast<int>(i))) {
+        auto& G = Groups.find(S.Group)->second;
+        if (G.LastDiscardedBy != static_cast<int>(i)) {
+          G.LastDiscardedBy = static_cast<int>(i);
+          Stats.GroupsDiscarded++;
+        }
+        Stats.SegmentsDiscarded++;
+        Stats.BytesDiscarded += S.Length;
+        continue;
+      }
+      auto& Merged = SegmentDataStructure[S.Permissions][S.Name];
+      Merged.push_back(S);
+      Merged.back().ObjectIndex = static_cast<int>(i);
+      Merged.back().SegmentIndex = static_cast<int>(j);
+    }
+  }
+  Stats.GroupsKept = Groups.size();
+}
+
+bool Linker::SymbolAddress(const std::string& Name, int& Address) {
+  // A strong definition wins over a weak one wherever either comes.
+  for (SymbolType Type : {SymbolType::Defined, SymbolType::Weak})
+    for (size_t ObjectIndex = 0; ObjectIndex < ObjectFiles.size(); ObjectIndex++) {
+      auto& OFPtr = ObjectFiles[ObjectIndex];
+      auto& Symbols = OFPtr->Symbols;
+      for (size_t i = 0; i < Symbols.size(); i++) {
+        if (Symbols.Types[i] != Type || Symbols.Name(i) != Name)
+          continue;
+        if (PlacementBegin.size() == ObjectFiles.size() + 1) {
+          long Placed;
+          if (!InputAddress(ObjectIndex, Symbols.SegmentNumbers[i], Symbols.Values[i], Placed))
+            continue;
+          Address = static_cast<int>(Placed);
+          return true;
+        }
+        int SegmentNumber = Symbols.SegmentNumbers[i];
+        if (SegmentNumber < 1 || SegmentNumber > static_cast<int>(OFPtr->Segments.size()))
+          continue;
+        auto& Defining = OFPtr->Segments[SegmentNumber - 1];
+        auto FileMapping = Mappings.find(Defining.FileName);
+        if (FileMapping == Mappings.end())
+          continue;
+        auto SegmentMapping = FileMapping->second.find(Defining.Name);
+        if (SegmentMapping == FileMapping->second.end())
+          continue;
+        Address = SegmentMapping->second.Start + Symbols.Values[i];
+        return true;
+      }
+    }
+  return false;
+}
+
+void Linker::GenerateOutputFileSymbolTable() {
+  MergeSymbolsIntoOneVector();
+  GatherCommonSymbols();
+  CombineCommonSymbolsIntoCommonSegment();
+}
+
+void Linker::CombineCommonSymbolsIntoCommonSegment() {
+  for (auto Row : CommonSymbols) {
+    CommonOffsets.push_back(CommonSegment.Length);
+    CommonSegment.Length += MergedSymbols.Values[Row];
+  }
+}
+
+void Linker::GatherCommonSymbols() {
+  // A branch-free filter over the type and value columns: every row is
+  // stored, and the count only moves past the common ones.
+  size_t N = MergedSymbols.size();
+  const SymbolType* Types = MergedSymbols.Types.data();
+  const int* Values = MergedSymbols.Values.data();
+  size_t Start = CommonSymbols.size();
+  CommonSymbols.resize(Start + N);
+  uint32_t* Out = CommonSymbols.data() + Start;
+  size_t Count = 0;
+  for (size_t i = 0; i < N; i++) {
+    Out[Count] = static_cast<uint32_t>(i);
+    Count += (Types[i] == SymbolType::Undefined) & (Values[i] != 0);
+  }
+  CommonSymbols.resize(Start + Count);
+}
+
+void Linker::MergeSymbolsIntoOneVector() {
+  size_t Total = MergedSymbols.size();
+  for (auto& OFPtr : ObjectFiles)
+    Total += OFPtr->Symbols.size();
+  MergedSymbols.reserve(Total);
+  for (auto& OFPtr : ObjectFiles) {
+    MergedSymbols.Append(OFPtr->Symbols);
+  }
+}
+
+void Linker::GenerateOutputFileSegments() {
+  MergeSegmentsIntoDataStructure();
+
+  MergeRPSegments();
+  MergeRWPSegments();
+  MergeRWSegments();
+}
+
+void Linker::MergeRPSegments() {
+  MergeSegmentRun(SegmentPermissions::RP, OutSegment{"a.out", ".text", TextAddress, 0x0, "RP"}, RPSegments, nullptr);
+  TextSegment = &RPSegments.front();
+}
+
+void Linker::MergeRWPSegments() {
+  OutSegment First{"a.out", ".data", 0x0, 0x0, "RWP"};
+  InitializeSegmentForNewPage(First, RPSegments.back());
+  MergeSegmentRun(SegmentPermissions::RWP, First, RWPSegments, nullptr);
+  DataSegment = &RWPSegments.front();
+}
+
+void Linker::MergeRWSegments() {
+  OutSegment First{"a.out", ".bss", 0x0, 0x0, "RW"};
+  InitializeSegmentForSamePage(First, RWPSegments.back());
+  MergeSegmentRun(SegmentPermissions::RW, First, RWSegments, &CommonSegment);
+  BSSSegment = &RWSegments.front();
+}
+
+void Linker::MergeSegmentRun(Permissions Code, OutSegment First, std::vector<OutSegment>& Out, const Segment* Extra) {
+  auto& NamesDataStructure = SegmentDataStructure[Code];
+  RunSegments.clear();
+  size_t NumberOfRuns = 0;
+  auto AddRun = [&](OutSegment O) {
+    RunSegments.push_back(std::move(O));
+    if (RunInputs.size() <= NumberOfRuns)
+      RunInputs.emplace_back();
+    RunInputs[NumberOfRuns].clear();
+    return &RunInputs[NumberOfRuns++];
+  };
+
+  auto FirstInputs = AddRun(First);
+  for (auto& S : NamesDataStructure[First.Name])
+    FirstInputs->push_back(&S);
+  if (Code == SegmentPermissions::RP && !Ordering.Empty())
+    Ordering.Order(*FirstInputs, ObjectFiles);
+  if (Extra)
+    FirstInputs->push_back(Extra);
+
+  std::map<int, std::vector<const Segment*>> Mergeable;
+  for (auto& NameVectorPair : NamesDataStructure) {
+    if (NameVectorPair.first == First.Name || NameVectorPair.second.empty())
+      continue;
+    size_t Run = NumberOfRuns;
+    auto Inputs = AddRun(OutSegment{"a.out", NameVectorPair.first, 0x0, 0x0, SegmentPermissionsName(Code)});
+    Mergeable.clear();
+    for (auto& S : NameVectorPair.second) {
+      if (Code == SegmentPermissions::RP && S.Mergeable())
+        Mergeable[S.MergeStrings ? 0 : S.MergeEntrySize].push_back(&S);
+      else
+        Inputs->push_back(&S);
+    }
+
+    // Each kind of mergeable input becomes one input after the others.
+    for (auto& KindInputsPair : Mergeable) {
+      MergedSegments.emplace_back();
+      MergedSegment& M = MergedSegments.back();
+      M.Merge(NameVectorPair.first, KindInputsPair.second, TailMergeStrings);
+      M.OutIndex = Out.size() + Run;
+      M.Position = Inputs->size();
+      Inputs->push_back(&M.Merged);
+      Stats.MergePieces += M.Pieces.size();
+      Stats.UniqueMergePieces += M.UniquePieces;
+      size_t MergedBytes = static_cast<size_t>(M.Merged.Length);
+      Stats.MergeBytesSaved += M.InputBytes > MergedBytes ? M.InputBytes - MergedBytes : 0;
+    }
+  }
+
+  LayoutOutSegments(RunSegments, RunInputs);
+  for (auto& O : RunSegments)
+    Out.push_back(std::move(O));
+}
+
+void Linker::LayoutOutSegments(std::vector<OutSegment>& Outs, const std::vector<std::vector<const Segment*>>& Inputs) {
+  Pieces.clear();
+  OutBegin.clear();
+  PieceOut.clear();
+  for (size_t k = 0; k < Outs.size(); k++) {
+    OutBegin.push_back(Pieces.size());
+    Pieces.insert(Pieces.end(), Inputs[k].begin(), Inputs[k].end());
+    PieceOut.insert(PieceOut.end(), Inputs[k].size(), k);
+  }
+  OutBegin.push_back(Pieces.size());
+  size_t N = Pieces.size();
+
+  // Inputs are placed by a parallel aligned scan. Padding an output to 4
+  // bytes and aligning the next one's first input come to aligning that
+  // input to at least 4.
+  int Base = Outs.front().Address;
+  long Address = ParallelAlignedScan(N, ParallelChunkCount(N), Base, Offsets,
+    [&](size_t i) {
+      size_t k = PieceOut[i];
+      long A = Pieces[i]->Alignment;
+      return k > 0 && i == OutBegin[k] ? std::max(4L, A) : A;
+    },
+    [&](size_t i) { return static_cast<long>(Pieces[i]->Length); });
+
+  // An input's data starts at twice its distance from the output's first
+  // input, plus the hex digits the inputs before it carry beyond two per
+  // byte of Length, which DataExcess sums.
+  DataExcess.resize(N);
+  ParallelFor(N, [&](size_t i) {
+    DataExcess[i] = static_cast<long>(HexDataSize(*Pieces[i])) - 2L * Pieces[i]->Length;
+  });
+  ParallelExclusiveScan(DataExcess);
+
+  Address = Base;
+  for (size_t k = 0; k < Outs.size(); k++) {
+    OutSegment& O = Outs[k];
+    size_t Begin = OutBegin[k];
+    size_t End = OutBegin[k + 1];
+    size_t DataSize = 0;
+    if (Begin < End) {
+      Address = Offsets[End - 1] + Pieces[End - 1]->Length;
+      DataSize = static_cast<size_t>(2 * (Address - Offsets[Begin]) + DataExcess[End] - DataExcess[Begin]);
+      O.Address = static_cast<int>(Offsets[Begin]);
+    } else {
+      O.Address = static_cast<int>(Address);
+    }
+    if (k + 1 < Outs.size()) {
+      long Padded = AlignAddress(Address, 4);
+      DataSize += 2 * static_cast<size_t>(Padded - Address);
+      Address = Padded;
+    }
+    O.Length = static_cast<int>(Address - O.Address);
+    O.Data.assign(DataSize, '0');
+    O.InputSegments.resize(End - Begin);
+    O.ContainedSegments.resize(End - Begin);
+  }
+
+  // Copying the data, and decompressing compressed inputs straight into
+  // their place in the output, costs by the byte, so a few large inputs
+  // are spread over threads too.
+  size_t Chunks = std::min(N, ParallelChunkCount(N + static_cast<size_t>(Address - Base) / 32));
+  ParallelForChunks(N, Chunks, [&](size_t, size_t First, size_t Last) {
+    for (size_t i = First; i < Last; i++) {
+      OutSegment& O = Outs[PieceOut[i]];
+      size_t Begin = OutBegin[PieceOut[i]];
+      O.InputSegments[i - Begin] = *Pieces[i];
+      Segment& ContainedSegment = O.ContainedSegments[i - Begin];
+      ContainedSegment = *Pieces[i];
+      ContainedSegment.Address = static_cast<int>(Offsets[i]);
+      long DataOffset = 2 * (Offsets[i] - Offsets[Begin]) + DataExcess[i] - DataExcess[Begin];
+      WriteHexData(&O.Data[DataOffset], *Pieces[i]);
+    }
+  });
+
+  RecordMappings(Outs);
+}
+
+// Mappings are keyed by file, so each file's entries are written by one
+// thread, in layout order, leaving the last mapping of a name in place just
+// as the serial walk does.
+void Linker::RecordMappings(std::vector<OutSegment>& Outs) {
+  std::map<std::string, std::vector<const Segment*>> ByFile;
+  for (auto& O : Outs)
+    for (auto& C : O.ContainedSegments)
+      ByFile[C.FileName].push_back(&C);
+
+  std::vector<std::pair<ObjectFileMapping*, std::vector<const Segment*>*>> Work;
+  for (auto& FileSegmentsPair : ByFile)
+    Work.emplace_back(&Mappings[FileSegmentsPair.first], &FileSegmentsPair.second);
+
+  ParallelFor(Work.size(), [&](size_t i) {
+    for (auto C : *Work[i].second)
+      (*Work[i].first)[C->Name] = SegmentMapping(C->Name, C->Address, C->Address + C->Length - 1);
+  });
+}
+
+void Linker::InitializeSegmentForSamePage(OutSegment& Next, OutSegment& Previous) {
+  int ModuloFour = Previous.Length % 4;
+  int BlankSpaceSize = (4 - ModuloFour) % 4;
+
+  Previous.Length += BlankSpaceSize;
+  for (int i = 0; i < BlankSpaceSize; i++)
+    Previous.Data += "00";
+  Next.Address = Previous.Address + Previous.Length;
+}
+
+void Linker::InitializeSegmentForNewPage(OutSegment& Next, OutSegment& Previous) {
+  Next.Address = ((Previous.Address + Previous.Length) & ~0xFFF) + 0x1000;
+}
+
+void Linker::AppendTextSegment(Segment S) {
+  AppendSegmentToOutSegment(S, *TextSegment);
+}
+void Linker::AppendDataSegment(Segment S) {
+  AppendSegmentToOutSegment(S, *DataSegment);
+}
+void Linker::AppendBSSSegment(Segment S) {
+  AppendSegmentToOutSegment(S, *BSSSegment);
+}
+
+void Linker::AppendSegmentToOutSegment(Segment S, OutSegment& O) {
+  O.InputSegments.push_back(S);
+  Segment ContainedSegment = S;
+
+  long End = O.Address + O.Length;
+  int BlankSpaceSize = static_cast<int>(AlignAddress(End, S.Alignment) - End);
+  ContainedSegment.Address = O.Address + O.Length + BlankSpaceSize;
+  O.Length += BlankSpaceSize + ContainedSegment.Length;
+  for (int i = 0; i < BlankSpaceSize; i++)
+    O.Data += "00";
+  size_t Start = O.Data.size();
+  O.Data.resize(Start + HexDataSize(ContainedSegment));
+  WriteHexData(&O.Data[Start], ContainedSegment);
+
+  O.ContainedSegments.push_back(ContainedSegment);
+
+  Mappings[S.FileName][S.Name] = SegmentMapping(S.Name, ContainedSegment.Address, ContainedSegment.Address + ContainedSegment.Length -1);
+}
+}
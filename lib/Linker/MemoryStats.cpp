@@ -0,0 +1,191 @@
+#include <Linker/Linker.h>
+
+#include <algorithm>
+#include <atomic>
+
+namespace ldl {
+
+namespace {
+std::atomic<int> Counting{0};
+std::atomic<uint64_t> Allocations{0};
+std::atomic<uint64_t> AllocatedBytes{0};
+std::atomic<int64_t> LiveBytes{0};
+std::atomic<int64_t> PeakBytes{0};
+
+size_t SegmentHeapBytes(const Segment& S) {
+  return StringHeapBytes(S.FileName) + StringHeapBytes(S.Name) + StringHeapBytes(S.Code)
+    + StringHeapBytes(S.Group) + StringHeapBytes(S.Data) + StringHeapBytes(S.CompressedData);
+}
+
+size_t SegmentsBytes(const std::vector<Segment>& Ss) {
+  size_t Bytes = VectorBytes(Ss);
+  for (auto& S : Ss)
+    Bytes += SegmentHeapBytes(S);
+  return Bytes;
+}
+
+size_t UnknownTypesBytes(const UnknownTypeSpellings& Spellings) {
+  size_t Bytes = VectorBytes(Spellings);
+  for (auto& Spelling : Spellings)
+    Bytes += StringHeapBytes(Spelling.second);
+  return Bytes;
+}
+
+size_t TableBytes(const SymbolTable& T) {
+  return StringHeapBytes(T.NamePool) + VectorBytes(T.NameOffsets) + VectorBytes(T.NameLengths)
+    + VectorBytes(T.Values) + VectorBytes(T.SegmentNumbers) + VectorBytes(T.Types)
+    + UnknownTypesBytes(T.UnknownTypes);
+}
+
+size_t TableBytes(const RelocationTable& T) {
+  return VectorBytes(T.Locations) + VectorBytes(T.SegmentNumbers) + VectorBytes(T.Refs)
+    + VectorBytes(T.Addends) + VectorBytes(T.Types) + UnknownTypesBytes(T.UnknownTypes);
+}
+}
+
+void AllocationCounter::Enable(bool On) {
+  Counting.fetch_add(On ? 1 : -1, std::memory_order_relaxed);
+}
+
+bool AllocationCounter::Enabled() {
+  return Counting.load(std::memory_order_relaxed) > 0;
+}
+
+void AllocationCounter::Allocated(size_t Size) {
+  int64_t Bytes = static_cast<int64_t>(Size);
+  Allocations.fetch_add(1, std::memory_order_relaxed);
+  AllocatedBytes.fetch_add(static_cast<uint64_t>(Bytes), std::memory_order_relaxed);
+  int64_t Live = LiveBytes.fetch_add(Bytes, std::memory_order_relaxed) + Bytes;
+  int64_t Peak = PeakBytes.load(std::memory_order_relaxed);
+  while (Live > Peak && !PeakBytes.compare_exchange_weak(Peak, Live, std::memory_order_relaxed))
+    ;
+}
+
+void AllocationCounter::Freed(size_t Size) {
+  LiveBytes.fetch_sub(static_cast<int64_t>(Size), std::memory_order_relaxed);
+}
+
+AllocationCounter::Snapshot AllocationCounter::Now() {
+  Snapshot S;
+  S.Allocations = Allocations.load(std::memory_order_relaxed);
+  S.Bytes = AllocatedBytes.load(std::memory_order_relaxed);
+  S.Live = LiveBytes.load(std::memory_order_relaxed);
+  S.Peak = PeakBytes.load(std::memory_order_relaxed);
+  return S;
+}
+
+void AllocationCounter::ResetPeak() {
+  PeakBytes.store(LiveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void MemoryStats::Clear() {
+  Phases.clear();
+  Structures.clear();
+}
+
+void MemoryStats::Record(const std::string& Name, size_t Bytes) {
+  auto It = std::find_if(Structures.begin(), Structures.end(), [&](const StructureMemory& S) {
+    return S.Name == Name;
+  });
+  if (It == Structures.end())
+    It = Structures.insert(Structures.end(), StructureMemory{Name});
+  It->Bytes = Bytes;
+  It->HighWater = std::max(It->HighWater, Bytes);
+}
+
+const StructureMemory* MemoryStats::Structure(const std::string& Name) const {
+  for (auto& S : Structures)
+    if (S.Name == Name)
+      return &S;
+  return nullptr;
+}
+
+const PhaseStats* MemoryStats::Phase(const std::string& Name) const {
+  for (auto& P : Phases)
+    if (P.Name == Name)
+      return &P;
+  return nullptr;
+}
+
+// Cached object files are shared with other links but still counted here,
+// since this link keeps them alive.
+void Linker::MeasureStructures() {
+  size_t ObjectFileBytes = VectorBytes(ObjectFiles);
+  for (auto& OF : ObjectFiles)
+    ObjectFileBytes += sizeof(ObjectFile) + StringHeapBytes(OF->FileName) + SegmentsBytes(OF->Segments)
+      + TableBytes(OF->Symbols) + TableBytes(OF->Relocations);
+  Memory.Record("ObjectFiles", ObjectFileBytes);
+
+  Memory.Record("MergedSymbols", TableBytes(MergedSymbols) + TableBytes(MergedRelocation)
+    + VectorBytes(CommonSymbols) + VectorBytes(CommonOffsets));
+
+  size_t DataStructureBytes = 0;
+  for (auto& CodeNamesPair : SegmentDataStructure)
+    for (auto& NameVectorPair : CodeNamesPair.second)
+      DataStructureBytes += SegmentsBytes(NameVectorPair.second);
+  Memory.Record("SegmentDataStructure", DataStructureBytes);
+
+  size_t InputBytes = 0;
+  size_t ContainedBytes = 0;
+  size_t DataBytes = SegmentHeapBytes(CommonSegment) + SegmentHeapBytes(RelativeRelocationSegment)
+    + SegmentHeapBytes(SymbolHashSegment) + SegmentHeapBytes(BuildIdSegment);
+  for (auto* Outs : {&RPSegments, &RWPSegments, &RWSegments}) {
+    DataBytes += VectorBytes(*Outs);
+    for (auto& O : *Outs) {
+      InputBytes += SegmentsBytes(O.InputSegments);
+      ContainedBytes += SegmentsBytes(O.ContainedSegments);
+      DataBytes += SegmentHeapBytes(O);
+    }
+  }
+  Memory.Record("InputSegments", InputBytes);
+  Memory.Record("ContainedSegments", ContainedBytes);
+  Memory.Record("Data", DataBytes);
+
+  size_t MergedBytes = 0;
+  for (auto& M : MergedSegments)
+    MergedBytes += sizeof(MergedSegment) + SegmentHeapBytes(M.Merged) + VectorBytes(M.Inputs)
+      + VectorBytes(M.PieceBegin) + VectorBytes(M.Pieces);
+  Memory.Record("MergedSegments", MergedBytes);
+
+  Memory.Record("Placements", VectorBytes(PlacementBegin) + VectorBytes(Placements) + GlobalSymbols.Bytes());
+}
+
+void PrintPhaseStats(const PhaseStats& P, std::ostream& OS) {
+  OS << P.Name << ": " << std::chrono::duration<double, std::milli>(P.Time).count() << " ms, "
+     << P.Allocations << " allocations, " << P.Bytes << " bytes allocated, "
+     << P.LiveBytes << " bytes live, peak " << P.PeakBytes << " bytes";
+}
+
+LinkPhase::LinkPhase(Linker& L, const char* Name) :L{L}, Name{Name} {
+  if (!L.Memory.Enabled)
+    return;
+  AllocationCounter::ResetPeak();
+  Start = AllocationCounter::Now();
+  Began = std::chrono::steady_clock::now();
+}
+
+LinkPhase::~LinkPhase() {
+  if (!L.Memory.Enabled)
+    return;
+  auto Ended = std::chrono::steady_clock::now();
+  AllocationCounter::Snapshot End = AllocationCounter::Now();
+  PhaseStats P;
+  P.Name = Name;
+  P.Time = Ended - Began;
+  P.Allocations = End.Allocations - Start.Allocations;
+  P.Bytes = End.Bytes - Start.Bytes;
+  P.LiveBytes = End.Live;
+  P.PeakBytes = End.Peak;
+  L.MeasureStructures();
+  L.Memory.Phases.push_back(P);
+
+  if (std::ostream* Trace = L.Memory.Trace) {
+    *Trace << "trace: ";
+    PrintPhaseStats(P, *Trace);
+    *Trace << std::endl;
+    for (auto& S : L.Memory.Structures)
+      *Trace << "trace:   " << S.Name << " " << S.Bytes << " bytes" << std::endl;
+  }
+}
+}
+
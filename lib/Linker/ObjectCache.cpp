@@ -0,0 +1,130 @@
+#include <Linker/ObjectCache.h>
+
+#include <climits>
+#include <cstdlib>
+#include <iterator>
+#include <sys/stat.h>
+
+#include <ElfReader/MappedFile.h>
+
+namespace ldl {
+
+SharedObjectFilePtr ObjectCache::Get(const std::string& FileName) {
+  char Resolved[PATH_MAX];
+  std::string Key = realpath(FileName.c_str(), Resolved) ? Resolved : FileName;
+
+  struct stat ST;
+  if (stat(Key.c_str(), &ST) != 0) {
+    std::lock_guard<std::mutex> Guard{Lock};
+    auto It = Entries.find(Key);
+    if (It != Entries.end()) {
+      Erase(It);
+      Evictions++;
+    }
+    throw "Could not stat cached object file";
+  }
+  int64_t ModificationTime = static_cast<int64_t>(ST.st_mtim.tv_sec) * 1000000000 + ST.st_mtim.tv_nsec;
+  int64_t Size = static_cast<int64_t>(ST.st_size);
+
+  // Hashing and parsing happen unlocked, so that one large file does not
+  // hold up links that only need entries already cached.
+  bool Cached = false;
+  Entry Previous;
+  {
+    std::lock_guard<std::mutex> Guard{Lock};
+    auto It = Entries.find(Key);
+    if (It != Entries.end()) {
+      Entry& E = It->second;
+      if (E.ModificationTime == ModificationTime && E.Size == Size) {
+        Hits++;
+        Recent.splice(Recent.begin(), Recent, E.Use);
+        return E.ObjectFile;
+      }
+      Cached = true;
+      Previous = E;
+    }
+  }
+
+  uint64_t Hash = HashFile(Key);
+  if (Cached && Previous.Size == Size && Previous.Hash == Hash) {
+    Previous.ModificationTime = ModificationTime;
+    std::lock_guard<std::mutex> Guard{Lock};
+    Store(Key, Previous);
+    HashHits++;
+    return Previous.ObjectFile;
+  }
+
+  Entry E;
+  E.ModificationTime = ModificationTime;
+  E.Size = Size;
+  E.Hash = Hash;
+  E.ObjectFile = ReadObjectFile(Key);
+  std::lock_guard<std::mutex> Guard{Lock};
+  Misses++;
+  Store(Key, E);
+  return E.ObjectFile;
+}
+
+// The entry just stored is kept even over budget: the link that asked for
+// it is about to use it.
+void ObjectCache::Store(const std::string& Key, Entry E) {
+  auto It = Entries.find(Key);
+  if (It != Entries.end())
+    Erase(It);
+  Recent.push_front(Key);
+  E.Use = Recent.begin();
+  TotalBytes += E.Size;
+  Entries.emplace(Key, E);
+  while (TotalBytes > MaxBytes && Recent.size() > 1) {
+    Erase(Entries.find(Recent.back()));
+    Evictions++;
+  }
+}
+
+void ObjectCache::Erase(std::map<std::string, Entry>::iterator It) {
+  TotalBytes -= It->second.Size;
+  Recent.erase(It->second.Use);
+  Entries.erase(It);
+}
+
+void ObjectCache::Prune() {
+  std::lock_guard<std::mutex> Guard{Lock};
+  for (auto It = Entries.begin(); It != Entries.end();) {
+    auto Next = std::next(It);
+    struct stat ST;
+    if (stat(It->first.c_str(), &ST) != 0) {
+      Erase(It);
+      Evictions++;
+    }
+    It = Next;
+  }
+}
+
+void ObjectCache::Clear() {
+  std::lock_guard<std::mutex> Guard{Lock};
+  Entries.clear();
+  Recent.clear();
+  TotalBytes = 0;
+}
+
+size_t ObjectCache::Size() {
+  std::lock_guard<std::mutex> Guard{Lock};
+  return Entries.size();
+}
+
+int64_t ObjectCache::Bytes() {
+  std::lock_guard<std::mutex> Guard{Lock};
+  return TotalBytes;
+}
+
+// FNV-1a over the whole file.
+uint64_t ObjectCache::HashFile(const std::string& FileName) {
+  MappedFile MF{FileName};
+  uint64_t Hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < MF.Size; i++) {
+    Hash ^= MF.Bytes[i];
+    Hash *= 0x100000001b3ULL;
+  }
+  return Hash;
+}
+}
@@ -0,0 +1,183 @@
+#include <Linker/Linker.h>
+
+#include <algorithm>
+#include <map>
+
+namespace ldl {
+
+namespace {
+// Where a partial link put an input segment: its output segment (1-based,
+// 0 if it was dropped with its link-once group), its offset there, and the
+// amount to add to addresses computed relative to the input's Address.
+// Size is the part of the input that relocations may patch.
+class PartialPlacement {
+public:
+  int Segment = 0;
+  int Offset = 0;
+  int Shift = 0;
+  int Size = 0;
+};
+
+bool IsOffsetSymbol(SymbolType Type) {
+  return IsGlobalDefinition(Type) || Type == SymbolType::Local || Type == SymbolType::Section;
+}
+}
+
+// A run of inputs can only grow while its data covers its whole length, so
+// that every input's data starts at twice its offset in the hex. A run is
+// as aligned as its first input and only takes inputs aligned no more
+// strictly, so offsets aligned within the run stay aligned wherever the
+// final link puts it, and the first input moves no more than it would have.
+// A segment that does not join the run of its name ends it, which keeps the
+// inputs of each name in their original order.
+ObjectFilePtr Linker::GenerateRelocatableObjectFile() {
+  ObjectFilePtr OFPtr = std::make_unique<ObjectFile>();
+  std::vector<Segment>& Ss = OFPtr->Segments;
+  std::vector<std::vector<PartialPlacement>> Placed(ObjectFiles.size());
+  std::map<std::pair<SegmentPermissions, std::string>, size_t> OpenRuns;
+
+  for (size_t i = 0; i < ObjectFiles.size(); i++) {
+    auto& Segments = ObjectFiles[i]->Segments;
+    Placed[i].resize(Segments.size());
+    for (size_t j = 0; j < Segments.size(); j++) {
+      const Segment& S = Segments[j];
+      PartialPlacement& P = Placed[i][j];
+      if (!S.Group.empty() && !ClaimGroup(S.Group, static_cast<int>(i))) {
+        Stats.SegmentsDiscarded++;
+        Stats.BytesDiscarded += S.Length;
+        continue;
+      }
+      P.Size = std::min(S.Length, static_cast<int>(HexDataSize(S) / 2));
+
+      // The final link reorders .text inputs when it has an ordering, so
+      // they stay apart.
+      bool Joinable = S.Group.empty() && !S.Mergeable() && S.Permissions != SegmentPermissions::Unknown
+        && !(S.Permissions == SegmentPermissions::RP && S.Name == ".text" && !Ordering.Empty());
+      auto Key = std::make_pair(S.Permissions, S.Name);
+      auto Run = OpenRuns.find(Key);
+      if (Joinable && Run != OpenRuns.end() && S.Alignment <= Ss[Run->second].Alignment) {
+        Segment& R = Ss[Run->second];
+        int Aligned = static_cast<int>(AlignAddress(R.Length, S.Alignment));
+        R.Data.append(2 * static_cast<size_t>(Aligned - R.Length), '0');
+        size_t Start = R.Data.size();
+        R.Data.resize(Start + HexDataSize(S));
+        WriteHexData(&R.Data[Start], S);
+        R.Length = Aligned + S.Length;
+        P.Segment = static_cast<int>(Run->second + 1);
+        P.Offset = Aligned;
+        P.Shift = Aligned + R.Address - S.Address;
+        if (HexDataSize(R) != 2 * static_cast<size_t>(R.Length))
+          OpenRuns.erase(Run);
+        continue;
+      }
+
+      Segment Copy{"a.out", S.Name, S.Address, S.Length, S.Code};
+      Copy.Group = S.Group;
+      Copy.MergeStrings = S.MergeStrings;
+      Copy.MergeEntrySize = S.MergeEntrySize;
+      Copy.Alignment = S.Alignment;
+      Copy.Data.resize(HexDataSize(S));
+      if (!Copy.Data.empty())
+        WriteHexData(&Copy.Data[0], S);
+      Ss.push_back(std::move(Copy));
+      P.Segment = static_cast<int>(Ss.size());
+      if (Joinable && HexDataSize(S) == 2 * static_cast<size_t>(S.Length))
+        OpenRuns[Key] = Ss.size() - 1;
+      else
+        OpenRuns.erase(Key);
+    }
+  }
+
+  auto Placement = [&](size_t i, int SegmentNumber) -> const PartialPlacement* {
+    if (SegmentNumber < 1 || static_cast<size_t>(SegmentNumber) > Placed[i].size()
+      || Placed[i][SegmentNumber - 1].Segment == 0)
+      return nullptr;
+    return &Placed[i][SegmentNumber - 1];
+  };
+
+  // Symbols keep their rows, so relocations only move by the rows of the
+  // objects before theirs. A symbol in a dropped segment is left without a
+  // segment, which makes the final link look its name up, as it would.
+  SymbolTable& Symbols = OFPtr->Symbols;
+  std::vector<size_t> FirstSymbol;
+  for (size_t i = 0; i < ObjectFiles.size(); i++) {
+    size_t First = Symbols.size();
+    FirstSymbol.push_back(First);
+    Symbols.Append(ObjectFiles[i]->Symbols);
+    for (size_t Row = First; Row < Symbols.size(); Row++) {
+      const PartialPlacement* P = Placement(i, Symbols.SegmentNumbers[Row]);
+      Symbols.SegmentNumbers[Row] = P ? P->Segment : 0;
+      if (P && IsOffsetSymbol(Symbols.Types[Row]))
+        Symbols.Values[Row] += P->Offset;
+    }
+  }
+
+  // A section symbol plus an addend names a byte of a mergeable segment
+  // that the final link looks up before adding anything, but section
+  // symbols read back as local ones, which add the addend afterwards. Such
+  // references get a local symbol at the byte itself instead.
+  std::map<std::pair<size_t, long>, int> ByteSymbols;
+  auto ByteSymbol = [&](size_t Row, int Addend) {
+    auto It = ByteSymbols.find({Row, Addend});
+    if (It != ByteSymbols.end())
+      return It->second;
+    std::string Name{Symbols.Name(Row)};
+    Symbols.Add(Name, Symbols.Values[Row] + Addend, Symbols.SegmentNumbers[Row], SymbolType::Local);
+    int Ref = static_cast<int>(Symbols.size());
+    ByteSymbols.emplace(std::make_pair(Row, Addend), Ref);
+    return Ref;
+  };
+
+  // Every relocation is kept, so that the final link sees the same
+  // references. One the final link would reject gets no segment.
+  RelocationTable& Relocations = OFPtr->Relocations;
+  for (size_t i = 0; i < ObjectFiles.size(); i++) {
+    size_t First = Relocations.size();
+    size_t NumberOfSymbols = ObjectFiles[i]->Symbols.size();
+    Relocations.Append(ObjectFiles[i]->Relocations);
+    for (size_t r = First; r < Relocations.size(); r++) {
+      RelocationType Type = Relocations.Types[r];
+      int Width = Type == RelocationType::AS8 ? 8 : 4;
+      int Location = Relocations.Locations[r];
+      const PartialPlacement* P = Placement(i, Relocations.SegmentNumbers[r]);
+      if (P && (Location < 0 || Location + Width > P->Size))
+        P = nullptr;
+      Relocations.SegmentNumbers[r] = P ? P->Segment : 0;
+      if (P)
+        Relocations.Locations[r] += P->Offset;
+
+      int& Ref = Relocations.Refs[r];
+      int& Addend = Relocations.Addends[r];
+      if (Type == RelocationType::A4 || Type == RelocationType::R4) {
+        const PartialPlacement* Target = Placement(i, Ref);
+        Ref = Target ? Target->Segment : 0;
+        if (Target)
+          Addend += Target->Shift;
+        if (Type == RelocationType::R4 && P)
+          Addend -= P->Shift;
+      } else if (Type != RelocationType::Unknown) {
+        if (Ref < 1 || static_cast<size_t>(Ref) > NumberOfSymbols) {
+          Ref = 0;
+          continue;
+        }
+        size_t Row = FirstSymbol[i] + Ref - 1;
+        Ref = static_cast<int>(Row + 1);
+        int SegmentNumber = Symbols.SegmentNumbers[Row];
+        if (Symbols.Types[Row] == SymbolType::Section && Addend != 0 && SegmentNumber > 0
+          && Ss[SegmentNumber - 1].Mergeable() && Ss[SegmentNumber - 1].Permissions == SegmentPermissions::RP) {
+          Ref = ByteSymbol(Row, Addend);
+          Addend = 0;
+        }
+      }
+    }
+  }
+
+  OFPtr->FH = FileHeader{
+    "LINK",
+    static_cast<int>(Ss.size()),
+    static_cast<int>(Symbols.size()),
+    static_cast<int>(Relocations.size())
+  };
+  return OFPtr;
+}
+}
@@ -0,0 +1,364 @@
+#include <Linker/Linker.h>
+
+#include <algorithm>
+#include <climits>
+
+#include <Linker/Parallel.h>
+#include <Linker/RelativeRelocations.h>
+
+namespace ldl {
+
+namespace {
+uint64_t ReadHexWord(const char* Hex, int Width) {
+  uint64_t Value = 0;
+  for (int i = Width - 1; i >= 0; i--)
+    Value = Value << 8 | static_cast<uint64_t>(HexDigitValue(Hex[2 * i]) << 4 | HexDigitValue(Hex[2 * i + 1]));
+  return Value;
+}
+
+// Whether a 4-byte word holding Old fits Old + Value: as an unsigned word
+// for absolute addresses, and a signed one for displacements and words the
+// processor sign-extends.
+bool FitsWord(RelocationType Type, uint64_t Old, long Value) {
+  bool Signed = Type == RelocationType::R4 || Type == RelocationType::RS4 || Type == RelocationType::AS4S;
+  int64_t Result = Value + (Signed ? static_cast<int64_t>(static_cast<int32_t>(Old)) : static_cast<int64_t>(Old));
+  if (Signed)
+    return Result >= INT32_MIN && Result <= INT32_MAX;
+  return Result >= 0 && Result <= static_cast<int64_t>(UINT32_MAX);
+}
+
+void WriteHexWord(char* Hex, int Width, uint64_t Value) {
+  static const char Digits[] = "0123456789abcdef";
+  for (int i = 0; i < Width; i++) {
+    unsigned B = static_cast<unsigned>(Value >> (8 * i)) & 0xff;
+    Hex[2 * i] = Digits[B >> 4];
+    Hex[2 * i + 1] = Digits[B & 0xf];
+  }
+}
+}
+
+// Relocation semantics follow POF, with RELA addends added on top:
+//   A4   the word at Location holds an address in segment Ref; it moves by
+//        as much as that segment moved.
+//   R4   the word holds a displacement from the relocated segment to
+//        segment Ref; it changes by the difference of their moves. When
+//        Ref was merged, the byte it points at moves with its piece.
+//   AS4  the word gets the address of symbol Ref added to it; AS8 likewise
+//        for a doubleword. AS4S likewise, for a sign-extended word.
+//   RS4  the word gets the displacement from itself to symbol Ref.
+void Linker::ProcessRelocations() {
+  PlaceInputSegments();
+  DefineGlobalSymbols();
+
+  size_t NumberOfObjects = ObjectFiles.size();
+  std::vector<RelocationResults> Results(NumberOfObjects);
+  ParallelFor(NumberOfObjects, [&](size_t i) {
+    ApplyRelocations(i, Results[i]);
+  });
+
+  for (auto& R : Results) {
+    Stats.RelocationsApplied += R.Counts.RelocationsApplied;
+    Stats.RelocationsUndefined += R.Counts.RelocationsUndefined;
+    Stats.RelocationsInvalid += R.Counts.RelocationsInvalid;
+    Stats.RelocationsOverflowed += R.Counts.RelocationsOverflowed;
+    Stats.RelocationsIntoMerged += R.Counts.RelocationsIntoMerged;
+    UndefinedSymbols.insert(UndefinedSymbols.end(), R.Undefined.begin(), R.Undefined.end());
+    AbsoluteWords.insert(AbsoluteWords.end(), R.AbsoluteWords.begin(), R.AbsoluteWords.end());
+    AbsoluteDoublewords.insert(AbsoluteDoublewords.end(), R.AbsoluteDoublewords.begin(), R.AbsoluteDoublewords.end());
+  }
+  std::sort(UndefinedSymbols.begin(), UndefinedSymbols.end());
+  UndefinedSymbols.erase(std::unique(UndefinedSymbols.begin(), UndefinedSymbols.end()), UndefinedSymbols.end());
+  std::sort(AbsoluteWords.begin(), AbsoluteWords.end());
+  std::sort(AbsoluteDoublewords.begin(), AbsoluteDoublewords.end());
+  GenerateRelativeRelocationSegment();
+  RelocationsProcessed = true;
+}
+
+// The packed slots go on a page of their own after the rest of the image,
+// so that a loader can drop them once it has applied them.
+void Linker::GenerateRelativeRelocationSegment() {
+  RelativeRelocationSegment.Length = 0;
+  RelativeRelocationSegment.Data.clear();
+  if (AbsoluteWords.empty() && AbsoluteDoublewords.empty())
+    return;
+
+  OutSegment* Last = nullptr;
+  for (auto Outs : {&RPSegments, &RWPSegments, &RWSegments})
+    for (auto& O : *Outs)
+      if (Last == nullptr || O.Address + O.Length > Last->Address + Last->Length)
+        Last = &O;
+  if (Last)
+    InitializeSegmentForNewPage(RelativeRelocationSegment, *Last);
+
+  std::string Bytes = RelativeRelocations::Pack(AbsoluteWords, AbsoluteDoublewords);
+  RelativeRelocationSegment.Length = static_cast<int>(Bytes.size());
+  RelativeRelocationSegment.Data.resize(2 * Bytes.size());
+  WriteHexBytes(&RelativeRelocationSegment.Data[0], Bytes);
+}
+
+// Imports come first, naming their .got slots, then the definitions in
+// address order.
+void Linker::GenerateOutputSymbols(const std::vector<Segment>& Ss, SymbolTable& Symbols) const {
+  auto AddSymbol = [&](std::string_view Name, long Address, SymbolType Type) {
+    for (size_t i = 0; i < Ss.size(); i++) {
+      const Segment& S = Ss[i];
+      if (Address >= S.Address && Address <= S.Address + static_cast<long>(S.Length)) {
+        Symbols.Add(Name, static_cast<int>(Address - S.Address), static_cast<int>(i + 1), Type);
+        return;
+      }
+    }
+  };
+
+  for (size_t i = 0; i < Imports.size(); i++) {
+    long Slot;
+    if (InputAddress(ImportObjectIndex, 2, 8 * static_cast<long>(ReservedGOTSlots + i), Slot))
+      AddSymbol(Imports[i], Slot, SymbolType::Import);
+  }
+
+  std::vector<std::pair<long, std::string_view>> Defined;
+  for (auto& NameAddress : GlobalSymbols)
+    Defined.emplace_back(NameAddress.second, NameAddress.first);
+  std::sort(Defined.begin(), Defined.end(), [](const auto& A, const auto& B) {
+    return A.first != B.first ? A.first < B.first : A.second < B.second;
+  });
+  for (auto& AddressName : Defined)
+    AddSymbol(AddressName.second, AddressName.first, SymbolType::Defined);
+}
+
+void Linker::PlaceInputSegments() {
+  PlacementBegin.assign(1, 0);
+  for (auto& OFPtr : ObjectFiles)
+    PlacementBegin.push_back(PlacementBegin.back() + OFPtr->Segments.size());
+  Placements.assign(PlacementBegin.back(), InputPlacement{});
+
+  // Walk the layout again to find where each input's data starts: after
+  // the data before it and the padding up to its address.
+  for (auto Outs : {&RPSegments, &RWPSegments, &RWSegments}) {
+    for (auto& O : *Outs) {
+      size_t HexOffset = 0;
+      long End = O.Address;
+      for (auto& C : O.ContainedSegments) {
+        HexOffset += 2 * static_cast<size_t>(C.Address - End);
+        End = C.Address + C.Length;
+        if (C.ObjectIndex >= 0) {
+          InputPlacement& Place = Placements[PlacementBegin[C.ObjectIndex] + C.SegmentIndex];
+          Place.Out = &O;
+          Place.Address = C.Address;
+          Place.HexOffset = HexOffset;
+          Place.Size = std::min<long>(C.Length, static_cast<long>(HexDataSize(C) / 2));
+        }
+        HexOffset += HexDataSize(C);
+      }
+    }
+  }
+
+  for (size_t k = 0; k < MergedSegments.size(); k++) {
+    MergedSegment& M = MergedSegments[k];
+    OutSegment& O = RPSegments[M.OutIndex];
+    M.Address = O.ContainedSegments[M.Position].Address;
+    for (size_t i = 0; i < M.Inputs.size(); i++) {
+      const Segment& S = *M.Inputs[i];
+      InputPlacement& Place = Placements[PlacementBegin[S.ObjectIndex] + S.SegmentIndex];
+      Place.Out = &O;
+      Place.Merged = static_cast<int>(k);
+      Place.MergedInput = i;
+    }
+  }
+}
+
+// The first definition of a name wins; weak definitions only fill in names
+// that no strong one defines, and common symbols names that nothing defines.
+// A second strong definition is a duplicate unless either is in a link-once
+// group, whose copies are meant to stand in for each other.
+void Linker::DefineGlobalSymbols() {
+  auto InGroup = [&](size_t i, size_t Row) {
+    int SegmentNumber = ObjectFiles[i]->Symbols.SegmentNumbers[Row];
+    return !ObjectFiles[i]->Segments[SegmentNumber - 1].Group.empty();
+  };
+  // Only asked of names already defined, so the search finds the first.
+  auto FirstDefinitionInGroup = [&](std::string_view Name) {
+    for (size_t i = 0; i < ObjectFiles.size(); i++) {
+      auto& Symbols = ObjectFiles[i]->Symbols;
+      long Address;
+      for (size_t Row = 0; Row < Symbols.size(); Row++)
+        if (Symbols.Types[Row] == SymbolType::Defined && Symbols.Name(Row) == Name
+          && InputAddress(i, Symbols.SegmentNumbers[Row], Symbols.Values[Row], Address))
+          return InGroup(i, Row);
+    }
+    return false;
+  };
+
+  // Sized for every definition up front, so that no name allocates.
+  size_t Definitions = CommonSymbols.size();
+  for (auto& OF : ObjectFiles)
+    Definitions += std::count_if(OF->Symbols.Types.begin(), OF->Symbols.Types.end(), IsGlobalDefinition);
+  GlobalSymbols.reserve(Definitions);
+
+  for (SymbolType Type : {SymbolType::Defined, SymbolType::Weak})
+    for (size_t i = 0; i < ObjectFiles.size(); i++) {
+      auto& Symbols = ObjectFiles[i]->Symbols;
+      for (size_t Row = 0; Row < Symbols.size(); Row++) {
+        if (Symbols.Types[Row] != Type)
+          continue;
+        long Address;
+        if (!InputAddress(i, Symbols.SegmentNumbers[Row], Symbols.Values[Row], Address))
+          continue;
+        std::string_view Name = Symbols.Name(Row);
+        if (!GlobalSymbols.Add(Name, Address) && Type == SymbolType::Defined && !InGroup(i, Row)
+          && !FirstDefinitionInGroup(Name))
+          DuplicateSymbols.emplace_back(Name);
+      }
+    }
+  std::sort(DuplicateSymbols.begin(), DuplicateSymbols.end());
+  DuplicateSymbols.erase(std::unique(DuplicateSymbols.begin(), DuplicateSymbols.end()), DuplicateSymbols.end());
+
+  if (BSSSegment == nullptr || BSSSegment->ContainedSegments.empty())
+    return;
+  long CommonAddress = BSSSegment->ContainedSegments.back().Address;
+  for (size_t k = 0; k < CommonSymbols.size() && k < CommonOffsets.size(); k++)
+    GlobalSymbols.Add(MergedSymbols.Name(CommonSymbols[k]), CommonAddress + CommonOffsets[k]);
+}
+
+bool Linker::InputAddress(size_t ObjectIndex, int SegmentNumber, long Offset, long& Address) const {
+  if (SegmentNumber < 1 || SegmentNumber > static_cast<int>(ObjectFiles[ObjectIndex]->Segments.size()))
+    return false;
+  const InputPlacement& Place = Placements[PlacementBegin[ObjectIndex] + SegmentNumber - 1];
+  if (Place.Out == nullptr)
+    return false;
+  if (Place.Merged < 0) {
+    Address = Place.Address + Offset;
+    return true;
+  }
+  const MergedSegment& M = MergedSegments[Place.Merged];
+  int MergedOffset = M.OutputOffset(Place.MergedInput, static_cast<int>(Offset));
+  if (MergedOffset < 0)
+    return false;
+  Address = M.Address + MergedOffset;
+  return true;
+}
+
+// A reference to a section symbol plus an addend names a byte of that
+// section, which matters when the section was merged: the addend is folded
+// into the offset before the lookup. A weak definition stands only if no
+// strong one replaced it, and a weak reference nothing defines is 0.
+bool Linker::SymbolTarget(size_t ObjectIndex, size_t Row, long& Addend, long& Target) const {
+  auto& Symbols = ObjectFiles[ObjectIndex]->Symbols;
+  SymbolType Type = Symbols.Types[Row];
+  if (Type == SymbolType::Weak && GlobalSymbols.Find(Symbols.Name(Row), Target))
+    return true;
+  if (Type == SymbolType::Local || Type == SymbolType::Section || IsGlobalDefinition(Type)) {
+    long Offset = Symbols.Values[Row];
+    if (Type == SymbolType::Section) {
+      Offset += Addend;
+      if (InputAddress(ObjectIndex, Symbols.SegmentNumbers[Row], Offset, Target)) {
+        Addend = 0;
+        return true;
+      }
+      return false;
+    }
+    if (InputAddress(ObjectIndex, Symbols.SegmentNumbers[Row], Offset, Target))
+      return true;
+    if (!IsGlobalDefinition(Type))
+      return false;
+  }
+
+  // Undefined here, or defined in a link-once copy that was dropped.
+  if (GlobalSymbols.Find(Symbols.Name(Row), Target))
+    return true;
+  auto Import = ImportIndex.find(Symbols.Name(Row));
+  if (Import == ImportIndex.end()) {
+    Target = 0;
+    return Type == SymbolType::WeakUndefined;
+  }
+  return InputAddress(ImportObjectIndex, 1, PLTEntrySize * static_cast<long>(Import->second + 1), Target);
+}
+
+void Linker::ApplyRelocations(size_t ObjectIndex, RelocationResults& Results) {
+  LinkStats& Counts = Results.Counts;
+  const ObjectFile& OF = *ObjectFiles[ObjectIndex];
+  const RelocationTable& Relocations = OF.Relocations;
+  int NumberOfSegments = static_cast<int>(OF.Segments.size());
+  size_t NumberOfSymbols = OF.Symbols.size();
+
+  for (size_t r = 0; r < Relocations.size(); r++) {
+    int SegmentNumber = Relocations.SegmentNumbers[r];
+    if (SegmentNumber < 1 || SegmentNumber > NumberOfSegments) {
+      Counts.RelocationsInvalid++;
+      continue;
+    }
+    const InputPlacement& Place = Placements[PlacementBegin[ObjectIndex] + SegmentNumber - 1];
+    if (Place.Out == nullptr)
+      continue;
+    RelocationType Type = Relocations.Types[r];
+    int Width = Type == RelocationType::AS8 ? 8 : 4;
+    long Location = Relocations.Locations[r];
+    if (Place.Merged >= 0 || Type == RelocationType::Unknown
+      || Location < 0 || Location + Width > Place.Size) {
+      Counts.RelocationsInvalid++;
+      continue;
+    }
+
+    long Address = Place.Address + Location;
+    long Addend = Relocations.Addends[r];
+    int Ref = Relocations.Refs[r];
+    char* Hex = &Place.Out->Data[Place.HexOffset + 2 * Location];
+    uint64_t Old = ReadHexWord(Hex, Width);
+    long Value;
+    if (Type == RelocationType::A4 || Type == RelocationType::R4) {
+      long Target;
+      if (Ref < 1 || Ref > NumberOfSegments) {
+        Counts.RelocationsInvalid++;
+        continue;
+      }
+      long RefAddress = OF.Segments[Ref - 1].Address;
+      long SegmentAddress = OF.Segments[SegmentNumber - 1].Address;
+      if (Placements[PlacementBegin[ObjectIndex] + Ref - 1].Merged >= 0) {
+        // Merging rearranges the pieces of Ref, so the byte the word points
+        // at is found from the word itself and looked up where it landed.
+        bool Absolute = Type == RelocationType::A4;
+        long Word = Absolute ? static_cast<long>(static_cast<uint32_t>(Old)) : static_cast<int32_t>(Old);
+        long OldTarget = Absolute ? Word : SegmentAddress + Word;
+        if (!InputAddress(ObjectIndex, Ref, OldTarget + Addend - RefAddress, Target)) {
+          Counts.RelocationsInvalid++;
+          Counts.RelocationsIntoMerged++;
+          continue;
+        }
+        Value = (Absolute ? Target : Target - Place.Address) - Word;
+      } else {
+        if (!InputAddress(ObjectIndex, Ref, 0, Target)) {
+          Counts.RelocationsInvalid++;
+          continue;
+        }
+        Value = Target - RefAddress + Addend;
+        if (Type == RelocationType::R4)
+          Value -= Place.Address - SegmentAddress;
+      }
+    } else {
+      long Target;
+      if (Ref < 1 || static_cast<size_t>(Ref) > NumberOfSymbols) {
+        Counts.RelocationsInvalid++;
+        continue;
+      }
+      if (!SymbolTarget(ObjectIndex, Ref - 1, Addend, Target)) {
+        Counts.RelocationsUndefined++;
+        Results.Undefined.emplace_back(OF.Symbols.Name(Ref - 1));
+        continue;
+      }
+      Value = Target + Addend;
+      if (Type == RelocationType::RS4)
+        Value -= Address;
+    }
+
+    if (Width == 4 && !FitsWord(Type, Old, Value)) {
+      Counts.RelocationsOverflowed++;
+      continue;
+    }
+    WriteHexWord(Hex, Width, Old + static_cast<uint64_t>(Value));
+    Counts.RelocationsApplied++;
+    if (Type == RelocationType::AS8)
+      Results.AbsoluteDoublewords.push_back(static_cast<uint32_t>(Address));
+    else if (Type == RelocationType::A4 || Type == RelocationType::AS4 || Type == RelocationType::AS4S)
+      Results.AbsoluteWords.push_back(static_cast<uint32_t>(Address));
+  }
+}
+}
@@ -0,0 +1,212 @@
+#include <Linker/SegmentMerging.h>
+
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+
+#include <Linker/Parallel.h>
+
+namespace ldl {
+
+namespace {
+// A power of two; a piece's shard is the top bits of its hash.
+constexpr size_t NumberOfShards = 64;
+constexpr int ShardShift = 58;
+
+// FNV-1a.
+uint64_t HashBytes(std::string_view Bytes) {
+  uint64_t Hash = 0xcbf29ce484222325ULL;
+  for (unsigned char C : Bytes) {
+    Hash ^= C;
+    Hash *= 0x100000001b3ULL;
+  }
+  return Hash;
+}
+
+class PieceKey {
+public:
+  std::string_view Bytes;
+  uint64_t Hash;
+  bool operator==(const PieceKey& Other) const { return Bytes == Other.Bytes; }
+};
+
+class PieceKeyHash {
+public:
+  size_t operator()(const PieceKey& Key) const { return static_cast<size_t>(Key.Hash); }
+};
+
+// Orders strings by their reversed bytes, greatest first, so that every
+// string comes right after the strings it is a suffix of.
+bool ReversedGreater(std::string_view A, std::string_view B) {
+  size_t Common = std::min(A.size(), B.size());
+  for (size_t i = 1; i <= Common; i++) {
+    unsigned char CA = A[A.size() - i];
+    unsigned char CB = B[B.size() - i];
+    if (CA != CB)
+      return CA > CB;
+  }
+  return A.size() > B.size();
+}
+
+bool EndsWith(std::string_view S, std::string_view Suffix) {
+  return S.size() >= Suffix.size() && S.compare(S.size() - Suffix.size(), Suffix.size(), Suffix) == 0;
+}
+}
+
+void MergedSegment::Merge(const std::string& Name, const std::vector<const Segment*>& NewInputs, bool TailMerge) {
+  Inputs = NewInputs;
+  const Segment& First = *Inputs.front();
+  size_t N = Inputs.size();
+
+  // Split every input into pieces. POF inputs are decoded from hex, and
+  // compressed ones decompressed, first.
+  std::vector<std::string> Decoded(N);
+  std::vector<std::string_view> Bytes(N);
+  std::vector<std::vector<MergePiece>> Split(N);
+  std::vector<char> Failed(N, 0);
+  ParallelFor(N, [&](size_t i) {
+    const Segment& S = *Inputs[i];
+    size_t Length = static_cast<size_t>(std::max(S.Length, 0));
+    if (S.Compressed()) {
+      Decoded[i].resize(Length);
+      if (!LZDecompress(S.CompressedData, &Decoded[i][0], Length)) {
+        Failed[i] = 1;
+        return;
+      }
+      Bytes[i] = Decoded[i];
+    } else if (S.Data.empty()) {
+      Bytes[i] = S.RawData.substr(0, Length);
+    } else {
+      Decoded[i].resize(std::min(S.Data.size() / 2, Length));
+      ReadHexBytes(&Decoded[i][0], std::string_view{S.Data}.substr(0, 2 * Decoded[i].size()));
+      Bytes[i] = Decoded[i];
+    }
+
+    size_t Offset = 0;
+    size_t Size = Bytes[i].size();
+    while (Offset < Size) {
+      size_t PieceLength;
+      if (S.MergeStrings) {
+        size_t End = Bytes[i].find('\0', Offset);
+        PieceLength = (End == std::string_view::npos ? Size : End + 1) - Offset;
+      } else {
+        PieceLength = std::min(static_cast<size_t>(S.MergeEntrySize), Size - Offset);
+      }
+      Split[i].push_back(MergePiece{static_cast<int>(Offset), static_cast<int>(PieceLength), 0});
+      Offset += PieceLength;
+    }
+  });
+  if (std::find(Failed.begin(), Failed.end(), 1) != Failed.end())
+    throw "Bad compressed segment";
+
+  PieceBegin.assign(1, 0);
+  Pieces.clear();
+  InputBytes = 0;
+  for (size_t i = 0; i < N; i++) {
+    Pieces.insert(Pieces.end(), Split[i].begin(), Split[i].end());
+    PieceBegin.push_back(Pieces.size());
+    InputBytes += static_cast<size_t>(std::max(Inputs[i]->Length, 0));
+  }
+  size_t P = Pieces.size();
+
+  std::vector<std::string_view> PieceBytes(P);
+  std::vector<uint64_t> Hashes(P);
+  ParallelFor(N, [&](size_t i) {
+    for (size_t p = PieceBegin[i]; p < PieceBegin[i + 1]; p++) {
+      PieceBytes[p] = Bytes[i].substr(Pieces[p].InputOffset, Pieces[p].Length);
+      Hashes[p] = HashBytes(PieceBytes[p]);
+    }
+  });
+
+  // Bucket the pieces by shard, keeping input order within each shard.
+  std::vector<size_t> ShardBegin(NumberOfShards + 1, 0);
+  for (size_t p = 0; p < P; p++)
+    ShardBegin[(Hashes[p] >> ShardShift) + 1]++;
+  for (size_t Shard = 0; Shard < NumberOfShards; Shard++)
+    ShardBegin[Shard + 1] += ShardBegin[Shard];
+  std::vector<uint32_t> ByShard(P);
+  std::vector<size_t> Cursor(ShardBegin.begin(), ShardBegin.end() - 1);
+  for (size_t p = 0; p < P; p++)
+    ByShard[Cursor[Hashes[p] >> ShardShift]++] = static_cast<uint32_t>(p);
+
+  // The first piece with each content leads its copies.
+  std::vector<uint32_t> Leader(P);
+  ParallelForChunks(NumberOfShards, std::min(NumberOfShards, ParallelChunkCount(P)), [&](size_t, size_t Begin, size_t End) {
+    for (size_t Shard = Begin; Shard < End; Shard++) {
+      std::unordered_map<PieceKey, uint32_t, PieceKeyHash> Table;
+      Table.reserve(ShardBegin[Shard + 1] - ShardBegin[Shard]);
+      for (size_t k = ShardBegin[Shard]; k < ShardBegin[Shard + 1]; k++) {
+        uint32_t p = ByShard[k];
+        Leader[p] = Table.emplace(PieceKey{PieceBytes[p], Hashes[p]}, p).first->second;
+      }
+    }
+  });
+
+  std::vector<uint32_t> Unique;
+  for (size_t p = 0; p < P; p++)
+    if (Leader[p] == p)
+      Unique.push_back(static_cast<uint32_t>(p));
+  UniquePieces = Unique.size();
+
+  // With tail merging, a string that ends a longer one shares its bytes.
+  std::vector<uint32_t> TailOf(P, UINT32_MAX);
+  if (TailMerge && First.MergeStrings) {
+    std::vector<uint32_t> Sorted = Unique;
+    std::sort(Sorted.begin(), Sorted.end(), [&](uint32_t A, uint32_t B) {
+      return ReversedGreater(PieceBytes[A], PieceBytes[B]);
+    });
+    uint32_t Previous = UINT32_MAX;
+    for (auto p : Sorted) {
+      if (Previous != UINT32_MAX && EndsWith(PieceBytes[Previous], PieceBytes[p]))
+        TailOf[p] = Previous;
+      else
+        Previous = p;
+    }
+  }
+
+  // The output is as aligned as its most aligned input. Constants start on
+  // the largest power of two dividing their size, up to that, as they did
+  // in their inputs, even after a short last piece.
+  int Alignment = 4;
+  for (auto* S : Inputs)
+    Alignment = std::max(Alignment, S->Alignment);
+  int PieceAlignment = First.MergeStrings ? 1 : std::min(Alignment, First.MergeEntrySize & -First.MergeEntrySize);
+
+  std::vector<int> Offset(P, -1);
+  std::string Raw;
+  for (auto p : Unique) {
+    if (TailOf[p] != UINT32_MAX)
+      continue;
+    Raw.resize(static_cast<size_t>(AlignAddress(static_cast<long>(Raw.size()), PieceAlignment)), '\0');
+    Offset[p] = static_cast<int>(Raw.size());
+    Raw.append(PieceBytes[p]);
+  }
+  for (auto p : Unique)
+    if (TailOf[p] != UINT32_MAX)
+      Offset[p] = Offset[TailOf[p]] + static_cast<int>(PieceBytes[TailOf[p]].size() - PieceBytes[p].size());
+  ParallelFor(P, [&](size_t p) {
+    Pieces[p].OutputOffset = Offset[Leader[p]];
+  });
+
+  Merged = Segment{"a.out", Name, 0x0, static_cast<int>(Raw.size()), "RP"};
+  Merged.MergeStrings = First.MergeStrings;
+  Merged.MergeEntrySize = First.MergeEntrySize;
+  Merged.Alignment = Alignment;
+  Merged.Data.resize(2 * Raw.size());
+  WriteHexBytes(&Merged.Data[0], Raw);
+}
+
+int MergedSegment::OutputOffset(size_t Input, int Offset) const {
+  auto Begin = Pieces.begin() + PieceBegin[Input];
+  auto End = Pieces.begin() + PieceBegin[Input + 1];
+  auto It = std::upper_bound(Begin, End, Offset, [](int O, const MergePiece& Piece) {
+    return O < Piece.InputOffset;
+  });
+  if (It == Begin)
+    return -1;
+  --It;
+  if (Offset >= It->InputOffset + It->Length)
+    return -1;
+  return It->OutputOffset + (Offset - It->InputOffset);
+}
+}
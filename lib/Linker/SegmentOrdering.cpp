@@ -0,0 +1,188 @@
+#include <Linker/SegmentOrdering.h>
+
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <unordered_map>
+
+namespace ldl {
+
+void SegmentOrdering::Clear() {
+  SymbolOrder.clear();
+  CallGraph.clear();
+}
+
+bool SegmentOrdering::ReadSymbolOrderingFile(const std::string& FileName) {
+  std::ifstream IFS{FileName};
+  if (!IFS.good())
+    return false;
+  std::string Line;
+  while (std::getline(IFS, Line)) {
+    std::istringstream ISS{Line};
+    std::string Name;
+    if (!(ISS >> Name) || Name[0] == '#')
+      continue;
+    SymbolOrder.push_back(Name);
+  }
+  return true;
+}
+
+bool SegmentOrdering::ReadCallGraphProfile(const std::string& FileName) {
+  std::ifstream IFS{FileName};
+  if (!IFS.good())
+    return false;
+  std::string Line;
+  while (std::getline(IFS, Line)) {
+    std::istringstream ISS{Line};
+    CallGraphEdge E;
+    if (!(ISS >> E.Caller))
+      continue;
+    if (E.Caller[0] == '#')
+      continue;
+    if (!(ISS >> E.Callee >> E.Weight))
+      return false;
+    CallGraph.push_back(E);
+  }
+  return true;
+}
+
+void SegmentOrdering::Order(std::vector<const Segment*>& Segments, const std::vector<std::shared_ptr<const ObjectFile>>& ObjectFiles) const {
+  // The names of the symbols each segment defines.
+  std::vector<std::vector<std::string>> Defined(Segments.size());
+  for (size_t i = 0; i < Segments.size(); i++) {
+    const Segment& S = *Segments[i];
+    if (S.ObjectIndex < 0 || S.ObjectIndex >= static_cast<int>(ObjectFiles.size()))
+      continue;
+    auto& Symbols = ObjectFiles[S.ObjectIndex]->Symbols;
+    for (size_t j = 0; j < Symbols.size(); j++)
+      if (IsGlobalDefinition(Symbols.Types[j]) && Symbols.SegmentNumbers[j] == S.SegmentIndex + 1)
+        Defined[i].emplace_back(Symbols.Name(j));
+  }
+
+  // Unranked segments sort after every ranked one, in their original order.
+  std::vector<long> Rank(Segments.size(), -1);
+  OrderBySymbols(Segments, Rank, Defined);
+  if (!CallGraph.empty())
+    OrderByCallGraph(Segments, Rank, Defined);
+
+  std::vector<size_t> Permutation(Segments.size());
+  std::iota(Permutation.begin(), Permutation.end(), 0);
+  std::stable_sort(Permutation.begin(), Permutation.end(), [&](size_t A, size_t B) {
+    if (Rank[A] < 0 || Rank[B] < 0)
+      return Rank[A] >= 0 && Rank[B] < 0;
+    return Rank[A] < Rank[B];
+  });
+
+  std::vector<const Segment*> Ordered;
+  Ordered.reserve(Segments.size());
+  for (auto i : Permutation)
+    Ordered.push_back(Segments[i]);
+  Segments = std::move(Ordered);
+}
+
+void SegmentOrdering::OrderBySymbols(std::vector<const Segment*>& Segments, std::vector<long>& Rank, const std::vector<std::vector<std::string>>& Defined) const {
+  std::unordered_map<std::string, size_t> SegmentOfSymbol;
+  for (size_t i = 0; i < Segments.size(); i++)
+    for (auto& Name : Defined[i])
+      SegmentOfSymbol.emplace(Name, i);
+
+  long NextRank = 0;
+  for (auto& Name : SymbolOrder) {
+    auto It = SegmentOfSymbol.find(Name);
+    if (It != SegmentOfSymbol.end() && Rank[It->second] < 0)
+      Rank[It->second] = NextRank++;
+  }
+}
+
+void SegmentOrdering::OrderByCallGraph(std::vector<const Segment*>& Segments, std::vector<long>& Rank, const std::vector<std::vector<std::string>>& Defined) const {
+  size_t N = Segments.size();
+  std::unordered_map<std::string, size_t> SegmentOfSymbol;
+  for (size_t i = 0; i < N; i++)
+    for (auto& Name : Defined[i])
+      SegmentOfSymbol.emplace(Name, i);
+
+  // Calls between segments; calls within a segment do not affect placement.
+  std::vector<long> Hotness(N, 0);
+  std::vector<long> HeaviestCallWeight(N, 0);
+  std::vector<long> HeaviestCaller(N, -1);
+  std::unordered_map<size_t, std::unordered_map<size_t, long>> Weights;
+  for (auto& E : CallGraph) {
+    auto Caller = SegmentOfSymbol.find(E.Caller);
+    auto Callee = SegmentOfSymbol.find(E.Callee);
+    if (Caller == SegmentOfSymbol.end() || Callee == SegmentOfSymbol.end())
+      continue;
+    Hotness[Callee->second] += E.Weight;
+    if (Caller->second != Callee->second)
+      Weights[Callee->second][Caller->second] += E.Weight;
+  }
+  for (auto& E : CallGraph) {
+    auto Caller = SegmentOfSymbol.find(E.Caller);
+    if (Caller != SegmentOfSymbol.end() && Hotness[Caller->second] == 0)
+      Hotness[Caller->second] = 1;
+  }
+  for (auto& CalleeCallers : Weights)
+    for (auto& CallerWeight : CalleeCallers.second) {
+      long& Heaviest = HeaviestCallWeight[CalleeCallers.first];
+      long& Caller = HeaviestCaller[CalleeCallers.first];
+      if (CallerWeight.second > Heaviest
+        || (CallerWeight.second == Heaviest && static_cast<long>(CallerWeight.first) < Caller)) {
+        Heaviest = CallerWeight.second;
+        Caller = static_cast<long>(CallerWeight.first);
+      }
+    }
+
+  std::vector<size_t> Cluster(N);
+  std::iota(Cluster.begin(), Cluster.end(), 0);
+  std::vector<std::vector<size_t>> Members(N);
+  std::vector<long> ClusterSize(N);
+  std::vector<long> ClusterWeight(N);
+  for (size_t i = 0; i < N; i++) {
+    Members[i].push_back(i);
+    ClusterSize[i] = Segments[i]->Length;
+    ClusterWeight[i] = Hotness[i];
+  }
+
+  std::vector<size_t> ByHotness;
+  for (size_t i = 0; i < N; i++)
+    if (Hotness[i] > 0)
+      ByHotness.push_back(i);
+  std::stable_sort(ByHotness.begin(), ByHotness.end(), [&](size_t A, size_t B) {
+    return Hotness[A] > Hotness[B];
+  });
+
+  for (auto Callee : ByHotness) {
+    if (HeaviestCaller[Callee] < 0)
+      continue;
+    size_t To = Cluster[HeaviestCaller[Callee]];
+    size_t From = Cluster[Callee];
+    if (To == From || ClusterSize[To] + ClusterSize[From] > ClusterSizeLimit)
+      continue;
+    for (auto Member : Members[From]) {
+      Cluster[Member] = To;
+      Members[To].push_back(Member);
+    }
+    Members[From].clear();
+    ClusterSize[To] += ClusterSize[From];
+    ClusterWeight[To] += ClusterWeight[From];
+  }
+
+  std::vector<size_t> HotClusters;
+  for (size_t i = 0; i < N; i++)
+    if (!Members[i].empty() && ClusterWeight[i] > 0)
+      HotClusters.push_back(i);
+  std::stable_sort(HotClusters.begin(), HotClusters.end(), [&](size_t A, size_t B) {
+    // Density comparison without division: WA / SA > WB / SB.
+    long SA = std::max(ClusterSize[A], 1L);
+    long SB = std::max(ClusterSize[B], 1L);
+    return static_cast<__int128>(ClusterWeight[A]) * SB > static_cast<__int128>(ClusterWeight[B]) * SA;
+  });
+
+  // Segments the ordering file already placed keep their rank.
+  long NextRank = N > 0 ? *std::max_element(Rank.begin(), Rank.end()) + 1 : 0;
+  for (auto C : HotClusters)
+    for (auto Member : Members[C])
+      if (Rank[Member] < 0)
+        Rank[Member] = NextRank++;
+}
+}
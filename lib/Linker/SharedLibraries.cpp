@@ -0,0 +1,142 @@
+#include <Linker/Linker.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+#include <Linker/SymbolHash.h>
+
+namespace ldl {
+
+void Linker::CollectImports() {
+  if (Libraries.empty())
+    return;
+
+  // Only functions are imported: a reference to library data would need the
+  // data copied into the image.
+  std::unordered_set<std::string> LibraryFunctions;
+  for (auto& FileName : Libraries) {
+    ObjectReader OR{FileName};
+    if (!OR.ReadFileHeader() || !OR.ReadSegmentHeaders() || !OR.ReadSymbolTable())
+      throw "Could not read shared library";
+    for (size_t Row = 0; Row < OR.Symbols.size(); Row++) {
+      int SegmentNumber = OR.Symbols.SegmentNumbers[Row];
+      if (OR.Symbols.Types[Row] == SymbolType::Defined && SegmentNumber >= 1
+        && SegmentNumber <= static_cast<int>(OR.Segments.size())
+        && OR.Segments[SegmentNumber - 1].Permissions == SegmentPermissions::RP)
+        LibraryFunctions.emplace(OR.Symbols.Name(Row));
+    }
+  }
+
+  std::unordered_set<std::string_view> Defined;
+  for (size_t Row = 0; Row < MergedSymbols.size(); Row++)
+    if (IsGlobalDefinition(MergedSymbols.Types[Row])
+      || (MergedSymbols.Types[Row] == SymbolType::Undefined && MergedSymbols.Values[Row] != 0))
+      Defined.insert(MergedSymbols.Name(Row));
+
+  for (auto& OFPtr : ObjectFiles) {
+    auto& Symbols = OFPtr->Symbols;
+    auto& Relocations = OFPtr->Relocations;
+    for (size_t r = 0; r < Relocations.size(); r++) {
+      RelocationType Type = Relocations.Types[r];
+      int Ref = Relocations.Refs[r];
+      if ((Type != RelocationType::AS4 && Type != RelocationType::AS4S && Type != RelocationType::AS8
+        && Type != RelocationType::RS4)
+        || Ref < 1 || static_cast<size_t>(Ref) > Symbols.size())
+        continue;
+      SymbolType RefType = Symbols.Types[Ref - 1];
+      if ((RefType != SymbolType::Undefined && RefType != SymbolType::WeakUndefined) || Symbols.Values[Ref - 1] != 0)
+        continue;
+      std::string_view Name = Symbols.Name(Ref - 1);
+      if (Defined.count(Name) || ImportIndex.count(Name) || !LibraryFunctions.count(std::string{Name}))
+        continue;
+      ImportIndex.emplace(Name, Imports.size());
+      Imports.emplace_back(Name);
+    }
+  }
+
+  if (Imports.empty())
+    return;
+  ImportObjectIndex = static_cast<int>(ObjectFiles.size());
+  ObjectFiles.push_back(MakeImportObject());
+}
+
+namespace {
+void PutBytes(std::string& Bytes, size_t Offset, std::initializer_list<unsigned char> Values) {
+  for (auto Value : Values)
+    Bytes[Offset++] = static_cast<char>(Value);
+}
+}
+
+// Segment 1 is the .plt and segment 2 the .got; symbols 1 and 2 are their
+// section symbols, so that the relocations below can name any byte of them.
+SharedObjectFilePtr Linker::MakeImportObject() const {
+  auto OF = std::make_shared<ObjectFile>();
+  OF->FileName = "<imports>";
+  int NumberOfImports = static_cast<int>(Imports.size());
+  int PLTLength = PLTEntrySize * (NumberOfImports + 1);
+  int GOTLength = 8 * (ReservedGOTSlots + NumberOfImports);
+
+  // pushq .got+8(%rip); jmpq *.got+16(%rip); nopl 0(%rax)
+  std::string PLT(PLTLength, '\0');
+  PutBytes(PLT, 0, {0xff, 0x35, 0, 0, 0, 0, 0xff, 0x25, 0, 0, 0, 0, 0x0f, 0x1f, 0x40, 0x00});
+  OF->Relocations.Add(2, 1, 2, RelocationType::RS4, 8 - 4);
+  OF->Relocations.Add(8, 1, 2, RelocationType::RS4, 16 - 4);
+  for (int i = 0; i < NumberOfImports; i++) {
+    // jmpq *slot(%rip); pushq $i; jmp .plt
+    int Entry = PLTEntrySize * (i + 1);
+    int Slot = 8 * (ReservedGOTSlots + i);
+    PutBytes(PLT, Entry, {0xff, 0x25, 0, 0, 0, 0, 0x68,
+      static_cast<unsigned char>(i), static_cast<unsigned char>(i >> 8),
+      static_cast<unsigned char>(i >> 16), static_cast<unsigned char>(i >> 24),
+      0xe9, 0, 0, 0, 0});
+    OF->Relocations.Add(Entry + 2, 1, 2, RelocationType::RS4, Slot - 4);
+    OF->Relocations.Add(Entry + 12, 1, 1, RelocationType::RS4, -4);
+    OF->Relocations.Add(Slot, 2, 1, RelocationType::AS8, Entry + 6);
+  }
+
+  Segment PLTSegment{OF->FileName, ".plt", 0x0, PLTLength, "RP"};
+  PLTSegment.Data.resize(2 * PLT.size());
+  WriteHexBytes(&PLTSegment.Data[0], PLT);
+  Segment GOTSegment{OF->FileName, ".got", 0x0, GOTLength, "RWP"};
+  GOTSegment.Data.assign(2 * GOTLength, '0');
+  OF->Segments = {PLTSegment, GOTSegment};
+  OF->Symbols.Add(".plt", 0, 1, SymbolType::Section);
+  OF->Symbols.Add(".got", 0, 2, SymbolType::Section);
+  OF->FH = FileHeader{"LINK", 2, 2, static_cast<int>(OF->Relocations.size())};
+  return OF;
+}
+
+void Linker::GenerateSymbolHashSegment(std::vector<Segment>& Ss, SymbolTable& Symbols) {
+  size_t Offset = 0;
+  while (Offset < Symbols.size() && Symbols.Types[Offset] != SymbolType::Defined)
+    Offset++;
+  std::vector<uint32_t> Hashes;
+  for (size_t Row = Offset; Row < Symbols.size(); Row++)
+    Hashes.push_back(SymbolHashTable::Hash(Symbols.Name(Row)));
+  uint32_t NumberOfBuckets = SymbolHashTable::BucketCount(Hashes.size());
+  std::vector<size_t> Order = SymbolHashTable::Order(Hashes, NumberOfBuckets);
+
+  SymbolTable Sorted;
+  std::vector<uint32_t> SortedHashes;
+  for (size_t Row = 0; Row < Offset; Row++)
+    Sorted.Add(Symbols.Name(Row), Symbols.Values[Row], Symbols.SegmentNumbers[Row], Symbols.Types[Row]);
+  for (auto i : Order) {
+    size_t Row = Offset + i;
+    Sorted.Add(Symbols.Name(Row), Symbols.Values[Row], Symbols.SegmentNumbers[Row], Symbols.Types[Row]);
+    SortedHashes.push_back(Hashes[i]);
+  }
+  Symbols = std::move(Sorted);
+
+  std::string Bytes = SymbolHashTable::Build(SortedHashes, static_cast<uint32_t>(Offset), NumberOfBuckets);
+  auto Last = std::max_element(Ss.begin(), Ss.end(), [](const Segment& A, const Segment& B) {
+    return A.Address + A.Length < B.Address + B.Length;
+  });
+  SymbolHashSegment.Address = 0;
+  if (Last != Ss.end())
+    SymbolHashSegment.Address = ((Last->Address + Last->Length) & ~0xFFF) + 0x1000;
+  SymbolHashSegment.Length = static_cast<int>(Bytes.size());
+  SymbolHashSegment.Data.resize(2 * Bytes.size());
+  WriteHexBytes(&SymbolHashSegment.Data[0], Bytes);
+  Ss.push_back(SymbolHashSegment);
+}
+}
@@ -0,0 +1,419 @@
+#include <Loader/Loader.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include <sys/mman.h>
+
+#include <ElfReader/MappedFile.h>
+#include <Linker/Parallel.h>
+#include <Linker/RelativeRelocations.h>
+
+// The .plt jumps here to bind an import on its first call, with the image
+// and the import's index pushed on top of the caller's return address. The
+// argument registers are saved around the binding, which runs on a stack
+// realigned in case the caller did not keep it aligned. The target is put
+// where the index was and the return goes to it, so that the target runs as
+// if it had been called directly.
+extern "C" uint64_t ldl_BindLazily(ldl::LoadedImage* Image, uint64_t Index);
+#if defined(__x86_64__)
+extern "C" void ldl_LazyBindingEntry();
+asm(R"(
+  .text
+  .globl ldl_LazyBindingEntry
+  .hidden ldl_LazyBindingEntry
+  .type ldl_LazyBindingEntry, @function
+ldl_LazyBindingEntry:
+  pushq %rax
+  pushq %rcx
+  pushq %rdx
+  pushq %rsi
+  pushq %rdi
+  pushq %r8
+  pushq %r9
+  pushq %r10
+  pushq %r11
+  subq $128, %rsp
+  movdqu %xmm0, 0(%rsp)
+  movdqu %xmm1, 16(%rsp)
+  movdqu %xmm2, 32(%rsp)
+  movdqu %xmm3, 48(%rsp)
+  movdqu %xmm4, 64(%rsp)
+  movdqu %xmm5, 80(%rsp)
+  movdqu %xmm6, 96(%rsp)
+  movdqu %xmm7, 112(%rsp)
+  movq 200(%rsp), %rdi
+  movq 208(%rsp), %rsi
+  pushq %rbx
+  movq %rsp, %rbx
+  andq $-16, %rsp
+  call ldl_BindLazily
+  movq %rbx, %rsp
+  popq %rbx
+  movq %rax, 208(%rsp)
+  movdqu 0(%rsp), %xmm0
+  movdqu 16(%rsp), %xmm1
+  movdqu 32(%rsp), %xmm2
+  movdqu 48(%rsp), %xmm3
+  movdqu 64(%rsp), %xmm4
+  movdqu 80(%rsp), %xmm5
+  movdqu 96(%rsp), %xmm6
+  movdqu 112(%rsp), %xmm7
+  addq $128, %rsp
+  popq %r11
+  popq %r10
+  popq %r9
+  popq %r8
+  popq %rdi
+  popq %rsi
+  popq %rdx
+  popq %rcx
+  popq %rax
+  addq $8, %rsp
+  ret
+  .size ldl_LazyBindingEntry, .-ldl_LazyBindingEntry
+)");
+#endif
+
+uint64_t ldl_BindLazily(ldl::LoadedImage* Image, uint64_t Index) {
+  if (!Image->Bind(Index)) {
+    std::string_view Name = Image->Imports[Index].Name;
+    std::fprintf(stderr, "ldl: unresolved import %.*s\n", static_cast<int>(Name.size()), Name.data());
+    std::abort();
+  }
+  return *Image->Imports[Index].Slot;
+}
+
+namespace ldl {
+
+namespace {
+// Tables the loader reads, which the image itself never touches.
+bool IsTableSegment(const Segment& S) {
+  return S.Name == ".relr" || S.Name == ".gnu.hash" || S.Name == ".note.build-id";
+}
+}
+
+LoadedImage::~LoadedImage() {
+  if (Base)
+    munmap(Base, Size);
+}
+
+bool LoadedImage::SymbolAddress(const std::string& Name, void*& Address) const {
+  for (size_t i = 0; i < Symbols.size(); i++) {
+    int SegmentNumber = Symbols.SegmentNumbers[i];
+    if (Symbols.Name(i) != Name || SegmentNumber < 1 || SegmentNumber > static_cast<int>(Segments.size()))
+      continue;
+    Address = this->Address(Segments[SegmentNumber - 1].Address + static_cast<long>(Symbols.Values[i]));
+    return true;
+  }
+  return false;
+}
+
+void* LoadedImage::Entry(const std::string& Name) const {
+  void* Address;
+  if (SymbolAddress(Name, Address))
+    return Address;
+  for (auto& S : Segments)
+    if (S.Permissions == SegmentPermissions::RP)
+      return this->Address(S.Address);
+  return nullptr;
+}
+
+bool LoadedImage::Lookup(std::string_view Name, uint32_t Hash, void*& Address) const {
+  return Exports.Find(Hash, [&](uint32_t Row) {
+    if (Row >= Symbols.size() || Symbols.Types[Row] != SymbolType::Defined || Symbols.Name(Row) != Name)
+      return false;
+    int SegmentNumber = Symbols.SegmentNumbers[Row];
+    if (SegmentNumber < 1 || SegmentNumber > static_cast<int>(Segments.size()))
+      return false;
+    Address = this->Address(Segments[SegmentNumber - 1].Address + static_cast<long>(Symbols.Values[Row]));
+    return true;
+  });
+}
+
+bool LoadedImage::Bind(size_t Index) {
+  void* Address;
+  if (Owner == nullptr || Index >= Imports.size() || !Owner->Resolve(Imports[Index].Name, Address))
+    return false;
+  __atomic_store_n(Imports[Index].Slot, reinterpret_cast<uint64_t>(Address), __ATOMIC_RELEASE);
+  return true;
+}
+
+bool Loader::Resolve(std::string_view Name, void*& Address) const {
+  uint32_t Hash = SymbolHashTable::Hash(Name);
+  for (auto& Library : Libraries)
+    if (Library->Lookup(Name, Hash, Address))
+      return true;
+  return false;
+}
+
+bool Loader::TextCursor::NextLine(std::string_view& Line) {
+  if (Offset >= Text.size())
+    return false;
+  size_t End = Text.find('\n', Offset);
+  if (End == std::string_view::npos)
+    End = Text.size();
+  Line = Text.substr(Offset, End - Offset);
+  if (!Line.empty() && Line.back() == '\r')
+    Line.remove_suffix(1);
+  Offset = End + 1;
+  return true;
+}
+
+std::unique_ptr<LoadedImage> Loader::Load(const std::string& FileName) {
+  return LoadImage(FileName, Rebase);
+}
+
+// Libraries are linked like executables, but several of them cannot all sit
+// at their linked addresses, so they always move.
+LoadedImage& Loader::LoadLibrary(const std::string& FileName) {
+  Libraries.push_back(LoadImage(FileName, true));
+  return *Libraries.back();
+}
+
+std::unique_ptr<LoadedImage> Loader::LoadImage(const std::string& FileName, bool Move) {
+  MappedFile MF{FileName};
+  TextCursor Cursor{MF.View(0, MF.Size)};
+
+  auto Image = std::make_unique<LoadedImage>();
+  Image->FileName = FileName;
+  FileHeader FH;
+  ReadHeaders(Cursor, *Image, FH);
+  MapImage(*Image, Move);
+  ReadSegmentData(Cursor, *Image);
+  ReadDynamicTables(*Image);
+
+  long Delta = Image->Delta();
+  if (Delta != 0) {
+    auto Start = std::chrono::steady_clock::now();
+    Image->RelativeRelocations = ApplyRelativeRelocations(*Image, Delta);
+    Image->RelocationTime = std::chrono::steady_clock::now() - Start;
+  }
+  BindImports(*Image);
+  ProtectSegments(*Image);
+  return Image;
+}
+
+// Counts are decimal; addresses, lengths and symbol fields are hex, as
+// ObjectReader reads them.
+void Loader::ReadHeaders(TextCursor& Cursor, LoadedImage& Image, FileHeader& FH) {
+  std::string_view Line;
+  if (!Cursor.NextLine(Line) || Line != "LINK")
+    throw "Not a linked POF image";
+  if (!Cursor.NextLine(Line))
+    throw "Truncated image header";
+  std::istringstream Counts{std::string{Line}};
+  if (!(Counts >> FH.NumberOfSegments >> FH.NumberOfSymbols >> FH.NumberOfRelocations))
+    throw "Bad image header";
+
+  for (int i = 0; i < FH.NumberOfSegments; i++) {
+    Segment S;
+    S.FileName = Image.FileName;
+    if (!Cursor.NextLine(Line))
+      throw "Truncated segment headers";
+    std::istringstream ISS{std::string{Line}};
+    if (!(ISS >> S.Name >> std::hex >> S.Address >> S.Length >> S.Code) || S.Address < 0 || S.Length < 0)
+      throw "Bad segment header";
+    std::string Attribute;
+    while (ISS >> Attribute)
+      if (Attribute.compare(0, 2, "Z=") == 0 && !(std::istringstream{Attribute.substr(2)} >> std::hex >> S.CompressedSize))
+        throw "Bad segment header";
+    if (S.Compressed() && S.Length == 0)
+      throw "Bad segment header";
+    S.Permissions = ParseSegmentPermissions(S.Code);
+    S.SegmentIndex = i;
+    Image.Segments.push_back(S);
+  }
+
+  for (int i = 0; i < FH.NumberOfSymbols; i++) {
+    if (!Cursor.NextLine(Line))
+      throw "Truncated symbol table";
+    std::istringstream ISS{std::string{Line}};
+    Symbol S;
+    if (!(ISS >> S.Name >> std::hex >> S.Value >> S.SegmentNumber >> S.Type))
+      throw "Bad symbol";
+    Image.Symbols.push_back(S);
+  }
+
+  // A linked image has had its relocations applied already; anything else
+  // is an input object.
+  if (FH.NumberOfRelocations != 0)
+    throw "Image has unapplied relocations";
+}
+
+void Loader::MapImage(LoadedImage& Image, bool Move) {
+  if (Image.Segments.empty())
+    throw "Image has no segments";
+  long Low = Image.Segments.front().Address;
+  long High = Low;
+  for (auto& S : Image.Segments) {
+    Low = std::min<long>(Low, S.Address);
+    High = std::max<long>(High, static_cast<long>(S.Address) + S.Length);
+  }
+  Image.LinkedBase = Low & ~(PageSize - 1);
+  Image.Size = static_cast<size_t>(((High + PageSize - 1) & ~(PageSize - 1)) - Image.LinkedBase);
+  if (Image.Size == 0)
+    Image.Size = PageSize;
+
+  int Flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  void* Addr = MAP_FAILED;
+  if (!Move) {
+    // Older kernels take MAP_FIXED_NOREPLACE as a hint; check where the
+    // mapping went.
+    Addr = mmap(reinterpret_cast<void*>(Image.LinkedBase), Image.Size, PROT_READ | PROT_WRITE, Flags | MAP_FIXED_NOREPLACE, -1, 0);
+    if (Addr != MAP_FAILED && Addr != reinterpret_cast<void*>(Image.LinkedBase)) {
+      munmap(Addr, Image.Size);
+      Addr = MAP_FAILED;
+    }
+  }
+  if (Addr == MAP_FAILED) {
+    // Absolute slots are 4 bytes wide, so a moved image stays below 2GB.
+#ifdef MAP_32BIT
+    Flags |= MAP_32BIT;
+#endif
+    Addr = mmap(nullptr, Image.Size, PROT_READ | PROT_WRITE, Flags, -1, 0);
+  }
+  if (Addr == MAP_FAILED)
+    throw "Could not map image";
+  Image.Base = static_cast<unsigned char*>(Addr);
+}
+
+// The lines are found first so that they can be decoded, and compressed
+// segments decompressed, in parallel.
+void Loader::ReadSegmentData(TextCursor& Cursor, LoadedImage& Image) {
+  std::vector<std::string_view> Lines(Image.Segments.size());
+  for (auto& Line : Lines)
+    if (!Cursor.NextLine(Line))
+      throw "Truncated segment data";
+
+  size_t N = Lines.size();
+  size_t HexBytes = 0;
+  for (auto& Line : Lines)
+    HexBytes += Line.size();
+  std::vector<char> Failed(N, 0);
+  ParallelForChunks(N, std::min(N, ParallelChunkCount(N + HexBytes / 64)), [&](size_t, size_t First, size_t Last) {
+    for (size_t i = First; i < Last; i++) {
+      const Segment& S = Image.Segments[i];
+      if (S.Permissions == SegmentPermissions::RW)
+        continue;
+      char* Out = static_cast<char*>(Image.Address(S.Address));
+      size_t Bytes = std::min(static_cast<size_t>(S.Length), Lines[i].size() / 2);
+      if (!S.Compressed()) {
+        ReadHexBytes(Out, Lines[i].substr(0, 2 * Bytes));
+        continue;
+      }
+      std::string Block(static_cast<size_t>(S.CompressedSize), '\0');
+      if (Lines[i].size() != 2 * Block.size()) {
+        Failed[i] = 1;
+        continue;
+      }
+      ReadHexBytes(&Block[0], Lines[i]);
+      Failed[i] = !LZDecompress(Block, Out, static_cast<size_t>(S.Length));
+    }
+  });
+  if (std::find(Failed.begin(), Failed.end(), 1) != Failed.end())
+    throw "Bad compressed segment";
+}
+
+void Loader::ReadDynamicTables(LoadedImage& Image) {
+  for (auto& S : Image.Segments)
+    if (S.Name == ".gnu.hash" && !Image.Exports.Read(static_cast<const unsigned char*>(Image.Address(S.Address)), S.Length))
+      throw "Bad .gnu.hash segment";
+
+  for (size_t Row = 0; Row < Image.Symbols.size(); Row++) {
+    int SegmentNumber = Image.Symbols.SegmentNumbers[Row];
+    if (Image.Symbols.Types[Row] != SymbolType::Import)
+      continue;
+    if (SegmentNumber < 1 || SegmentNumber > static_cast<int>(Image.Segments.size()))
+      throw "Bad import symbol";
+    long Slot = Image.Segments[SegmentNumber - 1].Address + static_cast<long>(Image.Symbols.Values[Row]);
+    if (Slot % 8 != 0 || Slot < Image.LinkedBase || Slot + 8 > Image.LinkedBase + static_cast<long>(Image.Size))
+      throw "Bad import slot";
+    Image.Imports.push_back(LoadedImage::Import{Image.Symbols.Name(Row), static_cast<uint64_t*>(Image.Address(Slot))});
+  }
+}
+
+// The first .got slots hold the image and the lazy binding entry; the
+// import slots already point back into the .plt, moved with the image.
+void Loader::BindImports(LoadedImage& Image) {
+  if (Image.Imports.empty())
+    return;
+  Image.Owner = this;
+  auto It = std::find_if(Image.Segments.begin(), Image.Segments.end(), [](const Segment& S) {
+    return S.Name == ".got";
+  });
+  if (It == Image.Segments.end() || It->Length < 24 || It->Address % 8 != 0)
+    throw "Image imports without a .got";
+  auto GOT = static_cast<uint64_t*>(Image.Address(It->Address));
+  GOT[1] = reinterpret_cast<uint64_t>(&Image);
+
+#if defined(__x86_64__)
+  GOT[2] = reinterpret_cast<uint64_t>(&ldl_LazyBindingEntry);
+  if (LazyBinding)
+    return;
+#endif
+  for (size_t i = 0; i < Image.Imports.size(); i++)
+    if (!Image.Bind(i))
+      throw "Unresolved import";
+}
+
+size_t Loader::ApplyRelativeRelocations(LoadedImage& Image, long Delta) {
+  auto It = std::find_if(Image.Segments.begin(), Image.Segments.end(), [](const Segment& S) {
+    return S.Name == ".relr";
+  });
+  if (It == Image.Segments.end() || It->Length < 4)
+    return 0;
+
+  size_t NumberOfEntries = static_cast<size_t>(It->Length) / 4;
+  std::vector<uint32_t> Entries(NumberOfEntries);
+  std::memcpy(Entries.data(), Image.Address(It->Address), 4 * NumberOfEntries);
+  size_t NumberOfWordEntries = std::min<size_t>(Entries[0], NumberOfEntries - 1);
+
+  unsigned char* Base = Image.Base;
+  long LinkedBase = Image.LinkedBase;
+  long LinkedEnd = LinkedBase + static_cast<long>(Image.Size);
+  size_t Slots = 0;
+  RelativeRelocations::Decode(&Entries[1], NumberOfWordEntries, 4, [&](uint64_t Address) {
+    if (static_cast<long>(Address) < LinkedBase || static_cast<long>(Address) + 4 > LinkedEnd)
+      throw "Relative relocation outside the image";
+    unsigned char* Slot = Base + (Address - LinkedBase);
+    uint32_t Value;
+    std::memcpy(&Value, Slot, 4);
+    Value += static_cast<uint32_t>(Delta);
+    std::memcpy(Slot, &Value, 4);
+    Slots++;
+  });
+  RelativeRelocations::Decode(&Entries[1 + NumberOfWordEntries], NumberOfEntries - 1 - NumberOfWordEntries, 8, [&](uint64_t Address) {
+    if (static_cast<long>(Address) < LinkedBase || static_cast<long>(Address) + 8 > LinkedEnd)
+      throw "Relative relocation outside the image";
+    unsigned char* Slot = Base + (Address - LinkedBase);
+    uint64_t Value;
+    std::memcpy(&Value, Slot, 8);
+    Value += static_cast<uint64_t>(Delta);
+    std::memcpy(Slot, &Value, 8);
+    Slots++;
+  });
+  return Slots;
+}
+
+// Writable segments go last, so a page that RP data shares with RW data
+// stays writable.
+void Loader::ProtectSegments(LoadedImage& Image) {
+  for (bool Writable : {false, true}) {
+    for (auto& S : Image.Segments) {
+      if (S.Length == 0 || (S.Permissions != SegmentPermissions::RP) != Writable)
+        continue;
+      int Protection = PROT_READ | PROT_WRITE;
+      if (!Writable)
+        Protection = IsTableSegment(S) ? PROT_READ : PROT_READ | PROT_EXEC;
+      long Begin = S.Address & ~(PageSize - 1);
+      long End = (static_cast<long>(S.Address) + S.Length + PageSize - 1) & ~(PageSize - 1);
+      if (mprotect(Image.Address(Begin), static_cast<size_t>(End - Begin), Protection) != 0)
+        throw "Could not protect image segment";
+    }
+  }
+}
+}
@@ -0,0 +1,180 @@
+#include <ObjectReader/Compression.h>
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <ObjectReader/ObjectReader.h>
+
+namespace ldl {
+
+namespace {
+constexpr size_t MaximumDistance = 0xffff;
+constexpr int HashBits = 14;
+
+uint32_t Load32(const char* P) {
+  uint32_t V;
+  std::memcpy(&V, P, sizeof(V));
+  return V;
+}
+
+uint32_t HashOf(uint32_t V) {
+  return (V * 2654435761u) >> (32 - HashBits);
+}
+
+void PutLength(std::string& Out, size_t Length) {
+  while (Length >= 255) {
+    Out.push_back(static_cast<char>(255));
+    Length -= 255;
+  }
+  Out.push_back(static_cast<char>(Length));
+}
+
+void PutSequence(std::string& Out, std::string_view Literals, size_t Distance, size_t MatchLength) {
+  size_t ExtraMatch = MatchLength ? MatchLength - LZMinimumMatch : 0;
+  unsigned char Token = static_cast<unsigned char>(std::min<size_t>(Literals.size(), 15) << 4
+    | std::min<size_t>(ExtraMatch, 15));
+  Out.push_back(static_cast<char>(Token));
+  if (Literals.size() >= 15)
+    PutLength(Out, Literals.size() - 15);
+  Out.append(Literals);
+  if (MatchLength == 0)
+    return;
+  Out.push_back(static_cast<char>(Distance & 0xff));
+  Out.push_back(static_cast<char>(Distance >> 8));
+  if (ExtraMatch >= 15)
+    PutLength(Out, ExtraMatch - 15);
+}
+
+// Reads a length continued past a nibble of 15.
+bool GetLength(std::string_view Block, size_t& In, size_t& Length) {
+  unsigned char B;
+  do {
+    if (In >= Block.size())
+      return false;
+    B = static_cast<unsigned char>(Block[In++]);
+    Length += B;
+  } while (B == 255);
+  return true;
+}
+
+// Walks the sequences of Block, producing them only when Out is set.
+bool Decode(std::string_view Block, char* Out, size_t Size) {
+  size_t In = 0;
+  size_t Produced = 0;
+  while (In < Block.size()) {
+    unsigned char Token = static_cast<unsigned char>(Block[In++]);
+    size_t Literals = Token >> 4;
+    if (Literals == 15 && !GetLength(Block, In, Literals))
+      return false;
+    if (Literals > Block.size() - In || Literals > Size - Produced)
+      return false;
+    if (Out)
+      std::memcpy(Out + Produced, Block.data() + In, Literals);
+    In += Literals;
+    Produced += Literals;
+    if (In == Block.size())
+      break;
+
+    if (Block.size() - In < 2)
+      return false;
+    size_t Distance = static_cast<unsigned char>(Block[In]) | static_cast<size_t>(static_cast<unsigned char>(Block[In + 1])) << 8;
+    In += 2;
+    size_t MatchLength = Token & 0xf;
+    if (MatchLength == 15 && !GetLength(Block, In, MatchLength))
+      return false;
+    MatchLength += LZMinimumMatch;
+    if (Distance == 0 || Distance > Produced || MatchLength > Size - Produced)
+      return false;
+    if (Out) {
+      char* Target = Out + Produced;
+      const char* Source = Target - Distance;
+      if (Distance >= MatchLength)
+        std::memcpy(Target, Source, MatchLength);
+      else
+        for (size_t i = 0; i < MatchLength; i++)
+          Target[i] = Source[i];
+    }
+    Produced += MatchLength;
+  }
+  return Produced == Size;
+}
+}
+
+// Greedy: each position looks up the last position with the same four
+// bytes, and a match is taken as far as it goes.
+std::string LZCompress(std::string_view Bytes) {
+  std::string Out;
+  Out.reserve(Bytes.size() / 2 + 16);
+  std::vector<uint32_t> Table(size_t{1} << HashBits, UINT32_MAX);
+  const char* Data = Bytes.data();
+  size_t Size = Bytes.size();
+  size_t Anchor = 0;
+  size_t i = 0;
+  while (Size >= LZMinimumMatch && i <= Size - LZMinimumMatch) {
+    uint32_t V = Load32(Data + i);
+    uint32_t& Slot = Table[HashOf(V)];
+    size_t Candidate = Slot;
+    Slot = static_cast<uint32_t>(i);
+    if (Candidate == UINT32_MAX || i - Candidate > MaximumDistance || Load32(Data + Candidate) != V) {
+      i++;
+      continue;
+    }
+    size_t Length = LZMinimumMatch;
+    while (i + Length < Size && Data[Candidate + Length] == Data[i + Length])
+      Length++;
+    PutSequence(Out, Bytes.substr(Anchor, i - Anchor), i - Candidate, Length);
+    i += Length;
+    Anchor = i;
+  }
+  PutSequence(Out, Bytes.substr(Anchor), 0, 0);
+  return Out;
+}
+
+bool LZValidate(std::string_view Block, size_t Size) {
+  return Decode(Block, nullptr, Size);
+}
+
+bool LZDecompress(std::string_view Block, char* Out, size_t Size) {
+  return Decode(Block, Out, Size);
+}
+
+bool CompressSegment(Segment& S) {
+  if (S.Compressed() || S.Length <= 0 || HexDataSize(S) != 2 * static_cast<size_t>(S.Length))
+    return false;
+  std::string Bytes;
+  if (S.Data.empty()) {
+    Bytes = S.RawData;
+  } else {
+    Bytes.resize(static_cast<size_t>(S.Length));
+    ReadHexBytes(&Bytes[0], S.Data);
+  }
+  std::string Block = LZCompress(Bytes);
+  if (Block.size() >= Bytes.size())
+    return false;
+  S.CompressedData = std::move(Block);
+  S.CompressedSize = static_cast<int>(S.CompressedData.size());
+  S.Data.clear();
+  S.RawData = std::string_view{};
+  S.Owner.reset();
+  return true;
+}
+
+// The bytes go into the upper half of the hex, which is then expanded from
+// the front: digit pair i only overwrites bytes at or before byte i, which
+// have been read by then.
+void WriteHexDecompressed(char* Out, const Segment& S) {
+  size_t Size = static_cast<size_t>(S.Length);
+  char* Bytes = Out + Size;
+  bool Decompressed = LZDecompress(S.CompressedData, Bytes, Size);
+  assert(Decompressed && "compressed segment was not validated");
+  (void)Decompressed;
+  static const char Digits[] = "0123456789abcdef";
+  for (size_t i = 0; i < Size; i++) {
+    unsigned char B = static_cast<unsigned char>(Bytes[i]);
+    Out[2 * i] = Digits[B >> 4];
+    Out[2 * i + 1] = Digits[B & 0xf];
+  }
+}
+}
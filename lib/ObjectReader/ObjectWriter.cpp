@@ -0,0 +1,223 @@
+#include <ObjectReader/ObjectWriter.h>
+
+#include <charconv>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <Linker/Parallel.h>
+
+namespace ldl {
+
+namespace {
+size_t DigitCount(long Value, int Base) {
+  unsigned long Magnitude = Value < 0 ? 0UL - static_cast<unsigned long>(Value) : static_cast<unsigned long>(Value);
+  size_t Digits = 1;
+  while (Magnitude >= static_cast<unsigned long>(Base)) {
+    Magnitude /= static_cast<unsigned long>(Base);
+    Digits++;
+  }
+  return Digits + (Value < 0);
+}
+
+size_t HexCount(long Value) {
+  return DigitCount(Value, 16);
+}
+
+// The output is sized exactly beforehand, so there is always room.
+char* PutNumber(char* Out, long Value, int Base) {
+  return std::to_chars(Out, Out + 24, Value, Base).ptr;
+}
+
+char* PutHex(char* Out, long Value) {
+  return PutNumber(Out, Value, 16);
+}
+
+char* PutText(char* Out, std::string_view Text) {
+  std::memcpy(Out, Text.data(), Text.size());
+  return Out + Text.size();
+}
+
+// Segments read from binary inputs keep their bytes in RawData, and
+// compressed segments are written as their blocks.
+size_t DataLength(const Segment& S) {
+  if (S.Compressed())
+    return 2 * S.CompressedData.size();
+  return S.Data.empty() ? 2 * S.RawData.size() : S.Data.size();
+}
+}
+
+std::string ObjectFile::GenerateTextRepresentation() const {
+  return ObjectWriter{*this}.Text();
+}
+
+size_t ObjectWriter::NumberOfLines() const {
+  return 1 + 2 * OF.Segments.size() + OF.Symbols.size() + OF.Relocations.size();
+}
+
+size_t ObjectWriter::LineLength(size_t Line) const {
+  if (Line == 0)
+    return OF.FH.Magic.size() + 1 + DigitCount(OF.FH.NumberOfSegments, 10) + 1
+      + DigitCount(OF.FH.NumberOfSymbols, 10) + 1 + DigitCount(OF.FH.NumberOfRelocations, 10) + 1;
+  Line--;
+
+  if (Line < OF.Segments.size()) {
+    const Segment& S = OF.Segments[Line];
+    size_t Length = S.Name.size() + 1 + HexCount(S.Address) + 1 + HexCount(S.Length) + 1 + S.Code.size() + 1;
+    if (!S.Group.empty())
+      Length += 3 + S.Group.size();
+    if (S.MergeStrings)
+      Length += 4;
+    else if (S.MergeEntrySize > 0)
+      Length += 3 + HexCount(S.MergeEntrySize);
+    if (S.Alignment != 4)
+      Length += 3 + HexCount(S.Alignment);
+    if (S.Compressed())
+      Length += 3 + HexCount(S.CompressedSize);
+    return Length;
+  }
+  Line -= OF.Segments.size();
+
+  auto& Symbols = OF.Symbols;
+  if (Line < Symbols.size())
+    return Symbols.NameLengths[Line] + 1 + HexCount(Symbols.Values[Line]) + 1
+      + HexCount(Symbols.SegmentNumbers[Line]) + 1 + Symbols.TypeName(Line).size() + 1;
+  Line -= Symbols.size();
+
+  auto& Relocations = OF.Relocations;
+  if (Line < Relocations.size())
+    return HexCount(Relocations.Locations[Line]) + 1 + HexCount(Relocations.SegmentNumbers[Line]) + 1
+      + HexCount(Relocations.Refs[Line]) + 1 + Relocations.TypeName(Line).size()
+      + (Relocations.Addends[Line] != 0 ? 1 + HexCount(Relocations.Addends[Line]) : 0) + 1;
+  Line -= Relocations.size();
+
+  return DataLength(OF.Segments[Line]) + 1;
+}
+
+void ObjectWriter::RenderLine(size_t Line, char* Out) const {
+  if (Line == 0) {
+    Out = PutText(Out, OF.FH.Magic);
+    *Out++ = '\n';
+    Out = PutNumber(Out, OF.FH.NumberOfSegments, 10);
+    *Out++ = ' ';
+    Out = PutNumber(Out, OF.FH.NumberOfSymbols, 10);
+    *Out++ = ' ';
+    Out = PutNumber(Out, OF.FH.NumberOfRelocations, 10);
+    *Out = '\n';
+    return;
+  }
+  Line--;
+
+  if (Line < OF.Segments.size()) {
+    const Segment& S = OF.Segments[Line];
+    Out = PutText(Out, S.Name);
+    *Out++ = ' ';
+    Out = PutHex(Out, S.Address);
+    *Out++ = ' ';
+    Out = PutHex(Out, S.Length);
+    *Out++ = ' ';
+    Out = PutText(Out, S.Code);
+    if (!S.Group.empty()) {
+      Out = PutText(Out, " G=");
+      Out = PutText(Out, S.Group);
+    }
+    if (S.MergeStrings) {
+      Out = PutText(Out, " M=S");
+    } else if (S.MergeEntrySize > 0) {
+      Out = PutText(Out, " M=");
+      Out = PutHex(Out, S.MergeEntrySize);
+    }
+    if (S.Alignment != 4) {
+      Out = PutText(Out, " A=");
+      Out = PutHex(Out, S.Alignment);
+    }
+    if (S.Compressed()) {
+      Out = PutText(Out, " Z=");
+      Out = PutHex(Out, S.CompressedSize);
+    }
+    *Out = '\n';
+    return;
+  }
+  Line -= OF.Segments.size();
+
+  auto& Symbols = OF.Symbols;
+  if (Line < Symbols.size()) {
+    Out = PutText(Out, Symbols.Name(Line));
+    *Out++ = ' ';
+    Out = PutHex(Out, Symbols.Values[Line]);
+    *Out++ = ' ';
+    Out = PutHex(Out, Symbols.SegmentNumbers[Line]);
+    *Out++ = ' ';
+    Out = PutText(Out, Symbols.TypeName(Line));
+    *Out = '\n';
+    return;
+  }
+  Line -= Symbols.size();
+
+  auto& Relocations = OF.Relocations;
+  if (Line < Relocations.size()) {
+    Out = PutHex(Out, Relocations.Locations[Line]);
+    *Out++ = ' ';
+    Out = PutHex(Out, Relocations.SegmentNumbers[Line]);
+    *Out++ = ' ';
+    Out = PutHex(Out, Relocations.Refs[Line]);
+    *Out++ = ' ';
+    Out = PutText(Out, Relocations.TypeName(Line));
+    if (Relocations.Addends[Line] != 0) {
+      *Out++ = ' ';
+      Out = PutHex(Out, Relocations.Addends[Line]);
+    }
+    *Out = '\n';
+    return;
+  }
+  Line -= Relocations.size();
+
+  const Segment& S = OF.Segments[Line];
+  if (S.Compressed()) {
+    WriteHexBytes(Out, S.CompressedData);
+    Out += 2 * S.CompressedData.size();
+  } else if (S.Data.empty()) {
+    WriteHexBytes(Out, S.RawData);
+    Out += 2 * S.RawData.size();
+  } else {
+    Out = PutText(Out, S.Data);
+  }
+  *Out = '\n';
+}
+
+std::string ObjectWriter::Text() const {
+  size_t N = NumberOfLines();
+  std::vector<size_t> Offsets(N);
+  ParallelFor(N, [&](size_t Line) {
+    Offsets[Line] = LineLength(Line);
+  });
+  ParallelExclusiveScan(Offsets);
+
+  std::string Out(Offsets.back(), '\0');
+  ParallelFor(N, [&](size_t Line) {
+    RenderLine(Line, &Out[Offsets[Line]]);
+  });
+  return Out;
+}
+
+bool ObjectWriter::Write(const std::string& FileName) const {
+  return WriteText(FileName, Text());
+}
+
+bool ObjectWriter::WriteText(const std::string& FileName, std::string_view Out) {
+  int FD = open(FileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (FD < 0)
+    return false;
+  size_t Written = 0;
+  while (Written < Out.size()) {
+    ssize_t Result = write(FD, Out.data() + Written, Out.size() - Written);
+    if (Result <= 0) {
+      close(FD);
+      return false;
+    }
+    Written += static_cast<size_t>(Result);
+  }
+  return close(FD) == 0;
+}
+}
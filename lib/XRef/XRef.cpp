@@ -0,0 +1,365 @@
+#include <XRef/XRef.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <Linker/Linker.h>
+#include <Linker/ObjectCache.h>
+#include <Linker/Parallel.h>
+
+namespace ldl {
+
+namespace {
+// A posting with its name, in index order.
+class Row {
+public:
+  std::string_view Name;
+  XRefKind Kind;
+  uint32_t File;
+  uint32_t Segment;
+};
+
+bool operator<(const Row& A, const Row& B) {
+  return std::tie(A.Name, A.Kind, A.File, A.Segment) < std::tie(B.Name, B.Kind, B.File, B.Segment);
+}
+
+// Lays out the index of Files, whose postings are Rows.
+std::string Serialize(const std::vector<XRefFile>& Files, const std::vector<Row>& Rows) {
+  using Header = XRefIndex::Header;
+  using FileRecord = XRefIndex::FileRecord;
+  using SegmentRecord = XRefIndex::SegmentRecord;
+  using NameRecord = XRefIndex::NameRecord;
+  using PostingRecord = XRefIndex::PostingRecord;
+  size_t NumberOfSegments = 0;
+  for (auto& F : Files)
+    NumberOfSegments += F.Segments.size();
+
+  // Paths and segment names repeat, so the pool keeps each once. Names are
+  // unique and go in as they are.
+  std::string Pool;
+  std::unordered_map<std::string_view, uint32_t> Pooled;
+  auto Intern = [&](std::string_view S) {
+    auto It = Pooled.find(S);
+    if (It != Pooled.end())
+      return It->second;
+    uint32_t Offset = static_cast<uint32_t>(Pool.size());
+    Pool.append(S);
+    Pooled.emplace(S, Offset);
+    return Offset;
+  };
+
+  std::vector<FileRecord> FileRecords;
+  std::vector<SegmentRecord> SegmentRecords;
+  SegmentRecords.reserve(NumberOfSegments);
+  for (auto& F : Files) {
+    FileRecord R{F.ModificationTime, F.Size, F.Hash, Intern(F.FileName), static_cast<uint32_t>(F.FileName.size()),
+      static_cast<uint32_t>(SegmentRecords.size()), static_cast<uint32_t>(F.Segments.size())};
+    FileRecords.push_back(R);
+    for (auto& S : F.Segments)
+      SegmentRecords.push_back(SegmentRecord{Intern(S), static_cast<uint32_t>(S.size())});
+  }
+
+  std::vector<NameRecord> NameRecords;
+  std::vector<PostingRecord> PostingRecords;
+  PostingRecords.reserve(Rows.size());
+  for (size_t i = 0; i < Rows.size(); i++) {
+    if (i == 0 || Rows[i].Name != Rows[i - 1].Name) {
+      NameRecords.push_back(NameRecord{static_cast<uint32_t>(Pool.size()), static_cast<uint32_t>(Rows[i].Name.size()),
+        static_cast<uint32_t>(i), 0});
+      Pool.append(Rows[i].Name);
+    }
+    NameRecords.back().NumberOfPostings++;
+    PostingRecords.push_back(PostingRecord{Rows[i].File, Rows[i].Segment, Rows[i].Kind});
+  }
+
+  Header Head{};
+  std::memcpy(Head.Magic, XRefIndex::Magic, sizeof(XRefIndex::Magic));
+  Head.Version = XRefIndex::Version;
+  Head.NumberOfFiles = static_cast<uint32_t>(FileRecords.size());
+  Head.NumberOfSegments = static_cast<uint32_t>(SegmentRecords.size());
+  Head.NumberOfNames = static_cast<uint32_t>(NameRecords.size());
+  Head.NumberOfPostings = static_cast<uint32_t>(PostingRecords.size());
+  Head.StringPoolSize = Pool.size();
+
+  std::string Out;
+  Out.reserve(sizeof(Header) + FileRecords.size() * sizeof(FileRecord) + SegmentRecords.size() * sizeof(SegmentRecord)
+    + NameRecords.size() * sizeof(NameRecord) + PostingRecords.size() * sizeof(PostingRecord) + Pool.size());
+  auto Append = [&](const void* Data, size_t Size) {
+    Out.append(static_cast<const char*>(Data), Size);
+  };
+  Append(&Head, sizeof(Head));
+  Append(FileRecords.data(), FileRecords.size() * sizeof(FileRecord));
+  Append(SegmentRecords.data(), SegmentRecords.size() * sizeof(SegmentRecord));
+  Append(NameRecords.data(), NameRecords.size() * sizeof(NameRecord));
+  Append(PostingRecords.data(), PostingRecords.size() * sizeof(PostingRecord));
+  Out.append(Pool);
+  return Out;
+}
+}
+
+const char* XRefKindName(XRefKind Kind) {
+  switch (Kind) {
+  case XRefKind::Definition: return "defines";
+  case XRefKind::Common: return "common";
+  case XRefKind::Reference: return "references";
+  }
+  return "unknown";
+}
+
+void XRefFile::Read() {
+  ObjectFilePtr OF = ReadObjectFile(FileName);
+  Segments.clear();
+  Entries.clear();
+  for (auto& S : OF->Segments)
+    Segments.push_back(S.Name);
+  auto SegmentIndex = [&](int SegmentNumber) {
+    return SegmentNumber >= 1 && static_cast<size_t>(SegmentNumber) <= Segments.size()
+      ? static_cast<uint32_t>(SegmentNumber) : 0;
+  };
+
+  const SymbolTable& Symbols = OF->Symbols;
+  std::vector<bool> Referenced(Symbols.size());
+  const RelocationTable& Relocations = OF->Relocations;
+  for (size_t r = 0; r < Relocations.size(); r++) {
+    RelocationType Type = Relocations.Types[r];
+    int Ref = Relocations.Refs[r];
+    if (Type == RelocationType::A4 || Type == RelocationType::R4 || Type == RelocationType::Unknown
+      || Ref < 1 || static_cast<size_t>(Ref) > Symbols.size())
+      continue;
+    SymbolType SymbolKind = Symbols.Types[Ref - 1];
+    if (!IsGlobalDefinition(SymbolKind) && SymbolKind != SymbolType::Undefined
+      && SymbolKind != SymbolType::WeakUndefined)
+      continue;
+    Referenced[Ref - 1] = true;
+    Entries.push_back(Entry{std::string{Symbols.Name(Ref - 1)}, SegmentIndex(Relocations.SegmentNumbers[r]), XRefKind::Reference});
+  }
+
+  for (size_t Row = 0; Row < Symbols.size(); Row++) {
+    SymbolType Type = Symbols.Types[Row];
+    if (IsGlobalDefinition(Type))
+      Entries.push_back(Entry{std::string{Symbols.Name(Row)}, SegmentIndex(Symbols.SegmentNumbers[Row]), XRefKind::Definition});
+    else if (Type == SymbolType::Undefined && Symbols.Values[Row] != 0)
+      Entries.push_back(Entry{std::string{Symbols.Name(Row)}, 0, XRefKind::Common});
+    else if ((Type == SymbolType::Undefined || Type == SymbolType::WeakUndefined) && !Referenced[Row])
+      Entries.push_back(Entry{std::string{Symbols.Name(Row)}, 0, XRefKind::Reference});
+  }
+
+  auto Key = [](const Entry& E) { return std::tie(E.Name, E.Kind, E.Segment); };
+  std::sort(Entries.begin(), Entries.end(), [&](const Entry& A, const Entry& B) { return Key(A) < Key(B); });
+  Entries.erase(std::unique(Entries.begin(), Entries.end(), [&](const Entry& A, const Entry& B) {
+    return Key(A) == Key(B);
+  }), Entries.end());
+}
+
+XRefIndex::XRefIndex(const std::string& FileName) :Mapping{std::make_shared<MappedFile>(FileName)} {
+  const unsigned char* Bytes = Mapping->Bytes;
+  if (Mapping->Size < sizeof(Header))
+    throw "Cross-reference index is truncated";
+  H = reinterpret_cast<const Header*>(Bytes);
+  if (std::memcmp(H->Magic, Magic, sizeof(Magic)) != 0 || H->Version != Version)
+    throw "Not a cross-reference index";
+
+  uint64_t Offset = sizeof(Header);
+  Files = reinterpret_cast<const FileRecord*>(Bytes + Offset);
+  Offset += uint64_t{H->NumberOfFiles} * sizeof(FileRecord);
+  Segments = reinterpret_cast<const SegmentRecord*>(Bytes + Offset);
+  Offset += uint64_t{H->NumberOfSegments} * sizeof(SegmentRecord);
+  Names = reinterpret_cast<const NameRecord*>(Bytes + Offset);
+  Offset += uint64_t{H->NumberOfNames} * sizeof(NameRecord);
+  Postings = reinterpret_cast<const PostingRecord*>(Bytes + Offset);
+  Offset += uint64_t{H->NumberOfPostings} * sizeof(PostingRecord);
+  Strings = reinterpret_cast<const char*>(Bytes + Offset);
+  if (Offset + H->StringPoolSize != Mapping->Size)
+    throw "Cross-reference index is truncated";
+
+  // Every record is checked once here, so that lookups and updates can
+  // follow the offsets they hold without checking them again.
+  auto InPool = [&](uint32_t Offset, uint32_t Length) {
+    return uint64_t{Offset} + Length <= H->StringPoolSize;
+  };
+  for (uint32_t i = 0; i < H->NumberOfFiles; i++)
+    if (!InPool(Files[i].Path, Files[i].PathLength)
+      || uint64_t{Files[i].FirstSegment} + Files[i].NumberOfSegments > H->NumberOfSegments)
+      throw "Cross-reference index is corrupt";
+  for (uint32_t i = 0; i < H->NumberOfSegments; i++)
+    if (!InPool(Segments[i].Name, Segments[i].NameLength))
+      throw "Cross-reference index is corrupt";
+  for (uint32_t i = 0; i < H->NumberOfNames; i++)
+    if (!InPool(Names[i].Name, Names[i].NameLength)
+      || uint64_t{Names[i].FirstPosting} + Names[i].NumberOfPostings > H->NumberOfPostings)
+      throw "Cross-reference index is corrupt";
+  for (uint32_t i = 0; i < H->NumberOfPostings; i++)
+    if (Postings[i].File >= H->NumberOfFiles || Postings[i].Segment > Files[Postings[i].File].NumberOfSegments
+      || Postings[i].Kind > XRefKind::Reference)
+      throw "Cross-reference index is corrupt";
+}
+
+std::vector<XRefIndex::Posting> XRefIndex::Lookup(std::string_view Name) const {
+  std::vector<Posting> Found;
+  const NameRecord* End = Names + H->NumberOfNames;
+  const NameRecord* It = std::lower_bound(Names, End, Name, [&](const NameRecord& N, std::string_view Name) {
+    return String(N.Name, N.NameLength) < Name;
+  });
+  if (It == End || String(It->Name, It->NameLength) != Name)
+    return Found;
+  for (uint32_t i = It->FirstPosting; i < It->FirstPosting + It->NumberOfPostings; i++) {
+    const PostingRecord& P = Postings[i];
+    const FileRecord& F = Files[P.File];
+    std::string_view Segment;
+    if (P.Segment != 0) {
+      const SegmentRecord& S = Segments[F.FirstSegment + P.Segment - 1];
+      Segment = String(S.Name, S.NameLength);
+    }
+    Found.push_back(Posting{P.Kind, String(F.Path, F.PathLength), Segment});
+  }
+  return Found;
+}
+
+void XRefBuilder::Load(const std::string& IndexFileName) {
+  Base = std::make_shared<const XRefIndex>(IndexFileName);
+  Files.assign(Base->NumberOfFiles(), XRefFile{});
+  BaseFiles.resize(Files.size());
+  for (uint32_t i = 0; i < Files.size(); i++) {
+    const XRefIndex::FileRecord& F = Base->Files[i];
+    XRefFile& File = Files[i];
+    File.FileName = Base->String(F.Path, F.PathLength);
+    File.ModificationTime = F.ModificationTime;
+    File.Size = F.Size;
+    File.Hash = F.Hash;
+    for (uint32_t s = 0; s < F.NumberOfSegments; s++) {
+      const XRefIndex::SegmentRecord& S = Base->Segments[F.FirstSegment + s];
+      File.Segments.emplace_back(Base->String(S.Name, S.NameLength));
+    }
+    BaseFiles[i] = i;
+  }
+}
+
+void XRefBuilder::Update(const std::vector<std::string>& FileNames) {
+  std::map<std::string, size_t> Previous;
+  for (size_t i = 0; i < Files.size(); i++)
+    Previous[Files[i].FileName] = i;
+  BaseFiles.resize(Files.size(), NotInBase);
+
+  std::vector<XRefFile> Next(FileNames.size());
+  std::vector<uint32_t> NextBaseFiles(FileNames.size(), NotInBase);
+  std::vector<size_t> Stale;
+  Read = 0;
+  Reused = 0;
+  for (size_t i = 0; i < FileNames.size(); i++) {
+    XRefFile& F = Next[i];
+    F.FileName = FileNames[i];
+    struct stat ST;
+    if (stat(F.FileName.c_str(), &ST) != 0)
+      throw "Could not stat an indexed file";
+    F.ModificationTime = static_cast<int64_t>(ST.st_mtim.tv_sec) * 1000000000 + ST.st_mtim.tv_nsec;
+    F.Size = static_cast<int64_t>(ST.st_size);
+
+    // A file named twice is read again the second time.
+    auto It = Previous.find(F.FileName);
+    XRefFile* Old = nullptr;
+    if (It != Previous.end()) {
+      Old = &Files[It->second];
+      NextBaseFiles[i] = BaseFiles[It->second];
+      Previous.erase(It);
+    }
+    if (Old && Old->ModificationTime == F.ModificationTime && Old->Size == F.Size) {
+      F = std::move(*Old);
+      Reused++;
+      continue;
+    }
+    F.Hash = ObjectCache::HashFile(F.FileName);
+    if (Old && Old->Size == F.Size && Old->Hash == F.Hash) {
+      F.Segments = std::move(Old->Segments);
+      F.Entries = std::move(Old->Entries);
+      Reused++;
+      continue;
+    }
+    NextBaseFiles[i] = NotInBase;
+    Stale.push_back(i);
+  }
+
+  // Reading dominates; every file is a separate piece of work.
+  std::vector<const char*> Errors(Stale.size(), nullptr);
+  ParallelForChunks(Stale.size(), std::min(ParallelThreadCount(), Stale.size()), [&](size_t, size_t Begin, size_t End) {
+    for (size_t i = Begin; i < End; i++) {
+      try {
+        Next[Stale[i]].Read();
+      } catch (const char* Message) {
+        Errors[i] = Message;
+      }
+    }
+  });
+  for (auto* Message : Errors)
+    if (Message)
+      throw Message;
+  Read = Stale.size();
+  Files = std::move(Next);
+  BaseFiles = std::move(NextBaseFiles);
+}
+
+std::string XRefBuilder::Build() const {
+  std::vector<Row> Fresh;
+  for (size_t f = 0; f < Files.size(); f++)
+    if (f >= BaseFiles.size() || BaseFiles[f] == NotInBase)
+      for (auto& E : Files[f].Entries)
+        Fresh.push_back(Row{E.Name, E.Kind, static_cast<uint32_t>(f), E.Segment});
+  std::sort(Fresh.begin(), Fresh.end());
+  if (!Base)
+    return Serialize(Files, Fresh);
+
+  std::vector<uint32_t> Renumbered(Base->NumberOfFiles(), NotInBase);
+  for (size_t f = 0; f < Files.size() && f < BaseFiles.size(); f++)
+    if (BaseFiles[f] != NotInBase)
+      Renumbered[BaseFiles[f]] = static_cast<uint32_t>(f);
+
+  // Each name of the old index takes the fresh rows of smaller names
+  // first. Its own postings are sorted again, since files can move.
+  std::vector<Row> Rows;
+  Rows.reserve(Base->NumberOfPostings() + Fresh.size());
+  size_t Next = 0;
+  for (uint32_t n = 0; n < Base->NumberOfNames(); n++) {
+    const XRefIndex::NameRecord& N = Base->Names[n];
+    std::string_view Name = Base->String(N.Name, N.NameLength);
+    while (Next < Fresh.size() && Fresh[Next].Name < Name)
+      Rows.push_back(Fresh[Next++]);
+    size_t Begin = Rows.size();
+    for (uint32_t i = N.FirstPosting; i < N.FirstPosting + N.NumberOfPostings; i++) {
+      const XRefIndex::PostingRecord& P = Base->Postings[i];
+      if (Renumbered[P.File] != NotInBase)
+        Rows.push_back(Row{Name, P.Kind, Renumbered[P.File], P.Segment});
+    }
+    while (Next < Fresh.size() && Fresh[Next].Name == Name)
+      Rows.push_back(Fresh[Next++]);
+    std::sort(Rows.begin() + Begin, Rows.end());
+  }
+  Rows.insert(Rows.end(), Fresh.begin() + Next, Fresh.end());
+  return Serialize(Files, Rows);
+}
+
+bool XRefBuilder::Write(const std::string& FileName) const {
+  std::string Index = Build();
+  // A unique name, so that concurrent writers do not share a temporary.
+  std::string Temporary = FileName + ".XXXXXX";
+  int FD = mkstemp(&Temporary[0]);
+  if (FD < 0)
+    return false;
+  bool Written = fchmod(FD, 0644) == 0;
+  for (size_t Offset = 0; Written && Offset < Index.size();) {
+    ssize_t N = write(FD, Index.data() + Offset, Index.size() - Offset);
+    Written = N > 0;
+    Offset += Written ? static_cast<size_t>(N) : 0;
+  }
+  Written = close(FD) == 0 && Written;
+  if (Written && std::rename(Temporary.c_str(), FileName.c_str()) == 0)
+    return true;
+  unlink(Temporary.c_str());
+  return false;
+}
+}
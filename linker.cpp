@@ -1,6 +1,42 @@
 #include <iostream>
+#include <string>
+#include <vector>
+
+#include <Driver/Driver.h>
+#include <LinkServer/LinkServer.h>
 
 int main(int argc, const char **argv) {
-    std::cout << "Hello, world!" << std::endl;
-    return 0;
+  std::vector<std::string> Args(argv + 1, argv + argc);
+  ldl::LinkOptions Options;
+  if (!ldl::ParseLinkOptions(Args, Options, std::cerr)) {
+    ldl::PrintUsage(std::cerr);
+    return 1;
+  }
+
+  try {
+    if (!Options.ServerSocket.empty()) {
+      ldl::LinkServer Server{Options.ServerSocket};
+      Server.Listen();
+      Server.Serve();
+      return 0;
+    }
+
+    if (!Options.ConnectSocket.empty()) {
+      std::vector<std::string> Forwarded;
+      for (size_t i = 0; i < Args.size(); i++) {
+        if (Args[i] == "--connect") {
+          i++;
+          continue;
+        }
+        Forwarded.push_back(Args[i]);
+      }
+      return ldl::ForwardToLinkServer(Options.ConnectSocket, Forwarded, std::cerr);
+    }
+  } catch (const char* Message) {
+    std::cerr << "linker: " << Message << std::endl;
+    return 1;
+  }
+
+  ldl::Linker L;
+  return ldl::RunLink(Options, L, std::cerr);
 }
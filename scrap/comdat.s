@@ -0,0 +1,12 @@
+	.section	.text.inline,"axG",@progbits,inline,comdat
+	.globl	inline
+	.type	inline, @function
+inline:
+	movl	$42, %eax
+	ret
+	.text
+	.globl	unique
+	.type	unique, @function
+unique:
+	call	inline
+	ret
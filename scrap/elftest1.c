@@ -0,0 +1,13 @@
+int counter = 3;
+int table[16] = {0};
+int shared_common;
+
+extern int helper(int);
+
+const char *greeting(void) { return "hello"; }
+
+int entry(int x) {
+  counter += helper(x);
+  table[x & 15] = counter;
+  return counter + shared_common;
+}
@@ -0,0 +1,3 @@
+int shared_common;
+
+int helper(int x) { return x * 2 + shared_common; }
@@ -0,0 +1,7 @@
+# Built with: as -o exit42.o exit42.s
+  .text
+  .globl _start
+_start:
+  movl $60, %eax
+  movl $42, %edi
+  syscall
@@ -0,0 +1,13 @@
+	.text
+	.globl	_start
+_start:
+	call	answer
+	movl	%eax, %edi
+	movzbl	greeting+1(%rip), %eax
+	addl	%eax, %edi
+	movl	$60, %eax
+	syscall
+
+	.section	.rodata.str1.1,"aMS",@progbits,1
+greeting:
+	.string	"hi"
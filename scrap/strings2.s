@@ -0,0 +1,17 @@
+	.text
+	.globl	answer
+answer:
+	movl	value(%rip), %eax
+	movq	$other, %rcx
+	movzbl	(%rcx), %ecx
+	subl	%ecx, %eax
+	ret
+
+	.data
+value:
+	.long	'h' + 5
+
+	.section	.rodata.str1.1,"aMS",@progbits,1
+	.string	"xx"
+other:
+	.string	"hi"
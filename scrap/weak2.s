@@ -0,0 +1,5 @@
+	.text
+	.globl	answer
+answer:
+	movl	$42, %eax
+	ret
@@ -0,0 +1,5 @@
+	.text
+	.weak	answer
+answer:
+	movl	$7, %eax
+	ret
@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <ElfReader/ElfReader.h>
+#include <Linker/Linker.h>
+
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+
+// Built with: gcc -c -O1 -fno-pic -fno-asynchronous-unwind-tables
+//             -fno-stack-protector -fcommon
+std::string ElfTest1 = "/Users/lanza/Projects/ldl/scrap/elftest1.o";
+std::string ElfTest2 = "/Users/lanza/Projects/ldl/scrap/elftest2.o";
+
+using namespace testing;
+
+TEST(ElfReader, RecognizesElfFiles) {
+  EXPECT_THAT(ldl::ElfReader::IsElfFile(ElfTest1), Eq(true));
+  EXPECT_THAT(ldl::ElfReader::IsElfFile("/Users/lanza/Projects/ldl/scrap/sample.pof"), Eq(false));
+}
+
+TEST(ElfReader, RejectsNonElfFiles) {
+  ldl::ElfReader ER{"/Users/lanza/Projects/ldl/scrap/sample.pof"};
+  EXPECT_THAT(ER.ReadFileHeader(), Eq(false));
+}
+
+TEST(ElfReader, ReadsFileHeader) {
+  ldl::ElfReader ER{ElfTest1};
+  EXPECT_THAT(ER.ReadFile(), Eq(true));
+
+  EXPECT_THAT(ER.FH.Magic, Eq("LINK"));
+  EXPECT_THAT(ER.FH.NumberOfSegments, Eq(4));
+  EXPECT_THAT(ER.FH.NumberOfSymbols, Eq(7));
+  EXPECT_THAT(ER.FH.NumberOfRelocations, Eq(6));
+}
+
+TEST(ElfReader, ReadsAllocatedSectionsAsSegments) {
+  ldl::ElfReader ER{ElfTest1};
+  ER.ReadFileHeader();
+  EXPECT_THAT(ER.ReadSegmentHeaders(), Eq(true));
+
+  ASSERT_THAT(ER.Segments.size(), Eq(4));
+  EXPECT_THAT(ER.Segments[0].Name, Eq(".text"));
+  EXPECT_THAT(ER.Segments[0].Code, Eq("RP"));
+  EXPECT_THAT(ER.Segments[0].Length, Eq(0x2c));
+  EXPECT_THAT(ER.Segments[1].Name, Eq(".data"));
+  EXPECT_THAT(ER.Segments[1].Code, Eq("RWP"));
+  EXPECT_THAT(ER.Segments[1].Length, Eq(0x4));
+  EXPECT_THAT(ER.Segments[2].Name, Eq(".bss"));
+  EXPECT_THAT(ER.Segments[2].Code, Eq("RW"));
+  EXPECT_THAT(ER.Segments[2].Length, Eq(0x40));
+  EXPECT_THAT(ER.Segments[3].Name, Eq(".rodata.str1.1"));
+  EXPECT_THAT(ER.Segments[3].Code, Eq("RP"));
+}
+
+TEST(ElfReader, DoesNotCopySegmentBytes) {
+  ldl::ElfReader ER{ElfTest1};
+  ER.ReadFileHeader();
+  ER.ReadSegmentHeaders();
+
+  auto Begin = reinterpret_cast<const char*>(ER.Mapping->Bytes);
+  auto End = Begin + ER.Mapping->Size;
+  for (auto& S : ER.Segments) {
+    EXPECT_THAT(S.Data.empty(), Eq(true));
+    if (S.Code == "RW") {
+      EXPECT_THAT(S.RawData.empty(), Eq(true));
+      continue;
+    }
+    EXPECT_THAT(S.RawData.size(), Eq(static_cast<size_t>(S.Length)));
+    EXPECT_THAT(S.RawData.data() >= Begin && S.RawData.data() + S.RawData.size() <= End, Eq(true));
+  }
+  EXPECT_THAT(ER.Segments[3].RawData, Eq(std::string_view("hello\0", 6)));
+}
+
+TEST(ElfReader, ReadsSymbolTable) {
+  ldl::ElfReader ER{ElfTest1};
+  ER.ReadFileHeader();
+  ER.ReadSegmentHeaders();
+  EXPECT_THAT(ER.ReadSymbolTable(), Eq(true));
+
+  ASSERT_THAT(ER.Symbols.size(), Eq(7));
+
+  ldl::Symbol Section = ER.Symbols[0];
+  EXPECT_THAT(Section.Name, Eq(".rodata.str1.1"));
+  EXPECT_THAT(Section.Type, Eq("L"));
+  EXPECT_THAT(Section.SegmentNumber, Eq(4));
+
+  ldl::Symbol Entry = ER.Symbols[2];
+  EXPECT_THAT(Entry.Name, Eq("entry"));
+  EXPECT_THAT(Entry.Value, Eq(0x6));
+  EXPECT_THAT(Entry.SegmentNumber, Eq(1));
+  EXPECT_THAT(Entry.Type, Eq("D"));
+
+  ldl::Symbol Helper = ER.Symbols[3];
+  EXPECT_THAT(Helper.Name, Eq("helper"));
+  EXPECT_THAT(Helper.Type, Eq("U"));
+  EXPECT_THAT(Helper.Value, Eq(0));
+
+  ldl::Symbol Common = ER.Symbols[6];
+  EXPECT_THAT(Common.Name, Eq("shared_common"));
+  EXPECT_THAT(Common.Type, Eq("U"));
+  EXPECT_THAT(Common.Value, Eq(4));
+}
+
+TEST(ElfReader, ReadsWeakSymbols) {
+  ldl::ElfReader ER{"/Users/lanza/Projects/ldl/scrap/weak1.o"};
+  ER.ReadFileHeader();
+  ER.ReadSegmentHeaders();
+  ASSERT_THAT(ER.ReadSymbolTable(), Eq(true));
+
+  ASSERT_THAT(ER.Symbols.size(), Eq(3));
+  EXPECT_THAT(ER.Symbols[0].Type, Eq("D"));
+  EXPECT_THAT(ER.Symbols[1].Name, Eq("answer"));
+  EXPECT_THAT(ER.Symbols[1].Type, Eq("W"));
+  EXPECT_THAT(ER.Symbols[2].Name, Eq("optional"));
+  EXPECT_THAT(ER.Symbols[2].Type, Eq("w"));
+}
+
+TEST(ElfReader, ReadsRelocations) {
+  ldl::ElfReader ER{ElfTest1};
+  ER.ReadFileHeader();
+  ER.ReadSegmentHeaders();
+  ER.ReadSymbolTable();
+  EXPECT_THAT(ER.ReadRelocations(), Eq(true));
+
+  ASSERT_THAT(ER.Relocations.size(), Eq(6));
+
+  ldl::Relocation String = ER.Relocations[0];
+  EXPECT_THAT(String.Location, Eq(0x1));
+  EXPECT_THAT(String.SegmentNumber, Eq(1));
+  EXPECT_THAT(String.Ref, Eq(1));
+  EXPECT_THAT(String.Type, Eq("AS4"));
+  EXPECT_THAT(String.Addend, Eq(0));
+
+  ldl::Relocation Call = ER.Relocations[1];
+  EXPECT_THAT(Call.Location, Eq(0xa));
+  EXPECT_THAT(Call.Ref, Eq(4));
+  EXPECT_THAT(Call.Type, Eq("RS4"));
+  EXPECT_THAT(Call.Addend, Eq(-4));
+}
+
+TEST(ElfReader, DropsRejectedComdatGroups) {
+  ldl::ElfReader ER{"/Users/lanza/Projects/ldl/scrap/comdat.o"};
+  ER.KeepGroup = [](const std::string& Signature) { return Signature != "inline"; };
+  ASSERT_THAT(ER.ReadFile(), Eq(true));
+
+  ldl::Segment* Inline = nullptr;
+  for (auto& S : ER.Segments)
+    if (S.Name == ".text.inline")
+      Inline = &S;
+  ASSERT_THAT(Inline, NotNull());
+  EXPECT_THAT(Inline->Group, Eq("inline"));
+  EXPECT_THAT(Inline->Discarded, Eq(true));
+  EXPECT_THAT(Inline->RawData.empty(), Eq(true));
+  EXPECT_THAT(ER.Segments[0].Group.empty(), Eq(true));
+  EXPECT_THAT(ER.Relocations.size(), Eq(1));
+}
+
+// Offsets near the top of the address space make offset + size wrap to a
+// small number, which must not pass for a section inside the file.
+TEST(ElfReader, RejectsSectionsWhoseEndWraps) {
+  std::ifstream IFS{ElfTest1, std::ios::binary};
+  std::string Bytes((std::istreambuf_iterator<char>(IFS)), std::istreambuf_iterator<char>());
+  auto& EH = *reinterpret_cast<Elf64_Ehdr*>(&Bytes[0]);
+  auto Sections = reinterpret_cast<Elf64_Shdr*>(&Bytes[EH.e_shoff]);
+
+  for (Elf64_Word Type : {SHT_PROGBITS, SHT_SYMTAB}) {
+    std::string Corrupt = Bytes;
+    auto CorruptSections = reinterpret_cast<Elf64_Shdr*>(&Corrupt[EH.e_shoff]);
+    for (size_t i = 1; i < EH.e_shnum; i++)
+      if (Sections[i].sh_type == Type) {
+        CorruptSections[i].sh_offset = ~static_cast<Elf64_Off>(0) - 0xff;
+        CorruptSections[i].sh_size = 0x200;
+        break;
+      }
+    std::string FileName = "/tmp/ldl-elfreader-wrap-" + std::to_string(getpid()) + ".o";
+    std::ofstream{FileName, std::ios::binary} << Corrupt;
+
+    ldl::ElfReader ER{FileName};
+    ASSERT_THAT(ER.ReadFileHeader(), Eq(true));
+    bool Read = ER.ReadSegmentHeaders() && ER.ReadSymbolTable();
+    std::remove(FileName.c_str());
+    EXPECT_THAT(Read, Eq(false));
+  }
+}
+
+TEST(ElfReader, LinksElfObjects) {
+  ldl::Linker L;
+  L.FileNames = { ElfTest1, ElfTest2 };
+  L.ReadFiles();
+  L.GenerateOutputFileSymbolTable();
+  L.GenerateOutputFileSegments();
+
+  ldl::OutSegment& T = *L.TextSegment;
+  EXPECT_THAT(T.Address, Eq(0x1000));
+  EXPECT_THAT(T.ContainedSegments.size(), Eq(2));
+  EXPECT_THAT(T.ContainedSegments[1].Address, Eq(0x1000 + 0x2c));
+  EXPECT_THAT(T.Data.size() / 2, Eq(static_cast<size_t>(T.Length)));
+
+  EXPECT_THAT(L.CommonSegment.Length, Eq(0x8));
+}
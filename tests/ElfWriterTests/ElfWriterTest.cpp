@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cstdio>
+#include <sys/wait.h>
+
+#include <ElfReader/MappedFile.h>
+#include <ElfWriter/ElfWriter.h>
+#include <Linker/Linker.h>
+
+using namespace ::testing;
+
+class ElfWriterTest : public Test {
+public:
+  ldl::Linker L;
+  std::string Output = "/tmp/ldl-elfwriter-test.out";
+protected:
+  virtual void SetUp() {
+    // linkertest1.pof without its relocations, which point past its
+    // segments and could never be applied.
+    L.FileNames = {
+      "/Users/lanza/Projects/ldl/scrap/elfwritertest.pof",
+      "/Users/lanza/Projects/ldl/scrap/elfwritertest.pof"
+    };
+
+    L.ReadFiles();
+    L.GenerateObjectFile();
+  }
+
+  virtual void TearDown() {
+    std::remove(Output.c_str());
+  }
+
+  const Elf64_Ehdr& Header(ldl::MappedFile& MF) {
+    return *reinterpret_cast<const Elf64_Ehdr*>(MF.Bytes);
+  }
+  const Elf64_Phdr& ProgramHeader(ldl::MappedFile& MF, int Index) {
+    return reinterpret_cast<const Elf64_Phdr*>(MF.Bytes + Header(MF).e_phoff)[Index];
+  }
+};
+
+TEST_F(ElfWriterTest, WritesAnExecutableHeader) {
+  ldl::ElfWriter EW{L};
+  EW.EntrySymbol = "main";
+  EW.Write(Output);
+
+  ldl::MappedFile MF{Output};
+  ASSERT_THAT(MF.Size, Eq(EW.FileSize));
+
+  const Elf64_Ehdr& EH = Header(MF);
+  EXPECT_THAT(std::string(reinterpret_cast<const char*>(EH.e_ident), SELFMAG), Eq(std::string(ELFMAG)));
+  EXPECT_THAT(EH.e_type, Eq(ET_EXEC));
+  EXPECT_THAT(EH.e_machine, Eq(EM_X86_64));
+  EXPECT_THAT(EH.e_phnum, Eq(3));
+  EXPECT_THAT(EH.e_entry, Eq(0x1008u));
+}
+
+TEST_F(ElfWriterTest, MapsTextReadExecute) {
+  ldl::ElfWriter EW{L};
+  EW.EntrySymbol = "main";
+  EW.Write(Output);
+  ldl::MappedFile MF{Output};
+
+  const Elf64_Phdr& Text = ProgramHeader(MF, 0);
+  EXPECT_THAT(Text.p_type, Eq(PT_LOAD));
+  EXPECT_THAT(Text.p_flags, Eq(static_cast<Elf64_Word>(PF_R | PF_X)));
+  EXPECT_THAT(Text.p_vaddr, Eq(0x1000u));
+  EXPECT_THAT(Text.p_filesz, Eq(0x3bu + 0x1 + 0x3b));
+  EXPECT_THAT(Text.p_memsz, Eq(Text.p_filesz));
+  EXPECT_THAT(Text.p_offset % 0x1000, Eq(Text.p_vaddr % 0x1000));
+  EXPECT_THAT(MF.Bytes[Text.p_offset], Eq(0xaa));
+}
+
+TEST_F(ElfWriterTest, MapsDataReadWriteWithZeroFilledBSS) {
+  ldl::ElfWriter EW{L};
+  EW.EntrySymbol = "main";
+  EW.Write(Output);
+  ldl::MappedFile MF{Output};
+
+  const Elf64_Phdr& Data = ProgramHeader(MF, 1);
+  EXPECT_THAT(Data.p_type, Eq(PT_LOAD));
+  EXPECT_THAT(Data.p_flags, Eq(static_cast<Elf64_Word>(PF_R | PF_W)));
+  EXPECT_THAT(Data.p_vaddr, Eq(0x2000u));
+  EXPECT_THAT(Data.p_filesz, Eq(0x29u + 0x3 + 0x29 + 0x3));
+  EXPECT_THAT(Data.p_memsz, Eq(0x29u + 0x3 + 0x29 + 0x3 + 0x34 + 0x34 + 0x8));
+  EXPECT_THAT(Data.p_offset % 0x1000, Eq(Data.p_vaddr % 0x1000));
+  EXPECT_THAT(Data.p_offset + Data.p_filesz, Eq(MF.Size));
+}
+
+TEST(ElfWriter, RunsALinkedElfObject) {
+  std::string Output = "/tmp/ldl-elfwriter-exit42.out";
+  ldl::Linker L;
+  L.TextAddress = 0x401000;
+  L.FileNames = { "/Users/lanza/Projects/ldl/scrap/exit42.o" };
+  L.ReadFiles();
+  L.GenerateObjectFile();
+
+  ldl::ElfWriter EW{L};
+  EW.Write(Output);
+  EXPECT_THAT(EW.EntryAddress(), Eq(0x401000u));
+
+  int Status = std::system(Output.c_str());
+  std::remove(Output.c_str());
+  ASSERT_THAT(WIFEXITED(Status), Eq(true));
+  EXPECT_THAT(WEXITSTATUS(Status), Eq(42));
+}
+
+TEST(ElfWriter, RunsARelocatedProgramWithMergedStrings) {
+  std::string Output = "/tmp/ldl-elfwriter-strings.out";
+  ldl::Linker L;
+  L.TextAddress = 0x401000;
+  L.FileNames = {
+    "/Users/lanza/Projects/ldl/scrap/strings1.o",
+    "/Users/lanza/Projects/ldl/scrap/strings2.o"
+  };
+  L.ReadFiles();
+  L.GenerateObjectFile();
+  EXPECT_THAT(L.UndefinedSymbols.empty(), Eq(true));
+  EXPECT_THAT(L.Stats.RelocationsApplied, Eq(4));
+  EXPECT_THAT(L.Stats.UniqueMergePieces, Eq(2));
+
+  ldl::ElfWriter EW{L};
+  EW.Write(Output);
+
+  // answer() returns 5 and _start adds 'i' to it.
+  int Status = std::system(Output.c_str());
+  std::remove(Output.c_str());
+  ASSERT_THAT(WIFEXITED(Status), Eq(true));
+  EXPECT_THAT(WEXITSTATUS(Status), Eq(110));
+}
+
+// _start exits with answer() plus the address of the weak reference
+// optional, which nothing defines. weak1.o defines answer weakly as 1,
+// weak2.o strongly as 42 and weak3.o weakly as 7.
+TEST(ElfWriter, RunsProgramsWithWeakSymbols) {
+  std::string Scrap = "/Users/lanza/Projects/ldl/scrap/";
+  std::vector<std::pair<std::vector<std::string>, int>> Links{
+    {{Scrap + "weak1.o"}, 1},
+    {{Scrap + "weak1.o", Scrap + "weak2.o"}, 42},
+    {{Scrap + "weak1.o", Scrap + "weak3.o"}, 1}
+  };
+  std::string Output = "/tmp/ldl-elfwriter-weak.out";
+  for (auto& [FileNames, Expected] : Links) {
+    ldl::Linker L;
+    L.TextAddress = 0x401000;
+    L.FileNames = FileNames;
+    L.ReadFiles();
+    L.GenerateObjectFile();
+    EXPECT_THAT(L.DuplicateSymbols, IsEmpty());
+    EXPECT_THAT(L.UndefinedSymbols, IsEmpty());
+
+    ldl::ElfWriter EW{L};
+    EW.Write(Output);
+    int Status = std::system(Output.c_str());
+    std::remove(Output.c_str());
+    ASSERT_THAT(WIFEXITED(Status), Eq(true));
+    EXPECT_THAT(WEXITSTATUS(Status), Eq(Expected));
+  }
+}
+
+TEST(ElfWriter, RejectsUnappliedRelocations) {
+  std::string Output = "/tmp/ldl-elfwriter-unapplied.out";
+  ldl::Linker L;
+  L.FileNames = {"/Users/lanza/Projects/ldl/scrap/linkertest1.pof"};
+  L.ReadFiles();
+  L.GenerateObjectFile();
+  ASSERT_THAT(L.Stats.RelocationsInvalid, Gt(0u));
+  ldl::ElfWriter EW{L};
+  EW.EntrySymbol = "main";
+  EXPECT_THROW(EW.Write(Output), const char*);
+  EXPECT_THAT(std::fopen(Output.c_str(), "r"), IsNull());
+
+  ldl::Linker Unrelocated;
+  Unrelocated.FileNames = {"/Users/lanza/Projects/ldl/scrap/strings1.o"};
+  Unrelocated.ReadFiles();
+  Unrelocated.GenerateOutputFileSymbolTable();
+  Unrelocated.GenerateOutputFileSegments();
+  ldl::ElfWriter Early{Unrelocated};
+  EXPECT_THROW(Early.Write(Output), const char*);
+  EXPECT_THAT(std::fopen(Output.c_str(), "r"), IsNull());
+}
+
+TEST_F(ElfWriterTest, RejectsAMissingEntrySymbol) {
+  ldl::ElfWriter EW{L};
+  EW.EntrySymbol = "nosuch";
+  EXPECT_THROW(EW.EntryAddress(), const char*);
+
+  ldl::Linker Empty;
+  ldl::ElfWriter Unlinked{Empty};
+  EXPECT_THROW(Unlinked.EntryAddress(), const char*);
+}
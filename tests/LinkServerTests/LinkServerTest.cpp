@@ -0,0 +1,265 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <Driver/Driver.h>
+#include <LinkServer/LinkServer.h>
+
+using namespace ::testing;
+
+static std::string ReadWholeFile(const std::string& FileName) {
+  std::ifstream IFS{FileName};
+  return std::string((std::istreambuf_iterator<char>(IFS)), std::istreambuf_iterator<char>());
+}
+
+class LinkServerTest : public Test {
+public:
+  std::string SocketPath = "/tmp/ldl-link-server-test-" + std::to_string(getpid()) + ".sock";
+  std::string Input = "/tmp/ldl-link-server-test-" + std::to_string(getpid()) + ".pof";
+  std::string Output = "/tmp/ldl-link-server-test-" + std::to_string(getpid()) + ".out";
+  std::string Expected = "/tmp/ldl-link-server-test-" + std::to_string(getpid()) + ".expected";
+  std::string Sample = "/Users/lanza/Projects/ldl/scrap/linkertest43.pof";
+  std::unique_ptr<ldl::LinkServer> Server;
+  std::thread ServerThread;
+
+protected:
+  virtual void SetUp() {
+    CopyFile(Sample, Input);
+    Server = std::make_unique<ldl::LinkServer>(SocketPath);
+    Server->Listen();
+    ServerThread = std::thread([this] { Server->Serve(); });
+  }
+
+  virtual void TearDown() {
+    ldl::ShutdownLinkServer(SocketPath);
+    ServerThread.join();
+    Server.reset();
+    std::remove(Input.c_str());
+    std::remove(Output.c_str());
+    std::remove(Expected.c_str());
+  }
+
+  void CopyFile(const std::string& From, const std::string& To) {
+    std::ofstream OFS{To};
+    OFS << ReadWholeFile(From);
+  }
+
+  int Forward(std::vector<std::string> Args) {
+    std::ostringstream Errors;
+    return ldl::ForwardToLinkServer(SocketPath, Args, Errors);
+  }
+};
+
+TEST_F(LinkServerTest, LinksLikeTheCommandLine) {
+  ldl::LinkOptions Options;
+  Options.Output = Expected;
+  Options.FileNames = { Input };
+  ldl::Linker L;
+  ASSERT_THAT(ldl::RunLink(Options, L, std::cerr), Eq(0));
+
+  EXPECT_THAT(Forward({ "-o", Output, Input }), Eq(0));
+  EXPECT_THAT(ReadWholeFile(Output), Eq(ReadWholeFile(Expected)));
+}
+
+TEST_F(LinkServerTest, ReportsFailures) {
+  std::ostringstream Errors;
+  EXPECT_THAT(ldl::ForwardToLinkServer(SocketPath, { "--bogus" }, Errors), Eq(1));
+  EXPECT_THAT(Errors.str(), HasSubstr("unknown option"));
+}
+
+TEST_F(LinkServerTest, ReportsDuplicateDefinitions) {
+  std::ostringstream Errors;
+  EXPECT_THAT(ldl::ForwardToLinkServer(SocketPath, { "-o", Output, Input, Input }, Errors), Eq(1));
+  EXPECT_THAT(Errors.str(), HasSubstr("duplicate symbol main"));
+}
+
+TEST_F(LinkServerTest, ReusesParsedInputs) {
+  EXPECT_THAT(Forward({ "-o", Output, Input }), Eq(0));
+  EXPECT_THAT(Forward({ "-o", Output, Input }), Eq(0));
+
+  EXPECT_THAT(Server->Cache.Misses, Eq(1));
+  EXPECT_THAT(Server->Cache.Hits, Eq(1));
+  EXPECT_THAT(Server->Cache.Size(), Eq(1));
+}
+
+TEST_F(LinkServerTest, RehashesTouchedInputs) {
+  EXPECT_THAT(Forward({ "-o", Output, Input }), Eq(0));
+  usleep(10000);
+  CopyFile(Sample, Input);
+  EXPECT_THAT(Forward({ "-o", Output, Input }), Eq(0));
+
+  EXPECT_THAT(Server->Cache.Misses, Eq(1));
+  EXPECT_THAT(Server->Cache.HashHits, Eq(1));
+}
+
+TEST_F(LinkServerTest, ReparsesChangedInputs) {
+  EXPECT_THAT(Forward({ "-o", Output, Input }), Eq(0));
+  CopyFile("/Users/lanza/Projects/ldl/scrap/linkertest1.pof", Input);
+  EXPECT_THAT(Forward({ "-o", Output, Input }), Eq(0));
+
+  EXPECT_THAT(Server->Cache.Misses, Eq(2));
+  EXPECT_THAT(ReadWholeFile(Output), HasSubstr(".bss"));
+  EXPECT_THAT(ReadWholeFile(Output), Not(HasSubstr(".muffin")));
+}
+
+TEST(ObjectCacheTest, EvictsLeastRecentlyUsedInputs) {
+  std::string Sample = ReadWholeFile("/Users/lanza/Projects/ldl/scrap/linkertest43.pof");
+  std::vector<std::string> Inputs;
+  for (int i = 0; i < 3; i++) {
+    Inputs.push_back("/tmp/ldl-object-cache-test-" + std::to_string(getpid()) + "-" + std::to_string(i) + ".pof");
+    std::ofstream{Inputs.back()} << Sample;
+  }
+
+  ldl::ObjectCache Cache;
+  Cache.MaxBytes = 2 * static_cast<int64_t>(Sample.size());
+  Cache.Get(Inputs[0]);
+  Cache.Get(Inputs[1]);
+  Cache.Get(Inputs[0]);
+  Cache.Get(Inputs[2]);
+  EXPECT_THAT(Cache.Size(), Eq(2));
+  EXPECT_THAT(Cache.Bytes(), Eq(Cache.MaxBytes));
+  EXPECT_THAT(Cache.Evictions, Eq(1));
+
+  Cache.Get(Inputs[0]);
+  EXPECT_THAT(Cache.Hits, Eq(2));
+  Cache.Get(Inputs[1]);
+  EXPECT_THAT(Cache.Misses, Eq(4));
+
+  for (auto& Input : Inputs)
+    std::remove(Input.c_str());
+}
+
+TEST(ObjectCacheTest, DropsDeletedInputs) {
+  std::string Input = "/tmp/ldl-object-cache-test-" + std::to_string(getpid()) + ".pof";
+  std::ofstream{Input} << ReadWholeFile("/Users/lanza/Projects/ldl/scrap/linkertest43.pof");
+
+  ldl::ObjectCache Cache;
+  Cache.Get(Input);
+  std::remove(Input.c_str());
+  Cache.Prune();
+  EXPECT_THAT(Cache.Size(), Eq(0));
+  EXPECT_THAT(Cache.Bytes(), Eq(0));
+  EXPECT_THROW(Cache.Get(Input), const char*);
+}
+
+TEST(ObjectCacheTest, NamesInputsByCanonicalPath) {
+  std::string Input = "/tmp/ldl-object-cache-test-" + std::to_string(getpid()) + ".pof";
+  std::ofstream{Input} << ReadWholeFile("/Users/lanza/Projects/ldl/scrap/linkertest43.pof");
+
+  ldl::ObjectCache Cache;
+  auto OF = Cache.Get("/tmp/../tmp/" + Input.substr(5));
+  ASSERT_THAT(OF->Segments, Not(IsEmpty()));
+  EXPECT_THAT(OF->Segments[0].FileName, Eq(Input));
+  EXPECT_THAT(Cache.Get(Input), Eq(OF));
+  std::remove(Input.c_str());
+}
+
+TEST_F(LinkServerTest, ReportsWhatShardedWorkersReport) {
+  std::string Missing = "/tmp/ldl-link-server-test-missing.pof";
+  std::ostringstream Errors;
+  EXPECT_THAT(ldl::ForwardToLinkServer(SocketPath, { "--shards", "2", "-o", Output, Input, Missing }, Errors), Eq(1));
+  EXPECT_THAT(Errors.str(), HasSubstr("linker: IFS for file no good"));
+}
+
+TEST(LinkServerTimeoutTest, DropsStalledClients) {
+  std::string SocketPath = "/tmp/ldl-link-server-timeout-test-" + std::to_string(getpid()) + ".sock";
+  ldl::LinkServer Server{SocketPath};
+  Server.ClientTimeout = 1;
+  Server.Listen();
+  std::thread ServerThread([&] { Server.Serve(); });
+
+  // Connects and sends half a request, then waits on the reply.
+  std::thread Stalled([&] {
+    int FD = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un Address{};
+    Address.sun_family = AF_UNIX;
+    std::strcpy(Address.sun_path, SocketPath.c_str());
+    if (connect(FD, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) == 0) {
+      write(FD, "LINK\n", 5);
+      char Buffer[256];
+      while (read(FD, Buffer, sizeof(Buffer)) > 0)
+        ;
+    }
+    close(FD);
+  });
+  usleep(100000);
+
+  std::ostringstream Errors;
+  EXPECT_THAT(ldl::ForwardToLinkServer(SocketPath, { "--bogus" }, Errors), Eq(1));
+  EXPECT_THAT(Errors.str(), HasSubstr("unknown option"));
+  Stalled.join();
+  ldl::ShutdownLinkServer(SocketPath);
+  ServerThread.join();
+}
+
+TEST(ShardedLinkTest, WritesWhatASingleProcessLinkWrites) {
+  std::string Scrap = "/Users/lanza/Projects/ldl/scrap/";
+  std::string Single = "/tmp/ldl-sharded-link-test-" + std::to_string(getpid()) + ".single";
+  std::string Sharded = "/tmp/ldl-sharded-link-test-" + std::to_string(getpid()) + ".sharded";
+  for (auto& Format : {"pof", "elf"}) {
+    SCOPED_TRACE(Format);
+    ldl::LinkOptions Options;
+    Options.Format = Format;
+    Options.FileNames = { Scrap + "exit42.o", Scrap + "strings2.o", Scrap + "elftest2.o" };
+    if (Options.Format == "pof")
+      Options.FileNames.push_back(Scrap + "elftest1.o");
+    Options.Output = Single;
+    ldl::Linker L;
+    ASSERT_THAT(ldl::RunLink(Options, L, std::cerr), Eq(0));
+
+    Options.Shards = 3;
+    Options.Output = Sharded;
+    ASSERT_THAT(ldl::RunLink(Options, L, std::cerr), Eq(0));
+    EXPECT_THAT(ReadWholeFile(Sharded), Eq(ReadWholeFile(Single)));
+    for (int Shard = 0; Shard < 3; Shard++)
+      EXPECT_THAT(access((Sharded + ".shard" + std::to_string(Shard)).c_str(), F_OK), Ne(0));
+  }
+  std::remove(Single.c_str());
+  std::remove(Sharded.c_str());
+}
+
+TEST(ShardedLinkTest, WritesWhatASingleProcessLinkWritesForMixedAlignments) {
+  std::string Prefix = "/tmp/ldl-sharded-alignment-test-" + std::to_string(getpid());
+  std::vector<std::string> Inputs = { Prefix + "-1.pof", Prefix + "-2.pof", Prefix + "-3.pof" };
+  std::ofstream{Inputs[0]} << "LINK\n1 1 0\n.data 0 4 RWP\nx 0 1 D\n01000000\n";
+  std::ofstream{Inputs[1]} << "LINK\n1 1 0\n.data 0 4 RWP\ny 0 1 D\n02000000\n";
+  std::ofstream{Inputs[2]} << "LINK\n1 1 0\n.data 0 10 RWP A=10\nz 0 1 D\n" << std::string(32, '3') << "\n";
+  ldl::LinkOptions Options;
+  Options.FileNames = Inputs;
+  Options.Output = Prefix + ".single";
+  ldl::Linker L;
+  ASSERT_THAT(ldl::RunLink(Options, L, std::cerr), Eq(0));
+
+  // The second shard holds the 4-aligned y and the 16-aligned z.
+  ldl::LinkOptions Sharded = Options;
+  Sharded.Shards = 2;
+  Sharded.Output = Prefix + ".sharded";
+  ASSERT_THAT(ldl::RunLink(Sharded, L, std::cerr), Eq(0));
+  EXPECT_THAT(ReadWholeFile(Sharded.Output), Eq(ReadWholeFile(Options.Output)));
+  for (auto& FileName : Inputs)
+    std::remove(FileName.c_str());
+  std::remove(Options.Output.c_str());
+  std::remove(Sharded.Output.c_str());
+}
+
+TEST(ShardedLinkTest, ParsesShardOptions) {
+  ldl::LinkOptions Options;
+  std::ostringstream Errors;
+  EXPECT_THAT(ldl::ParseLinkOptions({ "-r", "--shards", "4", "a.pof" }, Options, Errors), Eq(true));
+  EXPECT_THAT(Options.Relocatable, Eq(true));
+  EXPECT_THAT(Options.Shards, Eq(4));
+
+  ldl::LinkOptions Bad;
+  EXPECT_THAT(ldl::ParseLinkOptions({ "--shards", "0", "a.pof" }, Bad, Errors), Eq(false));
+  ldl::LinkOptions Elf;
+  EXPECT_THAT(ldl::ParseLinkOptions({ "-r", "--format", "elf", "a.pof" }, Elf, Errors), Eq(false));
+}
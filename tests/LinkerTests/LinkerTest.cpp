@@ -2,7 +2,15 @@
 #include <gmock/gmock.h>
 
 #include <Linker/Linker.h>
+#include <Linker/Parallel.h>
 #include <ObjectReader/ObjectReader.h>
+#include <ObjectReader/ObjectWriter.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <thread>
 
 using namespace ::testing;
 
@@ -388,6 +396,623 @@ TEST_F(GeneralSegmentsTest, PositionsRWSegmentsCorrectly) {
 }
 
 
+class LinkOnceGroupTest : public Test {
+public:
+  ldl::Linker L;
+protected:
+  virtual void SetUp() {
+    L.FileNames = {
+      "/Users/lanza/Projects/ldl/scrap/comdat1.pof",
+      "/Users/lanza/Projects/ldl/scrap/comdat2.pof"
+    };
+    L.ReadFiles();
+  }
+};
+
+TEST_F(LinkOnceGroupTest, SkipsTheDataOfLaterCopies) {
+  auto& Kept = L.ObjectFiles[0]->Segments[1];
+  EXPECT_THAT(Kept.Group, Eq("inline"));
+  EXPECT_THAT(Kept.Discarded, Eq(false));
+  EXPECT_THAT(Kept.Data, Eq("22222222"));
+
+  auto& Dropped = L.ObjectFiles[1]->Segments[0];
+  EXPECT_THAT(Dropped.Group, Eq("inline"));
+  EXPECT_THAT(Dropped.Discarded, Eq(true));
+  EXPECT_THAT(Dropped.Data.empty(), Eq(true));
+  EXPECT_THAT(L.ObjectFiles[1]->Segments[1].Data, Eq("5555555555555555"));
+}
+
+TEST_F(LinkOnceGroupTest, LinksTheFirstCopyOnly) {
+  ObjectFilePtr OFPtr = L.GenerateObjectFile();
+
+  ASSERT_THAT(L.RPSegments.size(), Eq(2));
+  EXPECT_THAT(L.RPSegments[0].Length, Eq(0x10));
+  EXPECT_THAT(L.RPSegments[1].Name, Eq(".text.inline"));
+  EXPECT_THAT(L.RPSegments[1].Length, Eq(0x4));
+  EXPECT_THAT(L.RPSegments[1].Data, Eq("22222222"));
+
+  int Address;
+  ASSERT_THAT(L.SymbolAddress("inline", Address), Eq(true));
+  EXPECT_THAT(Address, Eq(L.RPSegments[1].Address));
+
+  EXPECT_THAT(L.Stats.GroupsKept, Eq(1));
+  EXPECT_THAT(L.Stats.GroupsDiscarded, Eq(1));
+  EXPECT_THAT(L.Stats.SegmentsDiscarded, Eq(1));
+  EXPECT_THAT(L.Stats.BytesDiscarded, Eq(4));
+}
+
+TEST_F(LinkOnceGroupTest, ReportsOnlyDuplicatesOutsideGroups) {
+  L.GenerateObjectFile();
+  EXPECT_THAT(L.DuplicateSymbols.empty(), Eq(true));
+
+  ldl::Linker Twice;
+  Twice.Link({"/Users/lanza/Projects/ldl/scrap/comdat1.pof", "/Users/lanza/Projects/ldl/scrap/comdat1.pof"});
+  EXPECT_THAT(Twice.DuplicateSymbols, ElementsAre("first"));
+}
+
+class StringMergingTest : public Test {
+public:
+  ldl::Linker L;
+protected:
+  virtual void SetUp() {
+    L.FileNames = {
+      "/Users/lanza/Projects/ldl/scrap/merge1.pof",
+      "/Users/lanza/Projects/ldl/scrap/merge2.pof"
+    };
+    L.ReadFiles();
+  }
+};
+
+TEST_F(StringMergingTest, KeepsEachStringOnce) {
+  L.GenerateObjectFile();
+
+  ASSERT_THAT(L.RPSegments.size(), Eq(2));
+  ldl::OutSegment& Strings = L.RPSegments[1];
+  EXPECT_THAT(Strings.Name, Eq(".rodata.str"));
+  EXPECT_THAT(Strings.Address, Eq(0x1010));
+  EXPECT_THAT(Strings.Length, Eq(0x13));
+  EXPECT_THAT(Strings.Data, Eq("68656c6c6f00776f726c64006c6f0068657900"));
+
+  EXPECT_THAT(L.Stats.MergePieces, Eq(5));
+  EXPECT_THAT(L.Stats.UniqueMergePieces, Eq(4));
+  EXPECT_THAT(L.Stats.MergeBytesSaved, Eq(0xc + 0xd - 0x13));
+}
+
+TEST_F(StringMergingTest, RewritesRelocationsIntoMergedStrings) {
+  L.GenerateObjectFile();
+
+  // Both objects refer to their own copy of "world", now at 0x1016.
+  EXPECT_THAT(L.TextSegment->Data, Eq("00000000161000001610000000000000"));
+  EXPECT_THAT(L.Stats.RelocationsApplied, Eq(2));
+  EXPECT_THAT(L.Stats.RelocationsInvalid, Eq(0));
+}
+
+TEST_F(StringMergingTest, MergesTails) {
+  L.TailMergeStrings = true;
+  L.GenerateObjectFile();
+
+  ldl::OutSegment& Strings = L.RPSegments[1];
+  EXPECT_THAT(Strings.Length, Eq(0x10));
+  EXPECT_THAT(Strings.Data, Eq("68656c6c6f00776f726c640068657900"));
+
+  // "lo" is the end of "hello".
+  ASSERT_THAT(L.MergedSegments.size(), Eq(1));
+  EXPECT_THAT(L.MergedSegments[0].OutputOffset(1, 6), Eq(3));
+}
+
 
 
 //
+TEST(ParallelAlignedScanTest, MatchesASerialWalk) {
+  std::vector<long> Alignments;
+  std::vector<long> Lengths;
+  for (int i = 0; i < 5000; i++) {
+    Alignments.push_back(i % 401 == 0 ? 128 : i % 53 == 0 ? 16 : i % 3 == 0 ? 1 : 4);
+    Lengths.push_back((i * 7919) % 29);
+  }
+
+  std::vector<long> Expected;
+  long Address = 0x1002;
+  for (size_t i = 0; i < Alignments.size(); i++) {
+    Address = ldl::AlignAddress(Address, static_cast<int>(Alignments[i]));
+    Expected.push_back(Address);
+    Address += Lengths[i];
+  }
+
+  for (size_t Chunks = 1; Chunks <= 9; Chunks++) {
+    std::vector<long> Offsets;
+    long End = ldl::ParallelAlignedScan(Alignments.size(), Chunks, 0x1002, Offsets,
+      [&](size_t i) { return Alignments[i]; }, [&](size_t i) { return Lengths[i]; });
+    EXPECT_THAT(End, Eq(Address));
+    EXPECT_THAT(Offsets, Eq(Expected));
+  }
+}
+
+TEST(ParallelLayoutTest, MatchesSerialAppend) {
+  ldl::Linker Serial;
+  ldl::Linker Parallel;
+  std::vector<ldl::Segment> Segments;
+  for (int i = 0; i < 20000; i++) {
+    int Length = (i * 7919) % 61;
+    ldl::Segment S{"file" + std::to_string(i % 37), ".text", 0x0, Length, "RP"};
+    S.Data = std::string(2 * Length, "0123456789abcdef"[i % 16]);
+    // Mixed alignments make chunks start off their widest alignment, and
+    // inputs with less data than Length leave their tails as zeros.
+    S.Alignment = i % 997 == 0 ? 64 : i % 89 == 0 ? 16 : i % 11 == 0 ? 8 : i % 7 == 0 ? 1 : 4;
+    if (i % 13 == 0)
+      S.Data.resize(Length);
+    Segments.push_back(S);
+  }
+
+  ldl::OutSegment SerialText{"a.out", ".text", 0x1000, 0x0, "RP"};
+  ldl::OutSegment SerialOther{"a.out", ".other", 0x0, 0x0, "RP"};
+  for (int i = 0; i < 15000; i++)
+    Serial.AppendSegmentToOutSegment(Segments[i], SerialText);
+  Serial.InitializeSegmentForSamePage(SerialOther, SerialText);
+  for (int i = 15000; i < 20000; i++)
+    Serial.AppendSegmentToOutSegment(Segments[i], SerialOther);
+
+  std::vector<ldl::OutSegment> Outs{
+    ldl::OutSegment{"a.out", ".text", 0x1000, 0x0, "RP"},
+    ldl::OutSegment{"a.out", ".other", 0x0, 0x0, "RP"}
+  };
+  std::vector<std::vector<const ldl::Segment*>> Inputs(2);
+  for (int i = 0; i < 20000; i++)
+    Inputs[i < 15000 ? 0 : 1].push_back(&Segments[i]);
+  Parallel.LayoutOutSegments(Outs, Inputs);
+
+  std::vector<ldl::OutSegment*> Expected{&SerialText, &SerialOther};
+  for (int k = 0; k < 2; k++) {
+    EXPECT_THAT(Outs[k].Address, Eq(Expected[k]->Address));
+    EXPECT_THAT(Outs[k].Length, Eq(Expected[k]->Length));
+    EXPECT_THAT(Outs[k].Data, Eq(Expected[k]->Data));
+    ASSERT_THAT(Outs[k].ContainedSegments.size(), Eq(Expected[k]->ContainedSegments.size()));
+    for (size_t i = 0; i < Outs[k].ContainedSegments.size(); i++)
+      ASSERT_THAT(Outs[k].ContainedSegments[i].Address, Eq(Expected[k]->ContainedSegments[i].Address));
+  }
+
+  for (auto& FileMappingPair : Serial.Mappings)
+    for (auto& NameMappingPair : FileMappingPair.second) {
+      auto& M = Parallel.Mappings[FileMappingPair.first][NameMappingPair.first];
+      EXPECT_THAT(M.Start, Eq(NameMappingPair.second.Start));
+      EXPECT_THAT(M.End, Eq(NameMappingPair.second.End));
+    }
+}
+
+// A 16-byte aligned constant behind a 7-byte string, as compilers emit
+// .rodata.cst16 after another object's .rodata.
+TEST(AlignmentTest, AlignsInputsBehindOddSizedOnes) {
+  std::vector<ldl::Segment> Segments = {
+    ldl::Segment{"a.o", ".rodata", 0x0, 7, "RP"},
+    ldl::Segment{"b.o", ".rodata", 0x0, 16, "RP"},
+    ldl::Segment{"c.o", ".rodata", 0x0, 3, "RP"},
+  };
+  Segments[0].Data = "31323334353637";
+  Segments[1].Data = std::string(32, 'f');
+  Segments[1].Alignment = 16;
+  Segments[2].Data = "616263";
+
+  ldl::Linker Serial;
+  ldl::OutSegment SerialOut{"a.out", ".rodata", 0x1000, 0x0, "RP"};
+  for (auto& S : Segments)
+    Serial.AppendSegmentToOutSegment(S, SerialOut);
+
+  ldl::Linker Parallel;
+  std::vector<ldl::OutSegment> Outs{ldl::OutSegment{"a.out", ".rodata", 0x1000, 0x0, "RP"}};
+  Parallel.LayoutOutSegments(Outs, {{&Segments[0], &Segments[1], &Segments[2]}});
+
+  for (auto* O : {&SerialOut, &Outs[0]}) {
+    ASSERT_THAT(O->ContainedSegments.size(), Eq(3));
+    EXPECT_THAT(O->ContainedSegments[1].Address, Eq(0x1010));
+    EXPECT_THAT(O->ContainedSegments[2].Address, Eq(0x1020));
+    EXPECT_THAT(O->Length, Eq(0x23));
+    EXPECT_THAT(O->Data, Eq("31323334353637" + std::string(18, '0') + std::string(32, 'f') + "616263"));
+  }
+
+  // The same through POF inputs, where the alignment is an attribute.
+  std::vector<std::string> Inputs = {"/tmp/ldl-alignment-test-a.pof", "/tmp/ldl-alignment-test-b.pof"};
+  std::ofstream{Inputs[0]} << "LINK\n1 1 0\n.rodata 0 7 RP\ns 0 1 D\n31323334353637\n";
+  std::ofstream{Inputs[1]} << "LINK\n1 1 1\n.rodata 0 10 RP A=10\nk 0 1 D\n0 1 1 AS4\n" << std::string(32, '0') << "\n";
+  ldl::Linker L;
+  auto OFPtr = L.Link(Inputs);
+  for (auto& FileName : Inputs)
+    std::remove(FileName.c_str());
+  auto RoData = std::find_if(OFPtr->Segments.begin(), OFPtr->Segments.end(), [](const ldl::Segment& S) {
+    return S.Name == ".rodata";
+  });
+  ASSERT_THAT(RoData, Ne(OFPtr->Segments.end()));
+  EXPECT_THAT(RoData->Length, Eq(0x20));
+  // The constant's relocation against its own segment gives its address.
+  long Constant = RoData->Address + 0x10;
+  std::string Word(8, '0');
+  ldl::WriteHexBytes(&Word[0], std::string_view{reinterpret_cast<const char*>(&Constant), 4});
+  EXPECT_THAT(RoData->Data.substr(32, 8), Eq(Word));
+}
+
+TEST(MergedRelocationTest, FollowsAStringIntoAnotherInputsCopy) {
+  // b's "world" is kept; a's copy of it, which a's word points at, is
+  // dropped. A second word points at a's "hello", a displacement from a's
+  // .text, and a third past the end of a's strings.
+  std::vector<std::string> Inputs = {"/tmp/ldl-merged-relocation-b.pof", "/tmp/ldl-merged-relocation-a.pof"};
+  std::ofstream{Inputs[0]} << "LINK\n1 0 0\n.rodata.str 0 6 RP M=S\n776f726c6400\n";
+  std::ofstream{Inputs[1]} << "LINK\n2 0 2\n.text 0 8 RP\n.rodata.str 100 c RP M=S\n"
+                           << "0 1 2 A4\n4 1 2 R4\n"
+                           << "0601000000010000\n68656c6c6f00776f726c6400\n";
+  ldl::Linker L;
+  auto OFPtr = L.Link(Inputs);
+  EXPECT_THAT(L.Stats.RelocationsApplied, Eq(2));
+  EXPECT_THAT(L.Stats.RelocationsIntoMerged, Eq(0));
+  auto Text = std::find_if(OFPtr->Segments.begin(), OFPtr->Segments.end(), [](const ldl::Segment& S) {
+    return S.Name == ".text";
+  });
+  auto Strings = std::find_if(OFPtr->Segments.begin(), OFPtr->Segments.end(), [](const ldl::Segment& S) {
+    return S.Name == ".rodata.str";
+  });
+  ASSERT_THAT(Text, Ne(OFPtr->Segments.end()));
+  ASSERT_THAT(Strings, Ne(OFPtr->Segments.end()));
+  ASSERT_THAT(Strings->Data.substr(0, 24), Eq("776f726c640068656c6c6f00"));
+  int32_t Words[2] = {Strings->Address, Strings->Address + 6 - Text->Address};
+  std::string Expected(16, '0');
+  ldl::WriteHexBytes(&Expected[0], std::string_view{reinterpret_cast<const char*>(Words), 8});
+  EXPECT_THAT(Text->Data.substr(0, 16), Eq(Expected));
+
+  std::ofstream{Inputs[1]} << "LINK\n2 0 1\n.text 0 4 RP\n.rodata.str 100 c RP M=S\n"
+                           << "0 1 2 A4\n40010000\n68656c6c6f00776f726c6400\n";
+  ldl::Linker Past;
+  Past.Link(Inputs);
+  EXPECT_THAT(Past.Stats.RelocationsIntoMerged, Eq(1));
+  for (auto& FileName : Inputs)
+    std::remove(FileName.c_str());
+}
+
+TEST(RelocationOverflowTest, LeavesWordsThatWouldNotFit) {
+  // An unsigned word already at its maximum, a signed one at its maximum,
+  // and a displacement back to the start of the segment, which fits.
+  std::vector<std::string> Inputs = {"/tmp/ldl-overflow-test.pof"};
+  std::ofstream{Inputs[0]} << "LINK\n1 1 3\n.text 0 c RP\nk 0 1 D\n"
+                           << "0 1 1 AS4\n4 1 1 AS4S\n8 1 1 RS4\n"
+                           << "ffffffffffffff7f00000000\n";
+  ldl::Linker L;
+  auto OFPtr = L.Link(Inputs);
+  std::remove(Inputs[0].c_str());
+
+  EXPECT_THAT(L.Stats.RelocationsOverflowed, Eq(2));
+  EXPECT_THAT(L.Stats.RelocationsApplied, Eq(1));
+  auto Text = std::find_if(OFPtr->Segments.begin(), OFPtr->Segments.end(), [](const ldl::Segment& S) {
+    return S.Name == ".text";
+  });
+  ASSERT_THAT(Text, Ne(OFPtr->Segments.end()));
+  EXPECT_THAT(Text->Data.substr(0, 24), Eq("ffffffffffffff7ff8ffffff"));
+}
+
+class LinkerContextTest : public Test {
+public:
+  std::vector<std::string> Book = {
+    "/Users/lanza/Projects/ldl/scrap/main.pof",
+    "/Users/lanza/Projects/ldl/scrap/calif.pof",
+    "/Users/lanza/Projects/ldl/scrap/mass.pof",
+    "/Users/lanza/Projects/ldl/scrap/newyork.pof"
+  };
+  std::vector<std::string> General = {
+    "/Users/lanza/Projects/ldl/scrap/linkertest43.pof",
+    "/Users/lanza/Projects/ldl/scrap/linkertest43.pof"
+  };
+};
+
+TEST_F(LinkerContextTest, RelinksIdenticallyAfterReset) {
+  ldl::Linker L;
+  std::string First = L.Link(General)->GenerateTextRepresentation();
+  L.Link(Book);
+  std::string Second = L.Link(General)->GenerateTextRepresentation();
+
+  EXPECT_THAT(Second, Eq(First));
+  EXPECT_THAT(L.RPSegments.size(), Eq(2));
+  EXPECT_THAT(L.CommonSegment.Length, Eq(0x8));
+}
+
+TEST_F(LinkerContextTest, ResetKeepsCapacity) {
+  ldl::Linker L;
+  L.Link(General);
+  size_t SymbolCapacity = L.MergedSymbols.capacity();
+  size_t SegmentCapacity = L.RPSegments.capacity();
+
+  L.Reset();
+
+  EXPECT_THAT(L.MergedSymbols.empty(), Eq(true));
+  EXPECT_THAT(L.ObjectFiles.empty(), Eq(true));
+  EXPECT_THAT(L.Mappings.empty(), Eq(true));
+  EXPECT_THAT(L.TextSegment, IsNull());
+  EXPECT_THAT(L.MergedSymbols.capacity(), Eq(SymbolCapacity));
+  EXPECT_THAT(L.RPSegments.capacity(), Eq(SegmentCapacity));
+}
+
+TEST_F(LinkerContextTest, IndependentContextsLinkConcurrently) {
+  std::string Expected = ldl::Linker{}.Link(Book)->GenerateTextRepresentation();
+
+  std::vector<std::string> Results(4);
+  std::vector<std::thread> Threads;
+  for (size_t i = 0; i < Results.size(); i++)
+    Threads.emplace_back([&, i] {
+      ldl::Linker L;
+      for (int Round = 0; Round < 5; Round++)
+        Results[i] = L.Link(Round % 2 ? General : Book)->GenerateTextRepresentation();
+    });
+  for (auto& T : Threads)
+    T.join();
+
+  for (auto& Result : Results)
+    EXPECT_THAT(Result, Eq(Expected));
+}
+
+TEST_F(LinkerContextTest, RecordsThePhasesOfALink) {
+  ldl::Linker L;
+  L.Link(General);
+  EXPECT_THAT(L.Memory.Phases.empty(), Eq(true));
+
+  ldl::AllocationCounting Counting{true};
+  L.Memory.Enabled = true;
+  L.Link(General);
+
+  std::vector<std::string> Names;
+  for (auto& P : L.Memory.Phases)
+    Names.push_back(P.Name);
+  EXPECT_THAT(Names, Eq(std::vector<std::string>{"read", "symbols", "segments", "relocations", "output"}));
+  EXPECT_THAT(L.Memory.Phase("read")->Allocations, Gt(0u));
+  EXPECT_THAT(L.Memory.Phase("read")->PeakBytes, Ge(L.Memory.Phase("read")->LiveBytes));
+  for (auto* Name : {"ObjectFiles", "MergedSymbols", "SegmentDataStructure", "InputSegments", "ContainedSegments", "Data"}) {
+    ASSERT_THAT(L.Memory.Structure(Name), NotNull());
+    EXPECT_THAT(L.Memory.Structure(Name)->Bytes, Gt(0u)) << Name;
+    EXPECT_THAT(L.Memory.Structure(Name)->HighWater, Ge(L.Memory.Structure(Name)->Bytes));
+  }
+  size_t MergedSymbols = L.Memory.Structure("MergedSymbols")->Bytes;
+  EXPECT_THAT(MergedSymbols, Ge(L.MergedSymbols.capacity() * sizeof(int)));
+
+  L.Link(Book);
+  EXPECT_THAT(L.Memory.Phases.size(), Eq(5));
+}
+
+TEST(AllocationCounterTest, FreesOnlyWhatItCounted) {
+  auto Uncounted = std::make_unique<std::string>(1000, 'u');
+  int64_t Before = ldl::AllocationCounter::Now().Live;
+  int64_t AfterUncountedFree;
+  int64_t WithCounted;
+  int64_t AfterCountedFree;
+  {
+    ldl::AllocationCounting Counting{true};
+    Uncounted.reset();
+    AfterUncountedFree = ldl::AllocationCounter::Now().Live;
+    auto Counted = std::make_unique<std::vector<char>>(1000);
+    WithCounted = ldl::AllocationCounter::Now().Live;
+    Counted.reset();
+    AfterCountedFree = ldl::AllocationCounter::Now().Live;
+  }
+  EXPECT_THAT(AfterUncountedFree, Eq(Before));
+  EXPECT_THAT(WithCounted, Ge(Before + 1000));
+  EXPECT_THAT(AfterCountedFree, Eq(Before));
+
+  EXPECT_THAT(ldl::AllocationCounter::Enabled(), Eq(false));
+  uint64_t Allocations = ldl::AllocationCounter::Now().Allocations;
+  auto NotCounted = std::make_unique<std::string>(1000, 'n');
+  EXPECT_THAT(ldl::AllocationCounter::Now().Allocations, Eq(Allocations));
+}
+
+std::string Hex(const std::string& Bytes) {
+  std::string Out(2 * Bytes.size(), '\0');
+  ldl::WriteHexBytes(&Out[0], Bytes);
+  return Out;
+}
+
+TEST(BuildIdTest, HashesMatchReferenceVectors) {
+  EXPECT_THAT(ldl::BuildId::XXHash64(""), Eq(0xEF46DB3751D8E999ULL));
+  EXPECT_THAT(ldl::BuildId::XXHash64("abc"), Eq(0x44BC2CF5AD770999ULL));
+  EXPECT_THAT(Hex(ldl::BuildId::SHA256("abc")),
+    Eq("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+  EXPECT_THAT(Hex(ldl::BuildId::SHA256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")),
+    Eq("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"));
+}
+
+TEST(BuildIdTest, HashesTheChunkDigests) {
+  std::string Bytes(2 * ldl::BuildId::ChunkSize + 12345, '\0');
+  for (size_t i = 0; i < Bytes.size(); i++)
+    Bytes[i] = static_cast<char>(i * 7 + i / 4096);
+
+  for (auto Kind : {ldl::BuildIdKind::Fast, ldl::BuildIdKind::SHA256}) {
+    std::string Digests;
+    for (size_t Offset = 0; Offset < Bytes.size(); Offset += ldl::BuildId::ChunkSize)
+      Digests += ldl::BuildId::Hash(Kind, std::string_view{Bytes}.substr(Offset, ldl::BuildId::ChunkSize));
+    for (int i = 0; i < 8; i++)
+      Digests += static_cast<char>(static_cast<uint64_t>(Bytes.size()) >> (8 * i));
+
+    std::string Id = ldl::BuildId::Compute(Kind, Bytes);
+    EXPECT_THAT(Id.size(), Eq(ldl::BuildId::Size(Kind)));
+    EXPECT_THAT(Id, Eq(ldl::BuildId::Hash(Kind, Digests)));
+  }
+}
+
+TEST_F(LinkerContextTest, StampsABuildIdIntoTheOutput) {
+  ldl::Linker L;
+  L.BuildIdType = ldl::BuildIdKind::Fast;
+  auto OFPtr = L.Link(General);
+  ASSERT_THAT(OFPtr->Segments.back().Name, Eq(".note.build-id"));
+  EXPECT_THAT(OFPtr->Segments.back().Address % 0x1000, Eq(0));
+  EXPECT_THAT(OFPtr->Segments.back().Data, Eq("040000000800000003000000474e5500" + std::string(16, '0')));
+
+  std::string Unstamped = ldl::ObjectWriter{*OFPtr}.Text();
+  std::string Text = Unstamped;
+  std::string Id = L.StampBuildId(Text);
+  EXPECT_THAT(Id, Eq(ldl::BuildId::Compute(ldl::BuildIdKind::Fast, Unstamped)));
+  EXPECT_THAT(Text, Eq(Unstamped.substr(0, Unstamped.size() - 17) + Hex(Id) + "\n"));
+
+  std::string Again = ldl::ObjectWriter{*L.Link(General)}.Text();
+  EXPECT_THAT(L.StampBuildId(Again), Eq(Id));
+  std::string Other = ldl::ObjectWriter{*L.Link(Book)}.Text();
+  EXPECT_THAT(L.StampBuildId(Other), Ne(Id));
+
+  L.BuildIdType = ldl::BuildIdKind::SHA256;
+  std::string Long = ldl::ObjectWriter{*L.Link(General)}.Text();
+  EXPECT_THAT(L.StampBuildId(Long).size(), Eq(32));
+  EXPECT_THROW(L.StampBuildId(Unstamped), const char*);
+}
+
+class PartialLinkTest : public Test {
+public:
+  std::string Scrap = "/Users/lanza/Projects/ldl/scrap/";
+  std::vector<std::string> ShardFiles;
+
+  virtual void TearDown() {
+    for (auto& FileName : ShardFiles)
+      std::remove(FileName.c_str());
+  }
+
+  // Partially links consecutive slices of Inputs, then links the results.
+  std::string LinkShards(const std::vector<std::string>& Inputs, size_t NumberOfShards, bool TailMerge = false) {
+    ShardFiles.clear();
+    for (size_t Shard = 0; Shard < NumberOfShards; Shard++) {
+      std::vector<std::string> Slice(Inputs.begin() + Inputs.size() * Shard / NumberOfShards,
+        Inputs.begin() + Inputs.size() * (Shard + 1) / NumberOfShards);
+      ldl::Linker Part;
+      Part.Relocatable = true;
+      ShardFiles.push_back("/tmp/ldl-partial-link-test" + std::to_string(Shard) + ".pof");
+      EXPECT_THAT(ldl::ObjectWriter{*Part.Link(Slice)}.Write(ShardFiles.back()), Eq(true));
+    }
+    ldl::Linker Final;
+    Final.TailMergeStrings = TailMerge;
+    return Final.Link(ShardFiles)->GenerateTextRepresentation();
+  }
+
+  std::string Link(const std::vector<std::string>& Inputs, bool TailMerge = false) {
+    ldl::Linker L;
+    L.TailMergeStrings = TailMerge;
+    return L.Link(Inputs)->GenerateTextRepresentation();
+  }
+};
+
+TEST_F(PartialLinkTest, MergesRunsOfSegments) {
+  ldl::Linker Part;
+  Part.Relocatable = true;
+  auto OFPtr = Part.Link({Scrap + "elftest1.o", Scrap + "elftest2.o"});
+
+  size_t Inputs = 0;
+  for (auto& OF : Part.ObjectFiles)
+    Inputs += OF->Segments.size();
+  EXPECT_THAT(OFPtr->Segments.size(), Lt(Inputs));
+  EXPECT_THAT(OFPtr->FH.NumberOfRelocations, Eq(static_cast<int>(OFPtr->Relocations.size())));
+  EXPECT_THAT(OFPtr->Relocations.size(), Gt(0));
+}
+
+TEST_F(PartialLinkTest, LinksLikeTheInputs) {
+  std::vector<std::vector<std::string>> Links = {
+    {Scrap + "main.pof", Scrap + "calif.pof", Scrap + "mass.pof", Scrap + "newyork.pof"},
+    {Scrap + "linkertest43.pof", Scrap + "linkertest1.pof", Scrap + "linkertest43.pof"},
+    {Scrap + "comdat1.pof", Scrap + "comdat2.pof", Scrap + "comdat1.pof", Scrap + "comdat2.pof"},
+    {Scrap + "merge1.pof", Scrap + "merge2.pof", Scrap + "merge1.pof"},
+    {Scrap + "elftest1.o", Scrap + "strings1.o", Scrap + "elftest2.o", Scrap + "strings2.o", Scrap + "comdat.o"},
+  };
+  for (auto& Inputs : Links) {
+    SCOPED_TRACE(Inputs.front());
+    std::string Expected = Link(Inputs);
+    for (size_t Shards = 1; Shards <= Inputs.size(); Shards++)
+      EXPECT_THAT(LinkShards(Inputs, Shards), Eq(Expected));
+  }
+
+  std::vector<std::string> Strings = {Scrap + "strings1.o", Scrap + "strings2.o", Scrap + "merge1.pof"};
+  EXPECT_THAT(LinkShards(Strings, 3, true), Eq(Link(Strings, true)));
+}
+
+// Segment-relative relocations in inputs at their own addresses, merged
+// into runs at other offsets.
+TEST_F(PartialLinkTest, MovesSegmentRelocationsIntoRuns) {
+  std::vector<std::string> Objects = {
+    "LINK\n2 2 3\n.text 100 6 RP\n.data 200 8 RWP\n"
+    "fa 2 1 D\nfb 0 0 U\n"
+    "0 2 1 A4\n4 2 2 R4\n2 1 2 AS4\n"
+    "aabbccddeeff\n0401000010020000\n",
+    "LINK\n2 2 3\n.text 40 9 RP\n.data 80 8 RWP\n"
+    "fb 3 1 D\nfa 0 0 U\n"
+    "0 1 2 A4\n4 2 1 R4\n0 2 2 AS4\n"
+    "840000001122334455\n0000000048000000\n",
+    "LINK\n1 1 2\n.text 0 8 RP\n"
+    "fc 0 1 D\n"
+    "0 1 1 R4\n4 1 1 A4\n"
+    "0400000000000000\n",
+  };
+  std::vector<std::string> Inputs;
+  for (size_t i = 0; i < Objects.size(); i++) {
+    Inputs.push_back("/tmp/ldl-partial-link-input" + std::to_string(i) + ".pof");
+    std::ofstream{Inputs.back()} << Objects[i];
+  }
+
+  std::string Expected = Link(Inputs);
+  for (size_t Shards = 1; Shards <= Inputs.size(); Shards++)
+    EXPECT_THAT(LinkShards(Inputs, Shards), Eq(Expected));
+
+  ldl::Linker Part;
+  Part.Relocatable = true;
+  EXPECT_THAT(Part.Link(Inputs)->Segments.size(), Eq(2));
+  for (auto& FileName : Inputs)
+    std::remove(FileName.c_str());
+}
+
+class CompressedInputTest : public Test {
+public:
+  std::string Scrap = "/Users/lanza/Projects/ldl/scrap/";
+  std::vector<std::string> CompressedFiles;
+  int CompressedSegments = 0;
+
+  virtual void TearDown() {
+    for (auto& FileName : CompressedFiles)
+      std::remove(FileName.c_str());
+  }
+
+  // Rewrites each input with every segment compressed that gets smaller.
+  std::vector<std::string> Compress(const std::vector<std::string>& Inputs) {
+    std::vector<std::string> Outputs;
+    for (auto& Input : Inputs) {
+      ldl::ObjectReader OR{Input};
+      auto OFPtr = OR.GetObjectFile();
+      for (auto& S : OFPtr->Segments)
+        CompressedSegments += ldl::CompressSegment(S);
+      Outputs.push_back("/tmp/ldl-compressed-input" + std::to_string(CompressedFiles.size()) + ".pof");
+      CompressedFiles.push_back(Outputs.back());
+      EXPECT_THAT(ldl::ObjectWriter{*OFPtr}.Write(Outputs.back()), Eq(true));
+    }
+    return Outputs;
+  }
+
+  std::string Link(const std::vector<std::string>& Inputs, bool TailMerge = false) {
+    ldl::Linker L;
+    L.TailMergeStrings = TailMerge;
+    return L.Link(Inputs)->GenerateTextRepresentation();
+  }
+};
+
+TEST_F(CompressedInputTest, LinksLikeTheUncompressedInputs) {
+  std::string Synthetic = "/tmp/ldl-compressed-synthetic.pof";
+  CompressedFiles.push_back(Synthetic);
+  std::ofstream{Synthetic} << "LINK\n2 1 1\n.text 100 40 RP\n.rodata.str 200 18 RP M=S\n"
+    "f 0 1 D\n4 1 2 AS4\n"
+    << std::string(0x80, '9') << "\n" << "68656c6c6f00" "68656c6c6f00" "776f726c6400" "68656c6c6f00" << "\n";
+
+  std::vector<std::vector<std::string>> Links = {
+    {Scrap + "main.pof", Scrap + "calif.pof", Scrap + "mass.pof", Scrap + "newyork.pof"},
+    {Scrap + "linkertest43.pof", Scrap + "linkertest1.pof", Scrap + "linkertest43.pof"},
+    {Scrap + "comdat1.pof", Scrap + "comdat2.pof", Scrap + "comdat1.pof"},
+    {Scrap + "merge1.pof", Synthetic, Scrap + "merge2.pof", Synthetic},
+  };
+  for (auto& Inputs : Links) {
+    SCOPED_TRACE(Inputs.front());
+    std::vector<std::string> Compressed = Compress(Inputs);
+    EXPECT_THAT(Link(Compressed), Eq(Link(Inputs)));
+    EXPECT_THAT(Link(Compressed, true), Eq(Link(Inputs, true)));
+  }
+  EXPECT_THAT(CompressedSegments, Gt(0));
+}
+
+TEST_F(CompressedInputTest, RejectsABadBlockInMergedStrings) {
+  ldl::Segment S{"bad.pof", ".rodata.str", 0x0, 0x20, "RP"};
+  S.MergeStrings = true;
+  S.CompressedData = "\xff\xff";
+  S.CompressedSize = 2;
+  ldl::MergedSegment M;
+  EXPECT_THROW(M.Merge(".rodata", {&S}, false), const char*);
+}
@@ -0,0 +1,254 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <Linker/Linker.h>
+#include <Linker/RelativeRelocations.h>
+#include <Linker/SymbolHash.h>
+#include <Loader/Loader.h>
+
+using namespace ::testing;
+
+TEST(RelativeRelocations, RoundTripsRunsGapsAndRepeats) {
+  std::vector<uint32_t> Addresses{0x1000, 0x1004, 0x1008, 0x1010, 0x1080, 0x1081, 0x1081, 0x2000};
+  for (uint32_t i = 0; i < 100; i++)
+    Addresses.push_back(0x3000 + 4 * i);
+  std::vector<uint32_t> Entries;
+  ldl::RelativeRelocations::Encode(Addresses, 4, Entries);
+  EXPECT_THAT(Entries.size(), Lt(Addresses.size() / 4));
+
+  std::vector<uint32_t> Decoded;
+  ldl::RelativeRelocations::Decode(Entries.data(), Entries.size(), 4, [&](uint64_t Address) {
+    Decoded.push_back(static_cast<uint32_t>(Address));
+  });
+  EXPECT_THAT(Decoded, ElementsAreArray(Addresses));
+}
+
+TEST(SymbolHashTable, FindsEveryExportAndRejectsOtherNames) {
+  std::vector<std::string> Names;
+  std::vector<uint32_t> Hashes;
+  for (int i = 0; i < 1000; i++) {
+    Names.push_back("function" + std::to_string(i));
+    Hashes.push_back(ldl::SymbolHashTable::Hash(Names.back()));
+  }
+  uint32_t NumberOfBuckets = ldl::SymbolHashTable::BucketCount(Names.size());
+  std::vector<size_t> Order = ldl::SymbolHashTable::Order(Hashes, NumberOfBuckets);
+  std::vector<std::string> Rows{"import"};
+  std::vector<uint32_t> Sorted;
+  for (auto i : Order) {
+    Rows.push_back(Names[i]);
+    Sorted.push_back(Hashes[i]);
+  }
+  std::string Bytes = ldl::SymbolHashTable::Build(Sorted, 1, NumberOfBuckets);
+  std::vector<uint32_t> Words(Bytes.size() / 4);
+  std::memcpy(Words.data(), Bytes.data(), Bytes.size());
+
+  ldl::SymbolHashTable Table;
+  ASSERT_THAT(Table.Read(reinterpret_cast<const unsigned char*>(Words.data()), Bytes.size()), Eq(true));
+  auto Find = [&](const std::string& Name) {
+    long Found = -1;
+    Table.Find(ldl::SymbolHashTable::Hash(Name), [&](uint32_t Row) {
+      if (Rows[Row] != Name)
+        return false;
+      Found = Row;
+      return true;
+    });
+    return Found;
+  };
+  for (size_t Row = 1; Row < Rows.size(); Row++)
+    EXPECT_THAT(Find(Rows[Row]), Eq(static_cast<long>(Row)));
+  EXPECT_THAT(Find("import"), Eq(-1));
+  EXPECT_THAT(Find("function1000"), Eq(-1));
+}
+
+class LoaderTest : public Test {
+public:
+  ldl::Linker L;
+  std::string Image = "/tmp/ldl-loader-test.pof";
+  std::string Text;
+protected:
+  virtual void SetUp() {
+    L.TextAddress = 0x10000000;
+    L.FileNames = {
+      "/Users/lanza/Projects/ldl/scrap/strings1.o",
+      "/Users/lanza/Projects/ldl/scrap/strings2.o"
+    };
+    L.ReadFiles();
+    std::ofstream OFS{Image};
+    OFS << L.GenerateObjectFile()->GenerateTextRepresentation();
+  }
+
+  virtual void TearDown() {
+    std::remove(Image.c_str());
+  }
+
+  uint32_t Word(const ldl::LoadedImage& I, long LinkedAddress) {
+    uint32_t Value;
+    std::memcpy(&Value, I.Address(LinkedAddress), 4);
+    return Value;
+  }
+
+  // Runs the image's entry point in a child and returns its exit status.
+  int Run(const ldl::LoadedImage& I) {
+    pid_t Child = fork();
+    if (Child == 0) {
+      reinterpret_cast<void (*)()>(I.Entry())();
+      _exit(255);
+    }
+    int Status;
+    waitpid(Child, &Status, 0);
+    return WIFEXITED(Status) ? WEXITSTATUS(Status) : -1;
+  }
+};
+
+TEST_F(LoaderTest, LinkerPacksTheAbsoluteSlots) {
+  ASSERT_THAT(L.AbsoluteWords.size(), Eq(1));
+  EXPECT_THAT(L.AbsoluteDoublewords.empty(), Eq(true));
+  EXPECT_THAT(L.RelativeRelocationSegment.Address % 0x1000, Eq(0));
+  EXPECT_THAT(L.RelativeRelocationSegment.Length, Eq(8));
+}
+
+TEST_F(LoaderTest, MapsAtTheLinkedAddress) {
+  ldl::Loader Loader;
+  auto I = Loader.Load(Image);
+  ASSERT_THAT(I->Rebased(), Eq(false));
+  EXPECT_THAT(I->RelativeRelocations, Eq(0));
+  EXPECT_THAT(reinterpret_cast<long>(I->Entry()), Eq(0x10000000));
+
+  void* Answer;
+  ASSERT_THAT(I->SymbolAddress("answer", Answer), Eq(true));
+  EXPECT_THAT(reinterpret_cast<long>(Answer), Eq(0x10000018));
+  EXPECT_THAT(std::memcmp(I->Address(0x10000000), "\xe8\x13\x00\x00\x00", 5), Eq(0));
+  EXPECT_THAT(Run(*I), Eq(110));
+}
+
+TEST_F(LoaderTest, RebasesWithThePackedSlots) {
+  long Slot = L.AbsoluteWords.front();
+  uint32_t Linked = Word(*ldl::Loader{}.Load(Image), Slot);
+
+  ldl::Loader Loader;
+  Loader.Rebase = true;
+  auto I = Loader.Load(Image);
+  ASSERT_THAT(I->Rebased(), Eq(true));
+  EXPECT_THAT(I->RelativeRelocations, Eq(1));
+  EXPECT_THAT(Word(*I, Slot), Eq(static_cast<uint32_t>(Linked + I->Delta())));
+  EXPECT_THAT(Run(*I), Eq(110));
+}
+
+// The linked test program is too small to compress, so a table that
+// compresses well is linked in with it.
+TEST_F(LoaderTest, DecompressesSegmentsIntoPlace) {
+  std::string Table = "/tmp/ldl-loader-test-table.pof";
+  std::string Bytes;
+  for (int i = 0; i < 0x100; i++)
+    Bytes += static_cast<char>(i % 16);
+  std::string Hex(2 * Bytes.size(), '\0');
+  ldl::WriteHexBytes(&Hex[0], Bytes);
+  std::ofstream{Table} << "LINK\n1 1 0\n.rodata 0 100 RP\ntable 0 1 D\n" << Hex << "\n";
+
+  ldl::Linker Compressing;
+  Compressing.TextAddress = 0x10000000;
+  auto OFPtr = Compressing.Link({L.FileNames[0], L.FileNames[1], Table});
+  std::remove(Table.c_str());
+  int Compressed = 0;
+  for (auto& S : OFPtr->Segments)
+    Compressed += ldl::CompressSegment(S);
+  ASSERT_THAT(Compressed, Gt(0));
+  std::ofstream{Image} << OFPtr->GenerateTextRepresentation();
+
+  ldl::Loader Loader;
+  auto I = Loader.Load(Image);
+  void* Address;
+  ASSERT_THAT(I->SymbolAddress("table", Address), Eq(true));
+  EXPECT_THAT(std::memcmp(Address, Bytes.data(), Bytes.size()), Eq(0));
+  EXPECT_THAT(Run(*I), Eq(110));
+}
+
+TEST_F(LoaderTest, RejectsInputObjects) {
+  ldl::Loader Loader;
+  EXPECT_THROW(Loader.Load("/Users/lanza/Projects/ldl/scrap/linkertest1.pof"), const char*);
+}
+
+class SharedLibraryTest : public Test {
+public:
+  std::string Library = "/tmp/ldl-loader-test-library.pof";
+  std::string Program = "/tmp/ldl-loader-test-program.pof";
+  ldl::Linker L;
+protected:
+  virtual void SetUp() {
+    ldl::Linker LibraryLinker;
+    LibraryLinker.Shared = true;
+    std::ofstream{Library} << LibraryLinker.Link({"/Users/lanza/Projects/ldl/scrap/strings2.o"})->GenerateTextRepresentation();
+
+    L.Libraries = {Library};
+    std::ofstream{Program} << L.Link({"/Users/lanza/Projects/ldl/scrap/strings1.o"})->GenerateTextRepresentation();
+  }
+
+  virtual void TearDown() {
+    std::remove(Library.c_str());
+    std::remove(Program.c_str());
+  }
+
+  int Run(const ldl::LoadedImage& I) {
+    pid_t Child = fork();
+    if (Child == 0) {
+      reinterpret_cast<void (*)()>(I.Entry())();
+      _exit(255);
+    }
+    int Status;
+    waitpid(Child, &Status, 0);
+    return WIFEXITED(Status) ? WEXITSTATUS(Status) : -1;
+  }
+};
+
+TEST_F(SharedLibraryTest, ImportsTheLibraryFunction) {
+  EXPECT_THAT(L.Imports, ElementsAre("answer"));
+  EXPECT_THAT(L.UndefinedSymbols.empty(), Eq(true));
+}
+
+TEST_F(SharedLibraryTest, ResolvesExportsThroughTheHashTable) {
+  ldl::Loader Loader;
+  auto& Lib = Loader.LoadLibrary(Library);
+  EXPECT_THAT(Lib.Rebased(), Eq(true));
+
+  void* Answer;
+  ASSERT_THAT(Loader.Resolve("answer", Answer), Eq(true));
+  EXPECT_THAT(Answer, Eq(Lib.Address(Lib.Segments[0].Address)));
+  EXPECT_THAT(Loader.Resolve("_start", Answer), Eq(false));
+  EXPECT_THAT(Loader.Resolve("missing", Answer), Eq(false));
+}
+
+TEST_F(SharedLibraryTest, BindsLazilyOnTheFirstCall) {
+  ldl::Loader Loader;
+  Loader.LoadLibrary(Library);
+  auto I = Loader.Load(Program);
+  ASSERT_THAT(I->Imports.size(), Eq(1));
+
+  void* Answer;
+  ASSERT_THAT(Loader.Resolve("answer", Answer), Eq(true));
+  EXPECT_THAT(*I->Imports[0].Slot, Ne(reinterpret_cast<uint64_t>(Answer)));
+  EXPECT_THAT(Run(*I), Eq(110));
+}
+
+TEST_F(SharedLibraryTest, BindsEverythingUpFront) {
+  ldl::Loader Loader;
+  Loader.LazyBinding = false;
+  Loader.LoadLibrary(Library);
+  auto I = Loader.Load(Program);
+
+  void* Answer;
+  ASSERT_THAT(Loader.Resolve("answer", Answer), Eq(true));
+  EXPECT_THAT(*I->Imports[0].Slot, Eq(reinterpret_cast<uint64_t>(Answer)));
+  EXPECT_THAT(Run(*I), Eq(110));
+}
+
+TEST_F(SharedLibraryTest, RejectsUnresolvedImportsUpFront) {
+  ldl::Loader Loader;
+  Loader.LazyBinding = false;
+  EXPECT_THROW(Loader.Load(Program), const char*);
+}
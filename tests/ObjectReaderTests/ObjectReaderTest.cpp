@@ -8,7 +8,9 @@
 #include <memory>
 
 
+#include <ElfReader/ElfReader.h>
 #include <ObjectReader/ObjectReader.h>
+#include <ObjectReader/ObjectWriter.h>
 
 std::string TestName = "/Users/lanza/Projects/ldl/scrap/sample.pof";
 
@@ -78,6 +80,25 @@ TEST(ObjectReader, ReadsSymbolTable) {
   EXPECT_THAT(OR.Symbols.size(), Eq(2));
 }
 
+TEST(ObjectReader, DecodesTypesIntoColumns) {
+  ldl::ObjectReader OR{TestName};
+  std::unique_ptr<ldl::ObjectFile> OFPtr = OR.GetObjectFile();
+
+  auto& Symbols = OFPtr->Symbols;
+  ASSERT_THAT(Symbols.size(), Eq(2));
+  EXPECT_THAT(Symbols.Name(0), Eq("main"));
+  EXPECT_THAT(Symbols.Types[0], Eq(ldl::SymbolType::Defined));
+  EXPECT_THAT(Symbols.Name(1), Eq("muffin"));
+  EXPECT_THAT(Symbols.Values[1], Eq(0x5bbb));
+  EXPECT_THAT(Symbols.Types[1], Eq(ldl::SymbolType::Unknown));
+  EXPECT_THAT(Symbols[1].Type, Eq("RR"));
+
+  EXPECT_THAT(OFPtr->Relocations.Types[3], Eq(ldl::RelocationType::A4));
+  EXPECT_THAT(OFPtr->Segments[0].Permissions, Eq(ldl::SegmentPermissions::RP));
+  EXPECT_THAT(OFPtr->Segments[1].Permissions, Eq(ldl::SegmentPermissions::RWP));
+  EXPECT_THAT(OFPtr->Segments[2].Permissions, Eq(ldl::SegmentPermissions::RW));
+}
+
 TEST(ObjectReader, ReadsARelocationEntry) {
   ldl::ObjectReader OR{TestName};
   OR.ReadFileHeader();
@@ -154,4 +175,136 @@ TEST(ObjectFile, GeneratesEquivalentFile) {
   EXPECT_THAT(ObjectFileStringRepresentation, Eq(FileStringRepresentation));
 }
 
+TEST(ObjectFile, KeepsGroupSignatures) {
+  std::string Comdat = "/Users/lanza/Projects/ldl/scrap/comdat1.pof";
+  std::ifstream IFS{Comdat};
+  std::string FileStringRepresentation(
+    (std::istreambuf_iterator<char>(IFS)),
+    (std::istreambuf_iterator<char>()));
+
+  ldl::ObjectReader OR{Comdat};
+  ObjectFilePtr OFPtr = OR.GetObjectFile();
+  EXPECT_THAT(OFPtr->Segments[0].Group.empty(), Eq(true));
+  EXPECT_THAT(OFPtr->Segments[1].Group, Eq("inline"));
+  EXPECT_THAT(OFPtr->GenerateTextRepresentation(), Eq(FileStringRepresentation));
+}
+
+std::string RoundTripName = "/tmp/ldl-object-writer-test.pof";
+
+ObjectFilePtr RoundTrip(const ldl::ObjectFile& OF) {
+  EXPECT_THAT(ldl::ObjectWriter{OF}.Write(RoundTripName), Eq(true));
+  ldl::ObjectReader OR{RoundTripName};
+  ObjectFilePtr Read = OR.GetObjectFile();
+  std::remove(RoundTripName.c_str());
+  return Read;
+}
+
+TEST(ObjectWriter, RoundTripsTheFixtures) {
+  for (auto Name : {"sample.pof", "linkertest43.pof", "merge2.pof", "comdat1.pof", "calif.pof"}) {
+    SCOPED_TRACE(Name);
+    ldl::ObjectReader OR{std::string{"/Users/lanza/Projects/ldl/scrap/"} + Name};
+    ObjectFilePtr OFPtr = OR.GetObjectFile();
+    ObjectFilePtr Read = RoundTrip(*OFPtr);
+    EXPECT_THAT(Read->GenerateTextRepresentation(), Eq(OFPtr->GenerateTextRepresentation()));
+    ASSERT_THAT(Read->Segments.size(), Eq(OFPtr->Segments.size()));
+    for (size_t i = 0; i < Read->Segments.size(); i++)
+      EXPECT_THAT(Read->Segments[i].Data, Eq(OFPtr->Segments[i].Data));
+  }
+}
+
+// Counts past 9 tell decimal from hex, and an empty segment has an empty
+// data line that must not swallow the next segment's.
+TEST(ObjectWriter, WritesCountsInDecimalAndEverythingElseInHex) {
+  ldl::ObjectFile OF;
+  OF.Segments.push_back(ldl::Segment{"", ".bss", 0x2004, 0, "RW"});
+  OF.Segments.push_back(ldl::Segment{"", ".text", 0x1000, 4, "RP"});
+  OF.Segments.back().Data = "c3c3c3c3";
+  for (int i = 0; i < 12; i++)
+    OF.Symbols.Add("s" + std::to_string(i), 0x1a + i, 2, ldl::SymbolType::Defined);
+  OF.Symbols.Add("odd", 0, 2, ldl::SymbolType::Unknown);
+  OF.Symbols.UnknownTypes.emplace_back(12, "RR");
+  OF.Relocations.Add(0xb, 2, 0xc, ldl::RelocationType::AS4, 0);
+  OF.FH = ldl::FileHeader{"LINK", 2, 13, 1};
+
+  std::string Text = OF.GenerateTextRepresentation();
+  EXPECT_THAT(Text, StartsWith("LINK\n2 13 1\n.bss 2004 0 RW\n.text 1000 4 RP\ns0 1a 2 D\n"));
+  EXPECT_THAT(Text, HasSubstr("odd 0 2 RR\nb 2 c AS4\n\nc3c3c3c3\n"));
+
+  ObjectFilePtr Read = RoundTrip(OF);
+  EXPECT_THAT(Read->FH.NumberOfSymbols, Eq(13));
+  EXPECT_THAT(Read->Segments[0].Data, Eq(""));
+  EXPECT_THAT(Read->Segments[1].Data, Eq("c3c3c3c3"));
+  EXPECT_THAT(Read->Symbols.Values[11], Eq(0x25));
+  EXPECT_THAT(Read->Symbols.TypeName(12), Eq("RR"));
+  EXPECT_THAT(Read->Relocations.Refs[0], Eq(0xc));
+  EXPECT_THAT(Read->GenerateTextRepresentation(), Eq(Text));
+}
+
+TEST(ObjectWriter, WritesTheBytesOfBinaryInputs) {
+  ldl::ElfReader ER{"/Users/lanza/Projects/ldl/scrap/elftest1.o"};
+  ObjectFilePtr OFPtr = ER.GetObjectFile();
+  ObjectFilePtr Read = RoundTrip(*OFPtr);
+  ASSERT_THAT(Read->Segments.size(), Eq(OFPtr->Segments.size()));
+  for (size_t i = 0; i < Read->Segments.size(); i++) {
+    std::string Hex(2 * OFPtr->Segments[i].RawData.size(), '\0');
+    ldl::WriteHexBytes(&Hex[0], OFPtr->Segments[i].RawData);
+    EXPECT_THAT(Read->Segments[i].Data, Eq(Hex));
+  }
+  EXPECT_THAT(Read->Symbols.size(), Eq(OFPtr->Symbols.size()));
+}
+
 //
+
+TEST(Compression, RoundTripsRunsLiteralsAndLongMatches) {
+  std::string Bytes = std::string(1000, 'a') + "0123456789abcdef";
+  for (int i = 0; i < 300; i++)
+    Bytes += static_cast<char>(i * 131 % 251);
+  Bytes += Bytes.substr(500, 700);
+  std::string Block = ldl::LZCompress(Bytes);
+  EXPECT_THAT(Block.size(), Lt(Bytes.size() / 2));
+  ASSERT_THAT(ldl::LZValidate(Block, Bytes.size()), Eq(true));
+  std::string Out(Bytes.size(), '\0');
+  ASSERT_THAT(ldl::LZDecompress(Block, &Out[0], Out.size()), Eq(true));
+  EXPECT_THAT(Out, Eq(Bytes));
+
+  EXPECT_THAT(ldl::LZValidate(Block, Bytes.size() - 1), Eq(false));
+  EXPECT_THAT(ldl::LZValidate(Block, Bytes.size() + 1), Eq(false));
+  EXPECT_THAT(ldl::LZValidate(Block.substr(0, Block.size() / 2), Bytes.size()), Eq(false));
+  EXPECT_THAT(ldl::LZValidate(ldl::LZCompress(""), 0), Eq(true));
+}
+
+TEST(ObjectWriter, RoundTripsCompressedSegments) {
+  ldl::ObjectFile OF;
+  OF.Segments.push_back(ldl::Segment{"", ".text", 0x1000, 0x100, "RP"});
+  OF.Segments.back().Data = std::string(0x100, 'c') + std::string(0x100, '9');
+  OF.Segments.push_back(ldl::Segment{"", ".data", 0x2000, 4, "RWP"});
+  OF.Segments.back().Data = "01020304";
+  OF.FH = ldl::FileHeader{"LINK", 2, 0, 0};
+  std::string Hex = OF.Segments[0].Data;
+
+  ASSERT_THAT(ldl::CompressSegment(OF.Segments[0]), Eq(true));
+  EXPECT_THAT(ldl::CompressSegment(OF.Segments[1]), Eq(false));
+  std::string Text = OF.GenerateTextRepresentation();
+  std::ostringstream Header;
+  Header << ".text 1000 100 RP Z=" << std::hex << OF.Segments[0].CompressedSize << "\n";
+  EXPECT_THAT(Text, HasSubstr(Header.str()));
+
+  ObjectFilePtr Read = RoundTrip(OF);
+  ldl::Segment& S = Read->Segments[0];
+  ASSERT_THAT(S.Compressed(), Eq(true));
+  EXPECT_THAT(S.Length, Eq(0x100));
+  std::string Written(ldl::HexDataSize(S), '\0');
+  ldl::WriteHexData(&Written[0], S);
+  EXPECT_THAT(Written, Eq(Hex));
+  EXPECT_THAT(Read->Segments[1].Data, Eq("01020304"));
+  EXPECT_THAT(Read->GenerateTextRepresentation(), Eq(Text));
+}
+
+TEST(ObjectReader, RejectsACorruptCompressedSegment) {
+  std::string Name = "/tmp/ldl-corrupt-compressed.pof";
+  // The one sequence claims five literals but the segment is four bytes.
+  std::ofstream{Name} << "LINK\n1 0 0\n.text 1000 4 RP Z=6\n\n50c3c3c3c3c3\n";
+  ldl::ObjectReader OR{Name};
+  EXPECT_THAT(OR.ReadFile(), Eq(false));
+  std::remove(Name.c_str());
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cstdio>
+#include <fstream>
+
+#include <Linker/Linker.h>
+#include <Linker/SegmentOrdering.h>
+
+using namespace ::testing;
+
+class SegmentOrderingTest : public Test {
+public:
+  ldl::Linker L;
+  std::vector<ldl::SharedObjectFilePtr> Objects;
+protected:
+  virtual void SetUp() {
+    int Lengths[] = { 0x100, 0x200, 0x300, 0x400, 0x500 };
+    for (int i = 0; i < 5; i++) {
+      auto OF = std::make_shared<ldl::ObjectFile>();
+      OF->FileName = "object" + std::to_string(i);
+      OF->Segments.push_back(ldl::Segment{OF->FileName, ".text", 0x0, Lengths[i], "RP"});
+      OF->Symbols.push_back(ldl::Symbol{"f" + std::to_string(i), 0, 1, "D"});
+      Objects.push_back(OF);
+    }
+    L.ObjectFiles = Objects;
+  }
+
+  std::vector<std::string> TextOrder() {
+    L.GenerateObjectFile();
+    std::vector<std::string> Order;
+    for (auto& C : L.TextSegment->ContainedSegments)
+      Order.push_back(C.FileName);
+    return Order;
+  }
+};
+
+TEST_F(SegmentOrderingTest, KeepsCommandLineOrderByDefault) {
+  EXPECT_THAT(TextOrder(), ElementsAre("object0", "object1", "object2", "object3", "object4"));
+}
+
+TEST_F(SegmentOrderingTest, PlacesOrderedSymbolsFirst) {
+  L.Ordering.SymbolOrder = { "f3", "missing", "f1", "f3" };
+
+  EXPECT_THAT(TextOrder(), ElementsAre("object3", "object1", "object0", "object2", "object4"));
+  EXPECT_THAT(L.TextSegment->ContainedSegments[0].Address, Eq(0x1000));
+  EXPECT_THAT(L.TextSegment->ContainedSegments[1].Address, Eq(0x1400));
+}
+
+TEST_F(SegmentOrderingTest, ClustersCallersWithCallees) {
+  L.Ordering.CallGraph = {
+    { "f4", "f2", 100 },
+    { "f0", "f2", 10 },
+    { "f0", "f1", 5 },
+  };
+
+  // f2 joins its heaviest caller f4; f1 joins f0. The denser f4+f2 cluster
+  // goes first and f3, absent from the profile, goes last.
+  EXPECT_THAT(TextOrder(), ElementsAre("object4", "object2", "object0", "object1", "object3"));
+}
+
+TEST_F(SegmentOrderingTest, RespectsTheClusterSizeLimit) {
+  L.Ordering.CallGraph = { { "f4", "f3", 100 } };
+  L.Ordering.ClusterSizeLimit = 0x800;
+
+  // Merged, f4 and f3 would exceed the limit, so the denser f3 goes first.
+  EXPECT_THAT(TextOrder(), ElementsAre("object3", "object4", "object0", "object1", "object2"));
+}
+
+TEST_F(SegmentOrderingTest, PlacesOrderedSymbolsBeforeClusters) {
+  L.Ordering.SymbolOrder = { "f1", "f2" };
+  L.Ordering.CallGraph = {
+    { "f4", "f2", 100 },
+    { "f0", "f2", 10 },
+    { "f0", "f1", 5 },
+  };
+
+  // The listed f1 and f2 lead; f4 and f0 follow as their clusters do.
+  EXPECT_THAT(TextOrder(), ElementsAre("object1", "object2", "object4", "object0", "object3"));
+}
+
+TEST(SegmentOrdering, ReadsOrderingFiles) {
+  std::string FileName = "/tmp/ldl-segment-ordering-test.txt";
+  {
+    std::ofstream OFS{FileName};
+    OFS << "# hot functions" << std::endl << "entry" << std::endl << std::endl << "helper" << std::endl;
+  }
+  ldl::SegmentOrdering Ordering;
+  EXPECT_THAT(Ordering.ReadSymbolOrderingFile(FileName), Eq(true));
+  EXPECT_THAT(Ordering.SymbolOrder, ElementsAre("entry", "helper"));
+
+  {
+    std::ofstream OFS{FileName};
+    OFS << "entry helper 42" << std::endl << "helper" << std::endl;
+  }
+  EXPECT_THAT(Ordering.ReadCallGraphProfile(FileName), Eq(false));
+  {
+    std::ofstream OFS{FileName};
+    OFS << "entry helper 42" << std::endl;
+  }
+  Ordering.CallGraph.clear();
+  EXPECT_THAT(Ordering.ReadCallGraphProfile(FileName), Eq(true));
+  ASSERT_THAT(Ordering.CallGraph.size(), Eq(1));
+  EXPECT_THAT(Ordering.CallGraph[0].Weight, Eq(42));
+  std::remove(FileName.c_str());
+}
+
+TEST(SegmentOrdering, OrdersElfInputs) {
+  ldl::Linker L;
+  L.FileNames = {
+    "/Users/lanza/Projects/ldl/scrap/elftest1.o",
+    "/Users/lanza/Projects/ldl/scrap/elftest2.o"
+  };
+  L.Ordering.SymbolOrder = { "helper" };
+  L.ReadFiles();
+  L.GenerateObjectFile();
+
+  int Helper;
+  ASSERT_THAT(L.SymbolAddress("helper", Helper), Eq(true));
+  EXPECT_THAT(Helper, Eq(0x1000));
+}
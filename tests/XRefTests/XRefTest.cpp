@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <unistd.h>
+
+#include <ObjectReader/ObjectWriter.h>
+#include <XRef/XRef.h>
+
+using namespace ::testing;
+
+class XRefTest : public Test {
+public:
+  std::string Prefix = "/tmp/ldl-xref-test-" + std::to_string(getpid());
+  std::string Caller = Prefix + "-caller.pof";
+  std::string Callee = Prefix + "-callee.pof";
+  std::string IndexFile = Prefix + ".xref";
+
+  // Calls callee from its .data and defines caller in its .text.
+  void WriteCaller() {
+    ldl::ObjectFile OF;
+    OF.Segments = {
+      ldl::Segment{Caller, ".text", 0x0, 0x8, "RP"},
+      ldl::Segment{Caller, ".data", 0x0, 0x8, "RWP"}
+    };
+    OF.Segments[0].Data = std::string(16, '0');
+    OF.Segments[1].Data = std::string(16, '0');
+    OF.Symbols.push_back(ldl::Symbol{"caller", 0x0, 1, "D"});
+    OF.Symbols.push_back(ldl::Symbol{"callee", 0x0, 0, "U"});
+    OF.Relocations.push_back(ldl::Relocation{0x0, 2, 2, "AS4"});
+    OF.Relocations.push_back(ldl::Relocation{0x4, 2, 2, "AS4"});
+    OF.FH = ldl::FileHeader{"LINK", 2, 2, 2};
+    ASSERT_THAT(ldl::ObjectWriter{OF}.Write(Caller), Eq(true));
+  }
+
+  // Defines callee, holds a common block and declares an unused symbol.
+  void WriteCallee(const std::string& Defined = "callee") {
+    ldl::ObjectFile OF;
+    OF.Segments = {ldl::Segment{Callee, ".text", 0x0, 0x4, "RP"}};
+    OF.Segments[0].Data = "00000000";
+    OF.Symbols.push_back(ldl::Symbol{Defined, 0x0, 1, "D"});
+    OF.Symbols.push_back(ldl::Symbol{"block", 0x10, 0, "U"});
+    OF.Symbols.push_back(ldl::Symbol{"unused", 0x0, 0, "U"});
+    OF.FH = ldl::FileHeader{"LINK", 1, 3, 0};
+    ASSERT_THAT(ldl::ObjectWriter{OF}.Write(Callee), Eq(true));
+  }
+
+  std::string Describe(const std::vector<ldl::XRefIndex::Posting>& Postings) {
+    std::string Out;
+    for (auto& P : Postings)
+      Out += std::string{ldl::XRefKindName(P.Kind)} + " " + std::string{P.FileName} + " " + std::string{P.Segment} + ";";
+    return Out;
+  }
+
+protected:
+  virtual void SetUp() {
+    WriteCaller();
+    WriteCallee();
+  }
+
+  virtual void TearDown() {
+    std::remove(Caller.c_str());
+    std::remove(Callee.c_str());
+    std::remove(IndexFile.c_str());
+  }
+};
+
+TEST_F(XRefTest, IndexesDefinitionsAndReferences) {
+  ldl::XRefBuilder Builder;
+  Builder.Update({Caller, Callee});
+  ASSERT_THAT(Builder.Write(IndexFile), Eq(true));
+
+  ldl::XRefIndex Index{IndexFile};
+  EXPECT_THAT(Index.NumberOfFiles(), Eq(2));
+  EXPECT_THAT(Index.NumberOfNames(), Eq(4));
+  EXPECT_THAT(Describe(Index.Lookup("callee")),
+    Eq("defines " + Callee + " .text;references " + Caller + " .data;"));
+  EXPECT_THAT(Describe(Index.Lookup("caller")), Eq("defines " + Caller + " .text;"));
+  EXPECT_THAT(Describe(Index.Lookup("block")), Eq("common " + Callee + " ;"));
+  EXPECT_THAT(Describe(Index.Lookup("unused")), Eq("references " + Callee + " ;"));
+  EXPECT_THAT(Index.Lookup("missing").empty(), Eq(true));
+  EXPECT_THAT(Index.Lookup("calle").empty(), Eq(true));
+}
+
+TEST_F(XRefTest, UpdatesOnlyChangedFiles) {
+  ldl::XRefBuilder First;
+  First.Update({Caller, Callee});
+  ASSERT_THAT(First.Write(IndexFile), Eq(true));
+  EXPECT_THAT(First.Read, Eq(2));
+
+  ldl::XRefBuilder Unchanged;
+  Unchanged.Load(IndexFile);
+  Unchanged.Update({Caller, Callee});
+  EXPECT_THAT(Unchanged.Read, Eq(0));
+  EXPECT_THAT(Unchanged.Reused, Eq(2));
+  EXPECT_THAT(Unchanged.Build(), Eq(First.Build()));
+
+  WriteCallee("renamed_callee");
+  ldl::XRefBuilder Changed;
+  Changed.Load(IndexFile);
+  Changed.Update({Caller, Callee});
+  EXPECT_THAT(Changed.Read, Eq(1));
+  EXPECT_THAT(Changed.Reused, Eq(1));
+  ASSERT_THAT(Changed.Write(IndexFile), Eq(true));
+
+  {
+    ldl::XRefIndex Index{IndexFile};
+    EXPECT_THAT(Describe(Index.Lookup("callee")), Eq("references " + Caller + " .data;"));
+    EXPECT_THAT(Describe(Index.Lookup("renamed_callee")), Eq("defines " + Callee + " .text;"));
+  }
+
+  // Reordered and with a file dropped, the index matches a fresh build.
+  ldl::XRefBuilder Reordered;
+  Reordered.Load(IndexFile);
+  Reordered.Update({Callee, Caller});
+  ldl::XRefBuilder Fresh;
+  Fresh.Update({Callee, Caller});
+  EXPECT_THAT(Reordered.Read, Eq(0));
+  EXPECT_THAT(Reordered.Build(), Eq(Fresh.Build()));
+
+  ldl::XRefBuilder Removed;
+  Removed.Load(IndexFile);
+  Removed.Update({Caller});
+  ASSERT_THAT(Removed.Write(IndexFile), Eq(true));
+  ldl::XRefIndex Index{IndexFile};
+  EXPECT_THAT(Index.NumberOfFiles(), Eq(1));
+  EXPECT_THAT(Describe(Index.Lookup("callee")), Eq("references " + Caller + " .data;"));
+  EXPECT_THAT(Index.Lookup("renamed_callee").empty(), Eq(true));
+}
+
+TEST_F(XRefTest, IndexesElfObjects) {
+  ldl::XRefBuilder Builder;
+  Builder.Update({
+    "/Users/lanza/Projects/ldl/scrap/elftest1.o",
+    "/Users/lanza/Projects/ldl/scrap/elftest2.o"
+  });
+  ASSERT_THAT(Builder.Write(IndexFile), Eq(true));
+
+  ldl::XRefIndex Index{IndexFile};
+  auto Helper = Index.Lookup("helper");
+  ASSERT_THAT(Helper.size(), Eq(2));
+  EXPECT_THAT(Helper[0].Kind, Eq(ldl::XRefKind::Definition));
+  EXPECT_THAT(Helper[0].FileName, EndsWith("elftest2.o"));
+  EXPECT_THAT(Helper[1].Kind, Eq(ldl::XRefKind::Reference));
+  EXPECT_THAT(Helper[1].FileName, EndsWith("elftest1.o"));
+  EXPECT_THAT(Helper[1].Segment, Eq(".text"));
+}
+
+TEST_F(XRefTest, RejectsOtherFiles) {
+  EXPECT_THROW(ldl::XRefIndex{Caller}, const char*);
+}
+
+TEST_F(XRefTest, RejectsRecordsOutsideTheIndex) {
+  ldl::XRefBuilder Builder;
+  Builder.Update({Caller, Callee});
+  ASSERT_THAT(Builder.Write(IndexFile), Eq(true));
+  ldl::XRefIndex Index{IndexFile};
+  std::string Bytes = Builder.Build();
+
+  // Points the first posting at a file past the last. The files have
+  // three segments between them.
+  size_t FirstPosting = sizeof(ldl::XRefIndex::Header) + Index.NumberOfFiles() * sizeof(ldl::XRefIndex::FileRecord)
+    + 3 * sizeof(ldl::XRefIndex::SegmentRecord) + Index.NumberOfNames() * sizeof(ldl::XRefIndex::NameRecord);
+  ldl::XRefIndex::PostingRecord Posting;
+  std::memcpy(&Posting, &Bytes[FirstPosting], sizeof(Posting));
+  Posting.File = Index.NumberOfFiles();
+  std::memcpy(&Bytes[FirstPosting], &Posting, sizeof(Posting));
+  std::ofstream{IndexFile, std::ios::binary | std::ios::trunc} << Bytes;
+  EXPECT_THROW(ldl::XRefIndex{IndexFile}, const char*);
+}